@@ -3,14 +3,9 @@
 #include "examples/imgui_impl_sdl.h"
 #include "imgui.h"
 
-#ifdef MTR_ENABLED
-#include "minitrace/minitrace.h"
-#else
-#define mtr_init(X) {}
-#define mtr_shutdown() {}
-#define MTR_BEGIN(X,Y) {}
-#define MTR_END(X,Y) {}
-#endif
+#include "denormals.h"
+#include "trace.h"
+#include "wavwriter.h"
 
 #ifdef WIN32
 // don't interfere with std::min,max
@@ -23,6 +18,7 @@
 #include <windows.h>
 #endif
 
+#include <chrono>
 #include <string>
 
 // Go from C-style thread call to C++ method.
@@ -36,8 +32,6 @@ static void staticAudioCallback(void *userdata, Uint8 *byte_stream,
 
 App::App()
 {
-    mtr_init("trace.json");
-
     mAppWindow = nullptr;
     mAppGL = nullptr;
     mSDLWindow = nullptr;
@@ -45,6 +39,9 @@ App::App()
 
     mRogoSynth = new RogoSynth();
     mAudioBuffer = new float[AUDIO_BUFFER_SAMPLES];
+    mScopeFrames = new TripleBuffer<ScopeFrame>();
+    mScopeSilent = false;
+    mSequencer = nullptr;
 
     mSwitchFullscreen = false;
     mIsFullscreen = false;
@@ -62,13 +59,15 @@ App::App()
 
 App::~App()
 {
-    mtr_shutdown();
+    Trace::stop();
 
     delete mRogoSynth;
     delete [] mAudioBuffer;
+    delete mScopeFrames;
+    delete mSequencer;
 }
 
-void App::run()
+void App::run(const AppOptions &options)
 {
 #ifndef NDEBUG
     std::cout << "Rogosynth" << std::endl;
@@ -86,6 +85,52 @@ void App::run()
     std::cout << "GLM version          | " << GLM_VERSION << std::endl;
 #endif
 
+    mTracePath = options.tracePath.empty() ? "trace.json" : options.tracePath;
+    if (!options.tracePath.empty()) {
+        Trace::start(mTracePath);
+    }
+
+    if (options.benchmark) {
+        benchmark(options);
+        return;
+    }
+
+    if (!options.impulseResponse.empty() &&
+        !mRogoSynth->loadImpulseResponse(options.impulseResponse.c_str())) {
+        return;
+    }
+
+    if (!options.scalaFile.empty() && !mRogoSynth->loadScala(options.scalaFile.c_str())) {
+        return;
+    }
+
+    for (const std::string &path : options.sampleFiles) {
+        if (!mRogoSynth->loadSample(path.c_str())) {
+            return;
+        }
+    }
+    if (!options.sampleFiles.empty()) {
+        mRogoSynth->type(WaveType::sample);
+    }
+
+    if (!options.wavetableFile.empty()) {
+        if (!mRogoSynth->loadWavetable(options.wavetableFile.c_str())) {
+            return;
+        }
+        mRogoSynth->type(WaveType::wavetable);
+    }
+
+    if (!options.midiFile.empty()) {
+        mSequencer = new Sequencer();
+        if (!mSequencer->load(options.midiFile.c_str())) {
+            return;
+        }
+        if (!options.outputPath.empty()) {
+            renderMidi(options);
+            return;
+        }
+    }
+
     if (!init()) {
         loop();
     }
@@ -100,6 +145,9 @@ void App::cleanup()
 
     SDL_CloseAudioDevice(mAudioDevice);
 
+    delete mAppGL;
+    mAppGL = nullptr;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -251,6 +299,16 @@ bool App::initAudio()
     want.userdata = this;
     want.callback = staticAudioCallback;
 
+    if (Realtime::enabled()) {
+        Realtime::lockMemory();
+        // render one silent buffer so the engine's working memory is
+        // faulted in (and locked) before the device starts
+        memset(mAudioBuffer, 0, sizeof(float) * AUDIO_BUFFER_SAMPLES);
+        mRogoSynth->updateSamples(mAudioBuffer, AUDIO_BUFFER_SAMPLES);
+        Realtime::prefault(mAudioBuffer, sizeof(float) * AUDIO_BUFFER_SAMPLES);
+        Realtime::prefault(mScopeFrames, sizeof(*mScopeFrames));
+    }
+
     mAudioDevice = SDL_OpenAudioDevice(NULL, 0, &want, &mAudioSpec, 0);
 
     if (mAudioDevice == 0) {
@@ -301,11 +359,20 @@ void App::loop()
     static Uint32 lastFrameEventTime = 0;
     const Uint32 debounceTime = 100; // 100ms
 
+    // Only redraw for input, new meter data or a window change.  ImGui
+    // needs a few frames after input to settle hover and open/close state.
+    const int settleFrames = 3;
+    const Uint32 idleWaitTime = 10; // ms between checks for meter data
+    int framesToDraw = settleFrames;
+
     while (running) {
-        MTR_BEGIN("main", "runloop");
         Uint32 curTime = SDL_GetTicks();
         SDL_Event event;
-        while (SDL_PollEvent(&event)) {
+        bool haveEvent = (framesToDraw > 0)
+                             ? SDL_PollEvent(&event)
+                             : SDL_WaitEventTimeout(&event, idleWaitTime);
+        for (; haveEvent; haveEvent = SDL_PollEvent(&event)) {
+            framesToDraw = settleFrames;
 
             ImGui_ImplSDL2_ProcessEvent(&event);
             ImGuiIO &io = ImGui::GetIO();
@@ -326,6 +393,14 @@ void App::loop()
                 case SDLK_TAB:
                     mShowGUI = !mShowGUI;
                     break;
+                case SDLK_F2: // F2 == start/stop tracing
+                    if (Trace::active()) {
+                        Trace::stop();
+                    }
+                    else {
+                        Trace::start(mTracePath);
+                    }
+                    break;
                 case SDLK_F1: // F1 == FULLSCREEN
                     // getting double f events when we switch to fullscreen
                     // only on desktop linux!  So, let's slow this down to
@@ -407,12 +482,25 @@ void App::loop()
             }
         }
 
-        update();
-        mAppGL->render();
-        showGUI();
-
-        SDL_GL_SwapWindow(mSDLWindow);
-        MTR_END("main", "runloop");
+        if (mScopeFrames->update()) {
+            mAppGL->audioFrame(mScopeFrames->front());
+            framesToDraw = std::max(framesToDraw, 1);
+        }
+        if (mSwitchFullscreen || mAppWindow->resized()) {
+            framesToDraw = std::max(framesToDraw, 1);
+        }
+        if (framesToDraw > 0) {
+            TRACE_BEGIN("main", "runloop");
+            update();
+            mAppGL->render();
+            showGUI();
+
+            SDL_GL_SwapWindow(mSDLWindow);
+            TRACE_END("main", "runloop");
+            framesToDraw--;
+        }
+        Trace::drain();
+        Realtime::printReport();
     }
 }
 
@@ -435,26 +523,28 @@ void App::showGUI()
             pitchString += std::to_string(mRogoSynth->pitch(i)) + " ";
         }
     }
-    WaveType type = mRogoSynth->type();
+    static const WaveType waveTypes[] = {WaveType::sine, WaveType::sawtooth,
+                                         WaveType::square, WaveType::triangle, WaveType::fm,
+                                         WaveType::sample, WaveType::wavetable};
     int typeInt = 0;
-    switch (type) {
-    case WaveType::sine:
-        typeInt = 0;
-        break;
-    case WaveType::sawtooth:
-        typeInt = 1;
-        break;
-    case WaveType::square:
-        typeInt = 2;
-        break;
-    case WaveType::triangle:
-        typeInt = 3;
-        break;
+    while (waveTypes[typeInt] != mRogoSynth->type()) {
+        typeInt++;
     }
+    int unison = mRogoSynth->unison();
+    float unisonDetune = mRogoSynth->unisonDetune();
+    float unisonSpread = mRogoSynth->unisonSpread();
+    float fineTune = mRogoSynth->fineTune();
+    float bendRange = mRogoSynth->bendRange();
     float panPosition = mRogoSynth->panPosition();
+    float panSpread = mRogoSynth->panSpread();
     float cutoff = mRogoSynth->lpfCutoff();
     float resonance = mRogoSynth->lpfResonance();
+    int reverbType = (int)mRogoSynth->reverbType();
+    float convolutionWet = mRogoSynth->convolutionWet();
     int reverbPreset = (int)mRogoSynth->reverbPreset();
+    int reverbEngine = (int)mRogoSynth->reverbEngine();
+    static const char *reverbEngineNames[] = {"progenitor2", "fdn 8 lines",
+                                              "fdn 16 lines"};
     static const char *reverbPresetNames[] = {
         "default",     "smallhall1",  "smallhall2",  "mediumhall1",
         "mediumhall2", "largehall1",  "largehall2",  "smallroom1",
@@ -464,23 +554,117 @@ void App::showGUI()
 
     if (mShowGUI) {
         ImGui::Begin("RogoSynth", NULL, ImGuiWindowFlags_AlwaysAutoResize);
-        ImGui::RadioButton("sine", &typeInt, 0);
+        // only send the engine what actually changed
+        bool typeChanged = ImGui::RadioButton("sine", &typeInt, 0);
+        ImGui::SameLine();
+        typeChanged |= ImGui::RadioButton("sawtooth", &typeInt, 1);
+        ImGui::SameLine();
+        typeChanged |= ImGui::RadioButton("square", &typeInt, 2);
         ImGui::SameLine();
-        ImGui::RadioButton("sawtooth", &typeInt, 1);
+        typeChanged |= ImGui::RadioButton("triangle", &typeInt, 3);
         ImGui::SameLine();
-        ImGui::RadioButton("square", &typeInt, 2);
+        typeChanged |= ImGui::RadioButton("fm", &typeInt, 4);
         ImGui::SameLine();
-        ImGui::RadioButton("triangle", &typeInt, 3);
-        ImGui::SliderFloat("amplitude", &amplitude, 0.0f, 1.0f);
-        ImGui::SliderFloat("attack", &attack, 0.0f, 3.0f);
-        ImGui::SliderFloat("decay", &decay, 0.0f, 3.0f);
-        ImGui::SliderFloat("sustain", &sustain, 0.0f, 1.0f);
-        ImGui::SliderFloat("release", &release, 0.0f, 3.0f);
-        ImGui::SliderFloat("pan", &panPosition, -1.0f, 1.0f);
-        ImGui::SliderFloat("LPF cutoff", &cutoff, 20.0f, 2000.0f);
-        ImGui::SliderFloat("LPF resonance", &resonance, 0.0f, 100.0f);
-        ImGui::Combo("Reverb Preset", &reverbPreset, reverbPresetNames, IM_ARRAYSIZE(reverbPresetNames));
+        typeChanged |= ImGui::RadioButton("sample", &typeInt, 5);
+        ImGui::SameLine();
+        typeChanged |= ImGui::RadioButton("wavetable", &typeInt, 6);
+        if (typeInt == 5 && mRogoSynth->numSamples() == 0) {
+            ImGui::SameLine();
+            ImGui::Text("(none loaded, use -w)");
+        }
+        else if (typeInt == 5 && SampleStreamer::shared().underruns() > 0) {
+            ImGui::SameLine();
+            ImGui::Text("stream underruns: %u", SampleStreamer::shared().underruns());
+        }
+        if (typeChanged) {
+            mRogoSynth->type(waveTypes[typeInt]);
+        }
+        if (ImGui::SliderInt("unison", &unison, 1, MAX_UNISON)) {
+            mRogoSynth->unison(unison);
+        }
+        if (ImGui::SliderFloat("detune (cents)", &unisonDetune, 0.0f, 100.0f)) {
+            mRogoSynth->unisonDetune(unisonDetune);
+        }
+        if (ImGui::SliderFloat("stereo spread", &unisonSpread, 0.0f, 1.0f)) {
+            mRogoSynth->unisonSpread(unisonSpread);
+        }
+        if (ImGui::SliderFloat("amplitude", &amplitude, 0.0f, 1.0f)) {
+            mRogoSynth->amplitude(amplitude);
+        }
+        if (ImGui::SliderFloat("attack", &attack, 0.0f, 3.0f)) {
+            mRogoSynth->attack(attack);
+        }
+        if (ImGui::SliderFloat("decay", &decay, 0.0f, 3.0f)) {
+            mRogoSynth->decay(decay);
+        }
+        if (ImGui::SliderFloat("sustain", &sustain, 0.0f, 1.0f)) {
+            mRogoSynth->sustain(sustain);
+        }
+        if (ImGui::SliderFloat("release", &release, 0.0f, 3.0f)) {
+            mRogoSynth->release(release);
+        }
+        if (ImGui::SliderFloat("fine tune (cents)", &fineTune, -100.0f, 100.0f)) {
+            mRogoSynth->fineTune(fineTune);
+        }
+        if (ImGui::SliderFloat("bend range", &bendRange, 0.0f, 24.0f)) {
+            mRogoSynth->bendRange(bendRange);
+        }
+        ImGui::Text("tuning: %s", mRogoSynth->tuningName().c_str());
+        if (mRogoSynth->tuningName() != "12-TET") {
+            ImGui::SameLine();
+            if (ImGui::Button("12-TET")) {
+                mRogoSynth->equalTemperament();
+            }
+        }
+        if (ImGui::SliderFloat("pan", &panPosition, -1.0f, 1.0f)) {
+            mRogoSynth->panPosition(panPosition);
+        }
+        if (ImGui::SliderFloat("pan by pitch", &panSpread, -1.0f, 1.0f)) {
+            mRogoSynth->panSpread(panSpread);
+        }
+        if (ImGui::SliderFloat("LPF cutoff", &cutoff, 20.0f, 2000.0f)) {
+            mRogoSynth->lpfCutoff(cutoff);
+        }
+        if (ImGui::SliderFloat("LPF resonance", &resonance, 0.0f, 100.0f)) {
+            mRogoSynth->lpfResonance(resonance);
+        }
+        if (mRogoSynth->hasImpulseResponse()) {
+            bool reverbTypeChanged = ImGui::RadioButton("algorithmic", &reverbType, 0);
+            ImGui::SameLine();
+            reverbTypeChanged |= ImGui::RadioButton("convolution", &reverbType, 1);
+            if (reverbTypeChanged) {
+                mRogoSynth->reverbType((ReverbType)reverbType);
+            }
+        }
+        if (reverbType == 0) {
+            if (ImGui::Combo("Reverb Engine", &reverbEngine, reverbEngineNames, IM_ARRAYSIZE(reverbEngineNames))) {
+                mRogoSynth->reverbEngine((ReverbEngine)reverbEngine);
+            }
+            if (ImGui::Combo("Reverb Preset", &reverbPreset, reverbPresetNames, IM_ARRAYSIZE(reverbPresetNames))) {
+                mRogoSynth->reverbPreset((sf_reverb_preset)reverbPreset);
+            }
+        }
+        else {
+            if (ImGui::SliderFloat("IR wet", &convolutionWet, 0.0f, 1.0f)) {
+                mRogoSynth->convolutionWet(convolutionWet);
+            }
+        }
         ImGui::Text(pitchString.c_str());
+        if (ImGui::CollapsingHeader("Modulation")) {
+            showModulation();
+        }
+        if (ImGui::CollapsingHeader("FM")) {
+            showFm();
+        }
+        if (ImGui::CollapsingHeader("Wavetable")) {
+            showWavetable();
+        }
+        if (ImGui::CollapsingHeader("Audio Stats")) {
+            showAudioStats();
+        }
+        if (ImGui::CollapsingHeader("Stage Profile")) {
+            showStageProfile();
+        }
         // ImGui::Text("Framerate  : %.1f ms or %.1f Hz",
         //            1000.0f / ImGui::GetIO().Framerate,
         //            ImGui::GetIO().Framerate);
@@ -488,32 +672,170 @@ void App::showGUI()
     }
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
 
-    // Update current state after GUI update
-    switch (typeInt) {
-    case 0:
-        type = WaveType::sine;
-        break;
-    case 1:
-        type = WaveType::sawtooth;
-        break;
-    case 2:
-        type = WaveType::square;
-        break;
-    case 3:
-        type = WaveType::triangle;
-        break;
+// LFOs, the mod envelope and the routing table
+void App::showModulation()
+{
+    static const char *lfoShapes[] = {"sine",   "triangle",      "sawtooth",
+                                      "square", "sample & hold", "random"};
+    static const char *triggers[] = {"free", "retrigger"};
+    // tempo sync divisions in beats per cycle, 0 = rate in Hz
+    static const char *divisions[] = {"off", "1/16", "1/8", "1/4", "1/2", "1 bar", "2 bars"};
+    static const float divisionBeats[] = {0.0f, 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f};
+    static const char *sources[] = {"none", "LFO 1", "LFO 2", "mod envelope", "pitch bend",
+                                    "mod wheel"};
+    static const char *dests[] = {"pitch (12 semitones)", "amplitude", "pan",
+                                  "cutoff (4 octaves)", "wavetable position"};
+    ModMatrix *mod = mRogoSynth->modMatrix();
+    float tempo = mod->tempo();
+    if (ImGui::SliderFloat("tempo (bpm)", &tempo, 20.0f, 300.0f)) {
+        mod->tempo(tempo);
+    }
+    for (int i = 0; i < ModMatrix::NUM_LFOS; i++) {
+        ImGui::PushID(i);
+        ImGui::Text("LFO %d", i + 1);
+        LfoBank &lfo = mod->lfo(i);
+        int shape = (int)lfo.shape(), trigger = (int)lfo.trigger();
+        float rate = lfo.rate(), phase = lfo.startPhase();
+        int division = 0;
+        for (int d = 0; d < IM_ARRAYSIZE(divisionBeats); d++) {
+            if (divisionBeats[d] == lfo.sync()) {
+                division = d;
+            }
+        }
+        if (ImGui::Combo("shape", &shape, lfoShapes, IM_ARRAYSIZE(lfoShapes))) {
+            lfo.shape((LfoShape)shape);
+        }
+        if (ImGui::Combo("sync", &division, divisions, IM_ARRAYSIZE(divisions))) {
+            lfo.sync(divisionBeats[division]);
+        }
+        if (division == 0 && ImGui::SliderFloat("rate (Hz)", &rate, 0.01f, 20.0f)) {
+            lfo.rate(rate);
+        }
+        if (ImGui::Combo("trigger", &trigger, triggers, IM_ARRAYSIZE(triggers))) {
+            lfo.trigger((LfoTrigger)trigger);
+        }
+        if (lfo.trigger() == LfoTrigger::retrigger &&
+            ImGui::SliderFloat("start phase", &phase, 0.0f, 1.0f)) {
+            lfo.startPhase(phase);
+        }
+        ImGui::PopID();
+    }
+
+    ImGui::Text("mod envelope");
+    Envelope &env = mRogoSynth->modEnvelope();
+    float attack = env.attack(), decay = env.decay();
+    float sustain = env.sustain(), release = env.release();
+    bool envChanged = ImGui::SliderFloat("mod attack", &attack, 0.0f, 5.0f);
+    envChanged |= ImGui::SliderFloat("mod decay", &decay, 0.0f, 5.0f);
+    envChanged |= ImGui::SliderFloat("mod sustain", &sustain, 0.0f, 1.0f);
+    envChanged |= ImGui::SliderFloat("mod release", &release, 0.0f, 5.0f);
+    if (envChanged) {
+        mRogoSynth->modEnvelope(attack, decay, sustain, release);
+    }
+
+    for (int i = 0; i < ModMatrix::MAX_ROUTES; i++) {
+        ImGui::PushID(100 + i);
+        ImGui::Separator();
+        ModRoute route = mod->route(i);
+        int source = (int)route.source, dest = (int)route.dest;
+        bool changed = ImGui::Combo("source", &source, sources, IM_ARRAYSIZE(sources));
+        changed |= ImGui::Combo("destination", &dest, dests, IM_ARRAYSIZE(dests));
+        changed |= ImGui::SliderFloat("amount", &route.amount, -1.0f, 1.0f);
+        if (changed) {
+            route.source = (ModSource)source;
+            route.dest = (ModDest)dest;
+            mod->route(i, route);
+        }
+        ImGui::PopID();
+    }
+}
+
+// the operators played by the fm wave type
+void App::showFm()
+{
+    static const char *algorithms[] = {"0: 3>2>1>0",     "1: (2+3)>1>0", "2: (1+(3>2))>0",
+                                       "3: ((3>1)+2)>0", "4: 1>0, 3>2",  "5: 3>(0,1,2)",
+                                       "6: 3>2, 1, 0",   "7: 0, 1, 2, 3"};
+    FmPatch *fm = mRogoSynth->fmPatch();
+    int algorithm = fm->algorithm();
+    float feedback = fm->feedback();
+    if (ImGui::Combo("algorithm", &algorithm, algorithms, IM_ARRAYSIZE(algorithms))) {
+        fm->algorithm(algorithm);
+    }
+    if (ImGui::SliderFloat("feedback (op 3)", &feedback, 0.0f, 1.0f)) {
+        fm->feedback(feedback);
+    }
+    for (int i = 0; i < FmPatch::NUM_OPERATORS; i++) {
+        ImGui::PushID(200 + i);
+        ImGui::Separator();
+        ImGui::Text("operator %d", i);
+        FmPatch::Operator op = fm->op(i);
+        bool changed = ImGui::SliderFloat("ratio", &op.ratio, 0.125f, 32.0f);
+        changed |= ImGui::SliderFloat("level", &op.level, 0.0f, 1.0f);
+        changed |= ImGui::SliderFloat("attack", &op.attack, 0.0f, 5.0f);
+        changed |= ImGui::SliderFloat("decay", &op.decay, 0.0f, 5.0f);
+        changed |= ImGui::SliderFloat("sustain", &op.sustain, 0.0f, 1.0f);
+        changed |= ImGui::SliderFloat("release", &op.release, 0.0f, 5.0f);
+        if (changed) {
+            fm->op(i, op);
+        }
+        ImGui::PopID();
+    }
+}
+
+// the imported frames played by the wavetable wave type
+void App::showWavetable()
+{
+    Wavetable *table = mRogoSynth->wavetable();
+    if (!table->loaded()) {
+        ImGui::Text("none loaded, use -W");
+        return;
+    }
+    ImGui::Text("%s: %d frames%s", table->name().c_str(), table->frames(),
+                table->ready() ? "" : " (building mip-maps)");
+    float position = table->position();
+    if (ImGui::SliderFloat("position", &position, 0.0f, 1.0f)) {
+        table->position(position);
+    }
+}
+
+// DSP load of the audio callback against its deadline
+void App::showAudioStats()
+{
+    float bins[AudioStats::NUM_BINS];
+    mAudioStats.histogram(bins);
+    ImGui::Text("DSP load   : %5.1f%% now, %5.1f%% avg, %5.1f%% peak",
+                mAudioStats.load(), mAudioStats.avgLoad(), mAudioStats.peakLoad());
+    ImGui::Text("deadline   : %.2f ms, longest gap %.2f ms", mAudioStats.deadlineMs(),
+                mAudioStats.maxIntervalMs());
+    ImGui::Text("callbacks  : %llu, %llu overruns, %llu late",
+                (unsigned long long)mAudioStats.callbacks(),
+                (unsigned long long)mAudioStats.overruns(),
+                (unsigned long long)mAudioStats.late());
+    ImGui::PlotHistogram("load (5% bins)", bins, AudioStats::NUM_BINS, 0, NULL, 0.0f,
+                         FLT_MAX, ImVec2(0, 60));
+    if (ImGui::Button("Reset")) {
+        mAudioStats.requestReset();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save JSON")) {
+        mAudioStats.saveJSON("audiostats.json");
+    }
+}
+
+// where the callback's time goes, per stage and per voice
+void App::showStageProfile()
+{
+    StageProfiler *profiler = mRogoSynth->profiler();
+    float deadline = (float)mAudioStats.deadlineMs() * 1000.0f;
+    ImGui::Text("%-12s %8s %8s %8s %6s", "stage", "avg us", "p99 us", "max us", "% dl");
+    for (int i = 0; i < profiler->numSlots(); i++) {
+        StageProfiler::Summary s = profiler->summary(i);
+        ImGui::Text("%-12s %8.1f %8.1f %8.1f %5.1f%%", profiler->name(i).c_str(), s.avg,
+                    s.p99, s.max, 100.0f * s.avg / deadline);
     }
-    mRogoSynth->amplitude(amplitude);
-    mRogoSynth->attack(attack);
-    mRogoSynth->decay(decay);
-    mRogoSynth->sustain(sustain);
-    mRogoSynth->release(release);
-    mRogoSynth->type(type);
-    mRogoSynth->panPosition(panPosition);
-    mRogoSynth->lpfCutoff(cutoff);
-    mRogoSynth->lpfResonance(resonance);
-    mRogoSynth->reverbPreset((sf_reverb_preset)reverbPreset);
 }
 
 void App::update()
@@ -552,6 +874,133 @@ void App::update()
     }
 }
 
+static void renderBuffer(RogoSynth *synth, float *buffer, bool flushDenormals)
+{
+    memset(buffer, 0, sizeof(float) * AUDIO_BUFFER_SAMPLES);
+    if (flushDenormals) {
+        ScopedDenormalsDisable noDenormals;
+        synth->updateSamples(buffer, AUDIO_BUFFER_SAMPLES);
+    }
+    else {
+        synth->updateSamples(buffer, AUDIO_BUFFER_SAMPLES);
+    }
+}
+
+// Play a chord, release it and time the callbacks over the reverb tail,
+// first in the thread's default floating point mode and then the way the
+// audio callback runs, with denormals flushed to zero.
+void App::benchmark(const AppOptions &options)
+{
+    const int chordSeconds = 1;
+    const int windowSeconds = 5;
+    const int numWindows = 12;
+    const int callbacksPerWindow = windowSeconds * SAMPLE_RATE / AUDIO_BUFFER_STEREO_SAMPLES;
+    const double deadline = 1.0e6 * AUDIO_BUFFER_STEREO_SAMPLES / SAMPLE_RATE;
+    const int chord[] = {48, 52, 55, 59};
+    double avg[2][numWindows], peak[2][numWindows];
+
+    for (int pass = 0; pass < 2; pass++) {
+        RogoSynth *synth = new RogoSynth();
+        if (!options.impulseResponse.empty()) {
+            if (!synth->loadImpulseResponse(options.impulseResponse.c_str())) {
+                delete synth;
+                return;
+            }
+        }
+        else {
+            synth->reverbPreset(SF_REVERB_PRESET_LONGREVERB2);
+            // the chord picks up the new preset, so its crossfade isn't timed
+            synth->waitReverb();
+        }
+        for (int i = 0; i < IM_ARRAYSIZE(chord); i++) {
+            synth->noteOn(i, chord[i]);
+        }
+        for (int c = 0; c < chordSeconds * SAMPLE_RATE / AUDIO_BUFFER_STEREO_SAMPLES; c++) {
+            renderBuffer(synth, mAudioBuffer, pass == 1);
+        }
+        for (int i = 0; i < IM_ARRAYSIZE(chord); i++) {
+            synth->noteOff(i);
+        }
+        for (int w = 0; w < numWindows; w++) {
+            double sum = 0.0, max = 0.0;
+            for (int c = 0; c < callbacksPerWindow; c++) {
+                auto t0 = std::chrono::steady_clock::now();
+                renderBuffer(synth, mAudioBuffer, pass == 1);
+                double us = std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - t0)
+                                .count();
+                sum += us;
+                max = std::max(max, us);
+            }
+            avg[pass][w] = sum / callbacksPerWindow;
+            peak[pass][w] = max;
+        }
+        delete synth;
+    }
+
+    printf("callback time after note off, us (deadline %.0f us)\n", deadline);
+    printf("  tail s    denormals avg/max     flushed avg/max\n");
+    for (int w = 0; w < numWindows; w++) {
+        printf("  %2d-%2d   %9.0f %9.0f   %9.0f %9.0f\n", w * windowSeconds,
+               (w + 1) * windowSeconds, avg[0][w], peak[0][w], avg[1][w], peak[1][w]);
+    }
+}
+
+// Render the MIDI file into a .wav as fast as the engine can go, then let
+// the notes and the reverb ring out until a second of silence.  Nothing
+// here depends on wall clock or thread timing, so a file and a patch always
+// render the same output.
+void App::renderMidi(const AppOptions &options)
+{
+    const int maxTailSeconds = 20;
+    const float silence = 1.0e-4f; // -80dB
+    const int frames = AUDIO_BUFFER_STEREO_SAMPLES;
+    uint64_t maxFrames = mSequencer->length() + maxTailSeconds * SAMPLE_RATE + frames;
+    // blocks go to disk as they are rendered, so memory doesn't grow with
+    // the length of the piece
+    WavWriter writer;
+    if (!writer.open(options.outputPath.c_str(), options.outputFormat, 2, SAMPLE_RATE)) {
+        return;
+    }
+    // the first notes would be silent while the mip-maps are still building
+    mRogoSynth->wavetable()->wait();
+
+    ScopedDenormalsDisable noDenormals;
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t rendered = 0;
+    int quietFrames = 0;
+    while (!mSequencer->finished() ||
+           (quietFrames < SAMPLE_RATE && rendered + frames <= maxFrames)) {
+        memset(mAudioBuffer, 0, sizeof(float) * AUDIO_BUFFER_SAMPLES);
+        uint64_t frame = mSequencer->frame();
+        int count;
+        const MidiEvent *events = mSequencer->advance(frames, count);
+        mRogoSynth->updateSamples(mAudioBuffer, AUDIO_BUFFER_SAMPLES, events, count, frame);
+        if (!writer.write(mAudioBuffer, frames)) {
+            break;
+        }
+        rendered += frames;
+
+        float peak = 0.0f;
+        for (int i = 0; i < AUDIO_BUFFER_SAMPLES; i++) {
+            peak = std::max(peak, fabsf(mAudioBuffer[i]));
+        }
+        bool active = false;
+        for (int i = 0; i < mRogoSynth->numSynths(); i++) {
+            active |= mRogoSynth->active(i);
+        }
+        quietFrames = (peak < silence && !active) ? quietFrames + frames : 0;
+    }
+    if (!writer.close()) {
+        return;
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double length = (double)rendered / SAMPLE_RATE;
+    printf("rendered %.1f s in %.2f s (%.0fx realtime) to %s\n", length, seconds,
+           length / std::max(seconds, 1.0e-6), options.outputPath.c_str());
+}
+
 void App::resize(unsigned width, unsigned height)
 {
     if (width > 0 && height > 0 &&
@@ -664,41 +1113,52 @@ int App::symToPitch(SDL_Keycode sym)
         pitch = 40;
         break;
     }
+    // MIDI note numbers: z is C3 (48), q is C4 (60)
     if (pitch > 0) {
-        pitch += 2 * 12;
+        pitch += 3 * 12;
     }
     return pitch;
 }
 
 void App::audioCallback(Uint8 *byte_stream, int byte_stream_size_in_bytes)
 {
-    static int last_t0 = -1;
-    static int last_t1 = -1;
-    MTR_BEGIN("audio", "callback");
+    Realtime::configureThread(ThreadRole::audio, "audio");
+    ScopedDenormalsDisable noDenormals;
+    mAudioStats.begin();
+    Trace::markAudioThread();
+    TRACE_BEGIN("audio", "callback");
     assert(AUDIO_BUFFER_SAMPLES * 2 == byte_stream_size_in_bytes);
-    int t0 = SDL_GetTicks();
-    int dt0 = (last_t0 > 0) ? t0 - last_t0 : 0;
-    int dt1 = (last_t0 > 0) ? t0 - last_t1 : 0;
-    MTR_COUNTER("audio", "dt0", dt0);
-    MTR_COUNTER("audio", "dt1", dt1);
     // zero the buffers
     //memset(byte_stream, 0, byte_stream_size_in_bytes);
     memset(mAudioBuffer, 0, sizeof(float) * AUDIO_BUFFER_SAMPLES);
 
-    mRogoSynth->updateSamples(mAudioBuffer, AUDIO_BUFFER_SAMPLES);
+    if (mSequencer != nullptr) {
+        uint64_t frame = mSequencer->frame();
+        int count;
+        const MidiEvent *events = mSequencer->advance(AUDIO_BUFFER_STEREO_SAMPLES, count);
+        mRogoSynth->updateSamples(mAudioBuffer, AUDIO_BUFFER_SAMPLES, events, count, frame);
+    }
+    else {
+        mRogoSynth->updateSamples(mAudioBuffer, AUDIO_BUFFER_SAMPLES);
+    }
+    // every published frame redraws the UI, so an idle synth only publishes
+    // the first silent one (below the 16 bit output's LSB)
+    bool silent = true;
+    for (int i = 0; i < AUDIO_BUFFER_SAMPLES && silent; i++) {
+        silent = fabsf(mAudioBuffer[i]) * (float)INT16_MAX < 1.0f;
+    }
+    if (!silent || !mScopeSilent) {
+        memcpy(mScopeFrames->back().samples, mAudioBuffer, sizeof(float) * AUDIO_BUFFER_SAMPLES);
+        mScopeFrames->publish();
+    }
+    mScopeSilent = silent;
 
     // convert to 16-bit samples
     Sint16 *short_stream = (Sint16 *)byte_stream;
     for (int i = 0; i < AUDIO_BUFFER_SAMPLES; i++) {
         short_stream[i] = (Sint16)(mAudioBuffer[i] * (float)INT16_MAX);
     }
-    int t1 = SDL_GetTicks();
-    // if(t0 - last_t0 >
-    // (int)(1000*((float)AUDIO_BUFFER_STEREO_SAMPLES/SAMPLE_RATE))) {
-    //    std::cout << "dLast = " << t0 - last_t0 << " dThis = " << t1 - t0 <<
-    //    "\n";
-    //}
-    last_t0 = t0;
-    last_t1 = t1;
-    MTR_END("audio", "callback");
+    TRACE_END("audio", "callback");
+    mAudioStats.end();
+    TRACE_COUNTER("audio", "load%", mAudioStats.load());
 }
@@ -6,13 +6,33 @@
 
 #include "appGL.h"
 #include "appWindow.h"
+#include "audiostats.h"
+#include "realtime.h"
 #include "rogosynth.h"
+#include "sequencer.h"
+#include "triplebuffer.h"
+#include "wavfile.h"
 
 #include <GL/glew.h>
 #include <SDL.h>
 #include <algorithm>
 #include <iostream>
 #include <string>
+#include <vector>
+
+// command line options, filled in by main()
+struct AppOptions {
+    std::string impulseResponse;               // .wav for the convolution reverb
+    std::string tracePath;                     // start tracing here right away
+    bool benchmark = false;                    // time a reverb tail offline and exit
+    std::string midiFile;                      // play this .mid
+    std::string scalaFile;                     // tune to this .scl scale
+    std::vector<std::string> sampleFiles;      // .wav samples to play, each at its root
+    std::string wavetableFile;                 // .wav wavetable frames to import
+    std::string outputPath;                    // render midiFile offline to this .wav and exit
+    WavFormat outputFormat = WavFormat::pcm16; // and write it in this format
+    RealtimeOptions realtime;                  // handed to Realtime::configure() by main()
+};
 
 class App {
 
@@ -21,10 +41,17 @@ class App {
     bool initAudio();
     void loop();
     void showGUI();
+    void showModulation();
+    void showFm();
+    void showWavetable();
+    void showAudioStats();
+    void showStageProfile();
     void update();
     void cleanup();
     void resize(unsigned width, unsigned height);
     int symToPitch(SDL_Keycode sym);
+    void benchmark(const AppOptions &options);
+    void renderMidi(const AppOptions &options);
 
     AppWindow *mAppWindow;
     AppGL *mAppGL;
@@ -36,6 +63,13 @@ class App {
 
     RogoSynth *mRogoSynth;
     float *mAudioBuffer;
+    AudioStats mAudioStats;
+    // latest output for the scope, audio thread -> UI
+    TripleBuffer<ScopeFrame> *mScopeFrames;
+    // the last buffer was silent, so a silent one needn't be published (audio thread)
+    bool mScopeSilent;
+    // MIDI file playback, nullptr without one
+    Sequencer *mSequencer;
 
     bool mSwitchFullscreen;
     bool mIsFullscreen;
@@ -47,11 +81,12 @@ class App {
     double mMouseX, mMouseY;
     double mCenterStartX, mCenterStartY;
     bool mShowGUI;
+    std::string mTracePath;
 
   public:
     App();
     ~App();
-    void run();
+    void run(const AppOptions &options);
     void audioCallback(Uint8 *byte_stream, int byte_stream_length);
 };
 #endif
@@ -2,6 +2,7 @@
 #define ROGOSYNTH_APP_GL_H
 
 #include "appWindow.h"
+#include "scopeGL.h"
 
 #include "glm/ext.hpp"
 #include "glm/glm.hpp"
@@ -16,6 +17,7 @@ void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id,
 class AppGL {
     AppWindow *mWindow;
     glm::mat4 mCameraToView;
+    ScopeGL *mScope;
 
   public:
     AppGL(AppWindow *appWindow, unsigned maxWidth, unsigned maxHeight)
@@ -38,8 +40,9 @@ class AppGL {
         // During init, enable debug output
         glEnable(GL_DEBUG_OUTPUT);
         glDebugMessageCallback(MessageCallback, 0);
+        mScope = new ScopeGL();
     }
-    ~AppGL() {}
+    ~AppGL() { delete mScope; }
     void handleResize()
     {
         glViewport(0, 0, mWindow->width(), mWindow->height());
@@ -57,7 +60,12 @@ class AppGL {
             mCameraToView = glm::ortho(0.0f, xpos, ypos, 0.0f);
         }
     }
-    void render() { glClear(GL_COLOR_BUFFER_BIT); }
+    void audioFrame(const ScopeFrame &frame) { mScope->update(frame); }
+    void render()
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        mScope->render();
+    }
 };
 
 #endif
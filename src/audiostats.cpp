@@ -0,0 +1,101 @@
+#include "audiostats.h"
+#include <fstream>
+#include <iostream>
+
+AudioStats::AudioStats()
+    : mDeadline((double)AUDIO_BUFFER_STEREO_SAMPLES / SAMPLE_RATE),
+      mHaveLast(false)
+{
+    for (int i = 0; i < NUM_BINS; i++) {
+        mBins[i].store(0);
+    }
+}
+
+void AudioStats::reset()
+{
+    mCallbacks.store(0, std::memory_order_relaxed);
+    mOverruns.store(0, std::memory_order_relaxed);
+    mLate.store(0, std::memory_order_relaxed);
+    mPeakLoad.store(0.0f, std::memory_order_relaxed);
+    mMaxInterval.store(0.0f, std::memory_order_relaxed);
+    for (int i = 0; i < NUM_BINS; i++) {
+        mBins[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void AudioStats::begin()
+{
+    if (mResetRequested.exchange(false)) {
+        reset();
+    }
+    mStart = Clock::now();
+    if (mHaveLast) {
+        double interval = std::chrono::duration<double>(mStart - mLastStart).count();
+        if (interval > mDeadline * LATE_FACTOR) {
+            mLate.fetch_add(1, std::memory_order_relaxed);
+        }
+        float ms = (float)(interval * 1000.0);
+        if (ms > mMaxInterval.load(std::memory_order_relaxed)) {
+            mMaxInterval.store(ms, std::memory_order_relaxed);
+        }
+    }
+    mLastStart = mStart;
+    mHaveLast = true;
+}
+
+void AudioStats::end()
+{
+    double render = std::chrono::duration<double>(Clock::now() - mStart).count();
+    float load = (float)(100.0 * render / mDeadline);
+    mLoad.store(load, std::memory_order_relaxed);
+    // one pole smoothing with a time constant of roughly a second
+    const float smooth = (float)(mDeadline / (mDeadline + 1.0));
+    float avg = mAvgLoad.load(std::memory_order_relaxed);
+    mAvgLoad.store(avg + smooth * (load - avg), std::memory_order_relaxed);
+    if (load > mPeakLoad.load(std::memory_order_relaxed)) {
+        mPeakLoad.store(load, std::memory_order_relaxed);
+    }
+    if (render > mDeadline) {
+        mOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    int bin = (int)(load / BIN_PERCENT);
+    if (bin >= NUM_BINS - 1 || render > mDeadline) {
+        bin = NUM_BINS - 1;
+    }
+    mBins[bin].fetch_add(1, std::memory_order_relaxed);
+    mCallbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioStats::histogram(float *bins)
+{
+    for (int i = 0; i < NUM_BINS; i++) {
+        bins[i] = (float)mBins[i].load(std::memory_order_relaxed);
+    }
+}
+
+bool AudioStats::saveJSON(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "ERROR: Couldn't write " << path << "\n";
+        return false;
+    }
+    out << "{\n";
+    out << "  \"sampleRate\": " << SAMPLE_RATE << ",\n";
+    out << "  \"bufferFrames\": " << AUDIO_BUFFER_STEREO_SAMPLES << ",\n";
+    out << "  \"deadlineMs\": " << deadlineMs() << ",\n";
+    out << "  \"callbacks\": " << callbacks() << ",\n";
+    out << "  \"overruns\": " << overruns() << ",\n";
+    out << "  \"lateCallbacks\": " << late() << ",\n";
+    out << "  \"maxIntervalMs\": " << maxIntervalMs() << ",\n";
+    out << "  \"loadPercent\": {\"last\": " << load() << ", \"average\": " << avgLoad()
+        << ", \"peak\": " << peakLoad() << "},\n";
+    out << "  \"histogramBinPercent\": " << BIN_PERCENT << ",\n";
+    out << "  \"histogram\": [";
+    for (int i = 0; i < NUM_BINS; i++) {
+        out << (i ? ", " : "") << mBins[i].load(std::memory_order_relaxed);
+    }
+    out << "]\n}\n";
+    std::cout << "audio stats written to " << path << "\n";
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef ROGOSYNTH_AUDIOSTATS_H
+#define ROGOSYNTH_AUDIOSTATS_H
+#include "constants.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-callback timing of the audio thread against its deadline (the time it
+// takes to play one buffer).  The audio thread is the only writer; the UI
+// reads the relaxed atomics whenever it likes, so a reading may mix two
+// callbacks but never blocks the audio thread.
+class AudioStats {
+  public:
+    // render time histogram, in 5% steps of the deadline; the last bin
+    // collects every overrun
+    static const int NUM_BINS = 21;
+    static const int BIN_PERCENT = 5;
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // a callback arriving this much later than one buffer after the
+    // previous one means the device probably ran dry in between
+    static constexpr double LATE_FACTOR = 1.5;
+
+    const double mDeadline; // seconds
+    Clock::time_point mStart;
+    Clock::time_point mLastStart;
+    bool mHaveLast;
+
+    std::atomic<uint64_t> mCallbacks{0};
+    std::atomic<uint64_t> mOverruns{0};
+    std::atomic<uint64_t> mLate{0};
+    std::atomic<float> mLoad{0.0f};     // last callback, percent
+    std::atomic<float> mAvgLoad{0.0f};  // smoothed over ~1s
+    std::atomic<float> mPeakLoad{0.0f};
+    std::atomic<float> mMaxInterval{0.0f}; // ms between callback starts
+    std::atomic<uint32_t> mBins[NUM_BINS];
+    std::atomic<bool> mResetRequested{false};
+
+    void reset();
+
+  public:
+    AudioStats();
+    // audio thread: bracket the work of one callback
+    void begin();
+    void end();
+    // UI thread: ask the audio thread to clear everything on its next call
+    void requestReset() { mResetRequested.store(true); }
+
+    double deadlineMs() { return mDeadline * 1000.0; }
+    uint64_t callbacks() { return mCallbacks.load(std::memory_order_relaxed); }
+    uint64_t overruns() { return mOverruns.load(std::memory_order_relaxed); }
+    uint64_t late() { return mLate.load(std::memory_order_relaxed); }
+    float load() { return mLoad.load(std::memory_order_relaxed); }
+    float avgLoad() { return mAvgLoad.load(std::memory_order_relaxed); }
+    float peakLoad() { return mPeakLoad.load(std::memory_order_relaxed); }
+    float maxIntervalMs() { return mMaxInterval.load(std::memory_order_relaxed); }
+    // copy the histogram (as floats, for ImGui::PlotHistogram)
+    void histogram(float *bins);
+    bool saveJSON(const std::string &path);
+};
+#endif
@@ -6,5 +6,8 @@ const int AUDIO_BUFFER_STEREO_SAMPLES = 2048; // must be power of two.
 const int AUDIO_BUFFER_SAMPLES = AUDIO_BUFFER_STEREO_SAMPLES * 2;
 const int SAMPLE_RATE = 44100;
 const float SAMPLE_PERIOD = 1.0f / SAMPLE_RATE;
-const float CHROMATIC_BASE = powf(2.0f, 1.0f / 12.0f);
+// Modulation is evaluated once per control tick and voices interpolate
+// linearly between ticks, so its cost doesn't grow with the sample rate.
+const int CONTROL_RATE = 32; // frames per control tick
+const int CONTROL_TICKS = AUDIO_BUFFER_STEREO_SAMPLES / CONTROL_RATE;
 #endif
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "convolver.h"
+#include "denormals.h"
+#include "mappedfile.h"
+#include "realtime.h"
+#include "simd.h"
+#include "wavfile.h"
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// y += x * h over n complex bins in split format.  n is a multiple of 4.
+static void complexMultiplyAdd(const float *xr, const float *xi, const float *hr,
+                               const float *hi, float *yr, float *yi, int n)
+{
+#if defined(ROGOSYNTH_SSE)
+    for (int k = 0; k < n; k += 4) {
+        __m128 a = _mm_loadu_ps(xr + k), b = _mm_loadu_ps(xi + k);
+        __m128 c = _mm_loadu_ps(hr + k), d = _mm_loadu_ps(hi + k);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(a, c), _mm_mul_ps(b, d));
+        __m128 im = _mm_add_ps(_mm_mul_ps(a, d), _mm_mul_ps(b, c));
+        _mm_storeu_ps(yr + k, _mm_add_ps(_mm_loadu_ps(yr + k), re));
+        _mm_storeu_ps(yi + k, _mm_add_ps(_mm_loadu_ps(yi + k), im));
+    }
+#elif defined(ROGOSYNTH_NEON)
+    for (int k = 0; k < n; k += 4) {
+        float32x4_t a = vld1q_f32(xr + k), b = vld1q_f32(xi + k);
+        float32x4_t c = vld1q_f32(hr + k), d = vld1q_f32(hi + k);
+        float32x4_t re = vmlsq_f32(vmlaq_f32(vld1q_f32(yr + k), a, c), b, d);
+        float32x4_t im = vmlaq_f32(vmlaq_f32(vld1q_f32(yi + k), a, d), b, c);
+        vst1q_f32(yr + k, re);
+        vst1q_f32(yi + k, im);
+    }
+#else
+    for (int k = 0; k < n; k++) {
+        yr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+        yi[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+#endif
+}
+
+// multiply-accumulate both channels of a spectrum
+static inline void spectrumMultiplyAdd(const float *x, const float *h, float *y,
+                                       int bins)
+{
+    complexMultiplyAdd(x, x + bins, h, h + bins, y, y + bins, bins);
+    complexMultiplyAdd(x + 2 * bins, x + 3 * bins, h + 2 * bins, h + 3 * bins,
+                       y + 2 * bins, y + 3 * bins, bins);
+}
+
+Convolver::Convolver()
+{
+    mPlan = {};
+    mNumPartitions = mHeadPartitions = 0;
+    mIR = nullptr;
+    mFDLSize = 0;
+    mFDL = nullptr;
+    mBlock = 0;
+    mWet = 0.3f;
+    mDry = 1.0f;
+    mTail[0] = mTail[1] = nullptr;
+    mQuit = false;
+    std::memset(mInputL, 0, sizeof(mInputL));
+    std::memset(mInputR, 0, sizeof(mInputR));
+}
+
+Convolver::~Convolver()
+{
+    if (mWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWake.notify_one();
+        mWorker.join();
+    }
+    fft_free(&mPlan);
+    delete[] mIR;
+    delete[] mFDL;
+    delete[] mTail[0];
+    delete[] mTail[1];
+}
+
+// Transform FFT_SIZE stereo samples (L in re, R in im) into separate L and
+// R half spectra.  The work buffers are overwritten.
+void Convolver::transformBlock(const float *re, const float *im, float *spectrum)
+{
+    std::memcpy(mWorkRe, re, sizeof(mWorkRe));
+    std::memcpy(mWorkIm, im, sizeof(mWorkIm));
+    fft_forward(&mPlan, mWorkRe, mWorkIm);
+    float *lr = spectrum, *li = lr + NUM_BINS;
+    float *rr = li + NUM_BINS, *ri = rr + NUM_BINS;
+    // Z = L + iR, so L[k] = (Z[k] + conj(Z[n-k])) / 2 and
+    // R[k] = (Z[k] - conj(Z[n-k])) / 2i
+    for (int k = 0; k <= BLOCK_SIZE; k++) {
+        int nk = (FFT_SIZE - k) & (FFT_SIZE - 1);
+        float zr = mWorkRe[k], zi = mWorkIm[k];
+        float cr = mWorkRe[nk], ci = -mWorkIm[nk];
+        lr[k] = 0.5f * (zr + cr);
+        li[k] = 0.5f * (zi + ci);
+        rr[k] = 0.5f * (zi - ci);
+        ri[k] = -0.5f * (zr - cr);
+    }
+    for (int k = BLOCK_SIZE + 1; k < NUM_BINS; k++) {
+        lr[k] = li[k] = rr[k] = ri[k] = 0.0f;
+    }
+}
+
+bool Convolver::load(const char *path, bool backgroundTail)
+{
+    assert(mIR == nullptr);
+    MappedFile file;
+    WavInfo info;
+    if (!file.open(path) || !parseWav(file.data(), file.size(), path, info)) {
+        std::cerr << "ERROR: Couldn't load impulse response " << path << "\n";
+        return false;
+    }
+    float *srcL = new float[info.frames];
+    float *srcR = new float[info.frames];
+    readWavFrames(info, 0, info.frames, srcL, srcR);
+    file.close();
+    // linear resample to our rate
+    const int size = (int)std::min<size_t>(info.frames, INT32_MAX);
+    int length = (int)((int64_t)size * SAMPLE_RATE / info.sampleRate);
+    if (length < 1) {
+        length = 1;
+    }
+    float *irL = new float[length];
+    float *irR = new float[length];
+    double ratio = (double)info.sampleRate / SAMPLE_RATE;
+    double energy = 0.0;
+    for (int i = 0; i < length; i++) {
+        double pos = i * ratio;
+        int j = (int)pos;
+        float frac = (float)(pos - j);
+        int j1 = j + 1 < size ? j + 1 : j;
+        irL[i] = srcL[j] + frac * (srcL[j1] - srcL[j]);
+        irR[i] = srcR[j] + frac * (srcR[j1] - srcR[j]);
+        energy += irL[i] * irL[i] + irR[i] * irR[i];
+    }
+    delete[] srcL;
+    delete[] srcR;
+    // normalize to unit energy per channel so IRs are roughly equally loud
+    float gain = energy > 0.0 ? (float)(1.0 / sqrt(energy / 2.0)) : 0.0f;
+
+    if (!fft_init(&mPlan, FFT_SIZE)) {
+        std::cerr << "ERROR: Couldn't allocate FFT tables.\n";
+        delete[] irL;
+        delete[] irR;
+        return false;
+    }
+    mNumPartitions = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    mIR = new float[mNumPartitions * SPECTRUM_SIZE];
+    float re[FFT_SIZE], im[FFT_SIZE];
+    for (int p = 0; p < mNumPartitions; p++) {
+        std::memset(re, 0, sizeof(re));
+        std::memset(im, 0, sizeof(im));
+        for (int i = 0; i < BLOCK_SIZE && p * BLOCK_SIZE + i < length; i++) {
+            re[i] = irL[p * BLOCK_SIZE + i] * gain;
+            im[i] = irR[p * BLOCK_SIZE + i] * gain;
+        }
+        transformBlock(re, im, mIR + p * SPECTRUM_SIZE);
+    }
+    delete[] irL;
+    delete[] irR;
+
+    // The worker can lag the audio thread by up to a buffer while reading
+    // the oldest spectra, so keep two buffers of slack in the FDL.
+    mFDLSize = mNumPartitions + 2 * BLOCKS_PER_BUFFER;
+    mFDL = new float[mFDLSize * SPECTRUM_SIZE];
+    std::memset(mFDL, 0, sizeof(float) * mFDLSize * SPECTRUM_SIZE);
+
+    mHeadPartitions = mNumPartitions;
+    if (backgroundTail && mNumPartitions > BLOCKS_PER_BUFFER) {
+        mHeadPartitions = BLOCKS_PER_BUFFER;
+        mTail[0] = new float[BLOCKS_PER_BUFFER * SPECTRUM_SIZE];
+        mTail[1] = new float[BLOCKS_PER_BUFFER * SPECTRUM_SIZE];
+        mWorker = std::thread(&Convolver::workerLoop, this);
+    }
+#ifndef NDEBUG
+    std::cout << "impulse response: " << length << " samples, "
+              << mNumPartitions << " partitions, " << mHeadPartitions
+              << " on the audio thread\n";
+#endif
+    return true;
+}
+
+// Sum the tail partitions for every block of a buffer into dst.  The worker
+// gives up (returns false) as soon as a newer buffer has been posted,
+// since the audio thread will have computed this one itself by then.
+bool Convolver::sumTail(int64_t buffer, float *dst, bool checkStale)
+{
+    std::memset(dst, 0, sizeof(float) * BLOCKS_PER_BUFFER * SPECTRUM_SIZE);
+    for (int b = 0; b < BLOCKS_PER_BUFFER; b++) {
+        int64_t block = buffer * BLOCKS_PER_BUFFER + b;
+        float *y = dst + b * SPECTRUM_SIZE;
+        for (int p = mHeadPartitions; p < mNumPartitions; p++) {
+            if (block - p < 0) {
+                break;
+            }
+            if (checkStale && mPosted.load(std::memory_order_relaxed) != buffer) {
+                return false;
+            }
+            const float *x = mFDL + ((block - p) % mFDLSize) * SPECTRUM_SIZE;
+            spectrumMultiplyAdd(x, mIR + p * SPECTRUM_SIZE, y, NUM_BINS);
+        }
+    }
+    return true;
+}
+
+void Convolver::workerLoop()
+{
+    Realtime::configureThread(ThreadRole::dsp, "convolution tail");
+    ScopedDenormalsDisable noDenormals;
+    int64_t last = -1;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mQuit) {
+        int64_t buffer = mPosted.load(std::memory_order_acquire);
+        if (buffer == last) {
+            // the audio thread doesn't take the mutex before notifying, so
+            // don't sleep forever on a missed wakeup
+            mWake.wait_for(lock, std::chrono::milliseconds(2));
+            continue;
+        }
+        last = buffer;
+        lock.unlock();
+        if (sumTail(buffer, mTail[buffer & 1], true)) {
+            mDone.store(buffer, std::memory_order_release);
+        }
+        lock.lock();
+    }
+}
+
+void Convolver::updateSamples(float *samples, long length)
+{
+    assert(length == AUDIO_BUFFER_SAMPLES);
+    if (mIR == nullptr) {
+        return;
+    }
+    int64_t buffer = mBlock / BLOCKS_PER_BUFFER;
+    const float *tail = nullptr;
+    if (mHeadPartitions < mNumPartitions) {
+        if (mDone.load(std::memory_order_acquire) == buffer) {
+            tail = mTail[buffer & 1];
+        }
+        else {
+            sumTail(buffer, mTailLocal, false);
+            tail = mTailLocal;
+        }
+    }
+
+    const float scale = 1.0f / FFT_SIZE;
+    for (int b = 0; b < BLOCKS_PER_BUFFER; b++, mBlock++) {
+        float *in = samples + 2 * b * BLOCK_SIZE;
+        // overlap-save: the previous block followed by this one
+        std::memmove(mInputL, mInputL + BLOCK_SIZE, sizeof(float) * BLOCK_SIZE);
+        std::memmove(mInputR, mInputR + BLOCK_SIZE, sizeof(float) * BLOCK_SIZE);
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            mInputL[BLOCK_SIZE + i] = in[2 * i];
+            mInputR[BLOCK_SIZE + i] = in[2 * i + 1];
+        }
+        transformBlock(mInputL, mInputR, mFDL + (mBlock % mFDLSize) * SPECTRUM_SIZE);
+
+        if (tail != nullptr) {
+            std::memcpy(mAccum, tail + b * SPECTRUM_SIZE, sizeof(mAccum));
+        }
+        else {
+            std::memset(mAccum, 0, sizeof(mAccum));
+        }
+        for (int p = 0; p < mHeadPartitions && p <= mBlock; p++) {
+            const float *x = mFDL + ((mBlock - p) % mFDLSize) * SPECTRUM_SIZE;
+            spectrumMultiplyAdd(x, mIR + p * SPECTRUM_SIZE, mAccum, NUM_BINS);
+        }
+
+        // W = YL + iYR, rebuilding the upper half from conjugate symmetry
+        const float *lr = mAccum, *li = lr + NUM_BINS;
+        const float *rr = li + NUM_BINS, *ri = rr + NUM_BINS;
+        for (int k = 0; k <= BLOCK_SIZE; k++) {
+            mWorkRe[k] = lr[k] - ri[k];
+            mWorkIm[k] = li[k] + rr[k];
+            if (k > 0 && k < BLOCK_SIZE) {
+                mWorkRe[FFT_SIZE - k] = lr[k] + ri[k];
+                mWorkIm[FFT_SIZE - k] = rr[k] - li[k];
+            }
+        }
+        fft_inverse(&mPlan, mWorkRe, mWorkIm);
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            float wetL = mWorkRe[BLOCK_SIZE + i] * scale;
+            float wetR = mWorkIm[BLOCK_SIZE + i] * scale;
+            in[2 * i] = mDry * in[2 * i] + mWet * wetL;
+            in[2 * i + 1] = mDry * in[2 * i + 1] + mWet * wetR;
+        }
+    }
+
+    if (mWorker.joinable()) {
+        // hand the next buffer's tail to the worker
+        mPosted.store(buffer + 1, std::memory_order_release);
+        mWake.notify_one();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ROGOSYNTH_CONVOLVER_H
+#define ROGOSYNTH_CONVOLVER_H
+#include "constants.h"
+#include "fft.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Stereo convolution reverb using uniformly partitioned overlap-save FFT
+// convolution.  The impulse response is cut into BLOCK_SIZE sample
+// partitions; every block of input is transformed once into a frequency
+// domain delay line (FDL) and multiplied against each partition's spectrum.
+// Output is produced for each block as soon as its input is available, so
+// there is no latency beyond the audio buffer itself.
+//
+// Left and right are packed into the real and imaginary parts of a single
+// complex FFT, so each block costs one forward and one inverse transform.
+//
+// With a background tail, only the first BLOCKS_PER_BUFFER partitions (the
+// head) are multiplied on the audio thread.  The rest (the tail) only
+// needs input from earlier buffers, so a worker thread sums it for the
+// next buffer while the current one plays.  If the worker hasn't finished
+// when the audio thread needs the result, the audio thread computes the
+// tail itself instead of waiting.
+class Convolver {
+    static const int BLOCK_SIZE = 512;
+    static const int FFT_SIZE = 2 * BLOCK_SIZE;
+    static const int BLOCKS_PER_BUFFER = AUDIO_BUFFER_STEREO_SAMPLES / BLOCK_SIZE;
+    // spectrum bins 0..BLOCK_SIZE, padded to a multiple of 4 for SIMD
+    static const int NUM_BINS = BLOCK_SIZE + 4;
+    // one spectrum is L re, L im, R re, R im
+    static const int SPECTRUM_SIZE = 4 * NUM_BINS;
+
+    fft_plan mPlan;
+    int mNumPartitions;
+    int mHeadPartitions;
+    float *mIR;  // mNumPartitions spectra
+    int mFDLSize;
+    float *mFDL; // mFDLSize spectra, indexed by block % mFDLSize
+    int64_t mBlock;
+    float mInputL[FFT_SIZE], mInputR[FFT_SIZE];
+    float mWorkRe[FFT_SIZE], mWorkIm[FFT_SIZE];
+    float mAccum[SPECTRUM_SIZE];
+    float mTailLocal[BLOCKS_PER_BUFFER * SPECTRUM_SIZE];
+    float mWet, mDry;
+
+    // background tail
+    float *mTail[2]; // per buffer parity, BLOCKS_PER_BUFFER spectra each
+    std::atomic<int64_t> mPosted{-1}; // buffer whose tail the worker should sum
+    std::atomic<int64_t> mDone{-1};   // buffer whose tail is ready in mTail
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mQuit;
+
+    void transformBlock(const float *re, const float *im, float *spectrum);
+    bool sumTail(int64_t buffer, float *dst, bool checkStale);
+    void workerLoop();
+
+  public:
+    Convolver();
+    ~Convolver();
+    // Load an impulse response from a 16, 24 or 32 bit .wav file, resampling
+    // it to SAMPLE_RATE if needed.  Call before the audio starts.
+    bool load(const char *path, bool backgroundTail = true);
+    bool loaded() { return mIR != nullptr; }
+    void updateSamples(float *samples, long length);
+    float wet() { return mWet; }
+    void wet(float v) { mWet = v; }
+};
+#endif
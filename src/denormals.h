@@ -0,0 +1,58 @@
+#ifndef ROGOSYNTH_DENORMALS_H
+#define ROGOSYNTH_DENORMALS_H
+#include "simd.h"
+#include <cstdint>
+
+// While in scope, flush denormal results to zero and treat denormal inputs
+// as zero on this thread.  Feedback loops (reverb tanks, biquad state,
+// envelopes) decay through the denormal range after a note ends, and on x86
+// every such operation takes a slow microcode path.  The previous mode is
+// restored on exit, so it is safe to use inside threads we don't own, like
+// SDL's audio callback.
+class ScopedDenormalsDisable {
+#if defined(ROGOSYNTH_SSE)
+    // MXCSR flush-to-zero (bit 15) and denormals-are-zero (bit 6)
+    static const unsigned int FTZ_DAZ = 0x8040;
+    unsigned int mSaved;
+
+  public:
+    ScopedDenormalsDisable()
+    {
+        mSaved = _mm_getcsr();
+        _mm_setcsr(mSaved | FTZ_DAZ);
+    }
+    ~ScopedDenormalsDisable() { _mm_setcsr(mSaved); }
+#elif defined(__aarch64__)
+    // FPCR flush-to-zero (bit 24) covers inputs and results
+    static const uint64_t FZ = 1ull << 24;
+    uint64_t mSaved;
+
+  public:
+    ScopedDenormalsDisable()
+    {
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(mSaved));
+        uint64_t fpcr = mSaved | FZ;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+    }
+    ~ScopedDenormalsDisable() { __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved)); }
+#elif defined(__arm__) && defined(__ARM_FP)
+    // FPSCR flush-to-zero (bit 24)
+    static const uint32_t FZ = 1u << 24;
+    uint32_t mSaved;
+
+  public:
+    ScopedDenormalsDisable()
+    {
+        __asm__ __volatile__("vmrs %0, fpscr" : "=r"(mSaved));
+        uint32_t fpscr = mSaved | FZ;
+        __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr));
+    }
+    ~ScopedDenormalsDisable() { __asm__ __volatile__("vmsr fpscr, %0" : : "r"(mSaved)); }
+#else
+  public:
+    ScopedDenormalsDisable() {}
+#endif
+    ScopedDenormalsDisable(const ScopedDenormalsDisable &) = delete;
+    ScopedDenormalsDisable &operator=(const ScopedDenormalsDisable &) = delete;
+};
+#endif
@@ -0,0 +1,123 @@
+#include "enginearena.h"
+extern "C" {
+#include "sndfilter/mem.h"
+}
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+std::atomic<EngineArena *> EngineArena::cArenas[EngineArena::MAX_ARENAS];
+EngineArena *EngineArena::cSndfilter = nullptr;
+
+EngineArena::EngineArena(size_t bytes)
+{
+    mMemory = nullptr;
+    mBase = nullptr;
+    mSize = 0;
+    mTop = 0;
+    mLast = 0;
+    mNumObjects = 0;
+    // sf_free must recognize arena memory, so an arena without a slot holds none
+    bool registered = false;
+    for (int i = 0; i < MAX_ARENAS && !registered; i++) {
+        EngineArena *expected = nullptr;
+        registered = cArenas[i].compare_exchange_strong(expected, this);
+    }
+    if (!registered) {
+        std::cerr << "WARNING: more than " << MAX_ARENAS
+                  << " engine arenas, allocating from the heap.\n";
+        return;
+    }
+    // over-allocate by a cache line so the start can be aligned by hand
+    mMemory = (char *)malloc(padded(bytes) + ALIGN);
+    if (mMemory == nullptr) {
+        std::cerr << "ERROR: Couldn't allocate the " << padded(bytes)
+                  << " byte engine arena, allocating from the heap.\n";
+        return;
+    }
+    mSize = padded(bytes);
+    mBase = (char *)(((uintptr_t)mMemory + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1));
+}
+
+EngineArena::~EngineArena()
+{
+    if (cSndfilter == this) {
+        closeSndfilter();
+    }
+    // objects may still sf_free arena memory while they are destroyed
+    for (int i = mNumObjects - 1; i >= 0; i--) {
+        mObjects[i].destroy(mObjects[i].ptr);
+    }
+    for (int i = 0; i < MAX_ARENAS; i++) {
+        EngineArena *expected = this;
+        if (cArenas[i].compare_exchange_strong(expected, nullptr)) {
+            break;
+        }
+    }
+    free(mMemory);
+}
+
+void *EngineArena::allocate(size_t bytes)
+{
+    bytes = padded(bytes);
+    if (bytes > mSize - mTop) {
+        return nullptr;
+    }
+    mLast = mTop;
+    mTop += bytes;
+    return mBase + mLast;
+}
+
+void EngineArena::heapFallback(size_t bytes)
+{
+    if (mSize > 0) {
+        std::cerr << "WARNING: engine arena full, " << bytes << " bytes from the heap.\n";
+    }
+}
+
+void EngineArena::tooManyObjects()
+{
+    std::cerr << "ERROR: more than " << MAX_OBJECTS << " objects in an engine arena.\n";
+    abort();
+}
+
+void EngineArena::release(void *ptr)
+{
+    if ((char *)ptr == mBase + mLast && mLast < mTop) {
+        mTop = mLast;
+    }
+}
+
+void EngineArena::openSndfilter()
+{
+    cSndfilter = this;
+    sf_malloc = sndfilterMalloc;
+    sf_free = sndfilterFree;
+}
+
+// sf_free keeps recognizing arena memory after this
+void EngineArena::closeSndfilter() { cSndfilter = nullptr; }
+
+void *EngineArena::sndfilterMalloc(size_t size)
+{
+    void *ptr = cSndfilter != nullptr ? cSndfilter->allocate(size) : nullptr;
+    if (ptr == nullptr) {
+        if (cSndfilter != nullptr && cSndfilter->mSize > 0) {
+            std::cerr << "WARNING: engine arena full, " << size << " bytes from the heap.\n";
+        }
+        ptr = malloc(size);
+    }
+    return ptr;
+}
+
+void EngineArena::sndfilterFree(void *ptr)
+{
+    for (int i = 0; i < MAX_ARENAS; i++) {
+        EngineArena *arena = cArenas[i].load();
+        if (arena != nullptr && arena->contains(ptr)) {
+            arena->release(ptr);
+            return;
+        }
+    }
+    free(ptr);
+}
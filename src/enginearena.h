@@ -0,0 +1,92 @@
+#ifndef ROGOSYNTH_ENGINEARENA_H
+#define ROGOSYNTH_ENGINEARENA_H
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// One cache-line aligned block holding all of an engine's state.  Objects
+// are placement-new'd into it one after another at construction, each
+// starting on its own cache line so that state rendered by different
+// threads never shares one, and destroyed in reverse order with the arena.
+//
+// While an arena is open for sndfilter, sf_malloc is served from it too, so
+// the reverb delay lines land in the same block.  sf_free recognizes arena
+// memory from every live arena; it can only hand back the most recent
+// allocation, which is all the reverb's reserve-then-grow pattern needs.
+//
+// An arena that couldn't be allocated, or registered for sf_free, is left
+// empty, so everything falls back to the heap and the engine still works.
+// Allocating is meant for construction time and is not thread-safe.
+class EngineArena {
+  public:
+    static const size_t ALIGN = 64;
+    static size_t padded(size_t bytes) { return (bytes + ALIGN - 1) & ~(ALIGN - 1); }
+
+  private:
+    static const int MAX_OBJECTS = 32;
+    static const int MAX_ARENAS = 8;
+
+    struct Object {
+        void *ptr;
+        void (*destroy)(void *);
+    };
+
+    char *mMemory; // as allocated
+    char *mBase;   // aligned start
+    size_t mSize;
+    size_t mTop;
+    size_t mLast; // start of the most recent allocation
+    Object mObjects[MAX_OBJECTS];
+    int mNumObjects;
+
+    static std::atomic<EngineArena *> cArenas[MAX_ARENAS];
+    static EngineArena *cSndfilter;
+    static void *sndfilterMalloc(size_t size);
+    static void sndfilterFree(void *ptr);
+    void heapFallback(size_t bytes);
+    [[noreturn]] static void tooManyObjects();
+
+  public:
+    explicit EngineArena(size_t bytes);
+    ~EngineArena();
+    EngineArena(const EngineArena &) = delete;
+    EngineArena &operator=(const EngineArena &) = delete;
+
+    // nullptr once the arena is full
+    void *allocate(size_t bytes);
+    // give back memory; only the most recent allocation is actually reused
+    void release(void *ptr);
+    bool contains(const void *ptr) const
+    {
+        return (const char *)ptr >= mBase && (const char *)ptr < mBase + mSize;
+    }
+    size_t size() const { return mSize; }
+    size_t used() const { return mTop; }
+
+    // construct a T in the arena, or on the heap if the arena is full or
+    // couldn't be set up; it is destroyed with the arena either way
+    template <typename T, typename... Args> T *create(Args &&...args)
+    {
+        static_assert(alignof(T) <= ALIGN, "EngineArena can't align this type");
+        if (mNumObjects == MAX_OBJECTS) {
+            tooManyObjects();
+        }
+        void *memory = allocate(sizeof(T));
+        if (memory == nullptr) {
+            heapFallback(sizeof(T));
+            T *object = new T(std::forward<Args>(args)...);
+            mObjects[mNumObjects++] = {object, [](void *p) { delete static_cast<T *>(p); }};
+            return object;
+        }
+        T *object = new (memory) T(std::forward<Args>(args)...);
+        mObjects[mNumObjects++] = {object, [](void *p) { static_cast<T *>(p)->~T(); }};
+        return object;
+    }
+
+    // send sf_malloc to this arena (falling back to the heap when it is
+    // full) until closeSndfilter()
+    void openSndfilter();
+    static void closeSndfilter();
+};
+#endif
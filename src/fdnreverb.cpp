@@ -0,0 +1,283 @@
+#include "fdnreverb.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+
+static inline float dbToLinear(float db) { return powf(10.0f, 0.05f * db); }
+
+static bool isPrime(int v)
+{
+    if (v < 2) {
+        return false;
+    }
+    for (int i = 2; i * i <= v; i++) {
+        if (v % i == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int nextPrime(int v)
+{
+    while (!isPrime(v)) {
+        v++;
+    }
+    return v;
+}
+
+static int nextPowerOfTwo(int v)
+{
+    int p = 1;
+    while (p < v) {
+        p *= 2;
+    }
+    return p;
+}
+
+// one-pole lowpass coefficient for y += c * (x - y)
+static float onePoleCoef(float hz)
+{
+    return 1.0f - expf(-2.0f * (float)M_PI * hz / SAMPLE_RATE);
+}
+
+// Dampen and attenuate the line outputs, then mix them with a normalized
+// Hadamard matrix (fast Walsh-Hadamard transform).  n is 8 or 16.
+static inline void mixLines(float *v, float *damp, const float *gain, float coef, int n)
+{
+    float norm = 1.0f / sqrtf((float)n);
+#if defined(ROGOSYNTH_SSE)
+    __m128 x[FDNReverb::MAX_LINES / 4];
+    __m128 c = _mm_set1_ps(coef);
+    int m = n / 4;
+    for (int i = 0; i < m; i++) {
+        __m128 d = _mm_load_ps(damp + 4 * i);
+        d = _mm_add_ps(d, _mm_mul_ps(c, _mm_sub_ps(_mm_load_ps(v + 4 * i), d)));
+        _mm_store_ps(damp + 4 * i, d);
+        x[i] = _mm_mul_ps(d, _mm_load_ps(gain + 4 * i));
+    }
+    // butterflies inside each vector (strides 1 and 2)
+    const __m128 alt = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    const __m128 half = _mm_set_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+    for (int i = 0; i < m; i++) {
+        __m128 e = _mm_shuffle_ps(x[i], x[i], _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 o = _mm_shuffle_ps(x[i], x[i], _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 y = _mm_add_ps(e, _mm_mul_ps(o, alt));
+        __m128 lo = _mm_movelh_ps(y, y);
+        __m128 hi = _mm_movehl_ps(y, y);
+        x[i] = _mm_add_ps(lo, _mm_mul_ps(hi, half));
+    }
+    // butterflies across vectors
+    for (int s = 1; s < m; s *= 2) {
+        for (int i = 0; i < m; i += 2 * s) {
+            for (int j = i; j < i + s; j++) {
+                __m128 a = x[j], b = x[j + s];
+                x[j] = _mm_add_ps(a, b);
+                x[j + s] = _mm_sub_ps(a, b);
+            }
+        }
+    }
+    __m128 k = _mm_set1_ps(norm);
+    for (int i = 0; i < m; i++) {
+        _mm_store_ps(v + 4 * i, _mm_mul_ps(x[i], k));
+    }
+#elif defined(ROGOSYNTH_NEON)
+    float32x4_t x[FDNReverb::MAX_LINES / 4];
+    int m = n / 4;
+    for (int i = 0; i < m; i++) {
+        float32x4_t d = vld1q_f32(damp + 4 * i);
+        d = vmlaq_n_f32(d, vsubq_f32(vld1q_f32(v + 4 * i), d), coef);
+        vst1q_f32(damp + 4 * i, d);
+        x[i] = vmulq_f32(d, vld1q_f32(gain + 4 * i));
+    }
+    static const float altSigns[4] = {1.0f, -1.0f, 1.0f, -1.0f};
+    static const float halfSigns[4] = {1.0f, 1.0f, -1.0f, -1.0f};
+    const float32x4_t alt = vld1q_f32(altSigns);
+    const float32x4_t half = vld1q_f32(halfSigns);
+    for (int i = 0; i < m; i++) {
+        float32x4x2_t t = vtrnq_f32(x[i], x[i]);
+        float32x4_t y = vmlaq_f32(t.val[0], t.val[1], alt);
+        float32x4_t lo = vcombine_f32(vget_low_f32(y), vget_low_f32(y));
+        float32x4_t hi = vcombine_f32(vget_high_f32(y), vget_high_f32(y));
+        x[i] = vmlaq_f32(lo, hi, half);
+    }
+    for (int s = 1; s < m; s *= 2) {
+        for (int i = 0; i < m; i += 2 * s) {
+            for (int j = i; j < i + s; j++) {
+                float32x4_t a = x[j], b = x[j + s];
+                x[j] = vaddq_f32(a, b);
+                x[j + s] = vsubq_f32(a, b);
+            }
+        }
+    }
+    for (int i = 0; i < m; i++) {
+        vst1q_f32(v + 4 * i, vmulq_n_f32(x[i], norm));
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        damp[i] += coef * (v[i] - damp[i]);
+        v[i] = damp[i] * gain[i];
+    }
+    for (int s = 1; s < n; s *= 2) {
+        for (int i = 0; i < n; i += 2 * s) {
+            for (int j = i; j < i + s; j++) {
+                float a = v[j], b = v[j + s];
+                v[j] = a + b;
+                v[j + s] = a - b;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        v[i] *= norm;
+    }
+#endif
+}
+
+FDNReverb::FDNReverb()
+{
+    mNumLines = 0;
+    mBuffer = nullptr;
+    mBufferSize = 0;
+}
+
+FDNReverb::~FDNReverb()
+{
+    if (mBuffer != nullptr) {
+        sf_free(mBuffer);
+    }
+}
+
+// make sure the delay memory holds at least floats, without shrinking it
+float *FDNReverb::buffer(int floats)
+{
+    if (floats > mBufferSize) {
+        if (mBuffer != nullptr) {
+            sf_free(mBuffer);
+        }
+        mBuffer = (float *)sf_malloc(sizeof(float) * floats);
+        mBufferSize = mBuffer != nullptr ? floats : 0;
+    }
+    return mBuffer;
+}
+
+bool FDNReverb::preset(sf_reverb_preset preset, int numLines)
+{
+    sf_reverb_params_st p;
+    if (!sf_reverb_presetparams(preset, &p)) {
+        return false;
+    }
+    numLines = numLines > 8 ? MAX_LINES : 8;
+
+    // line lengths in ms at ereffactor 1, mutually prime once in samples
+    static const float lineMs[MAX_LINES] = {23.3f, 26.9f, 29.7f, 32.3f, 35.9f, 38.3f,
+                                            41.1f, 43.7f, 47.3f, 50.9f, 53.9f, 57.1f,
+                                            59.3f, 63.7f, 67.1f, 73.1f};
+    static const float diffMs[2][NUM_DIFFUSERS] = {{4.7f, 3.6f, 12.7f, 9.3f},
+                                                   {4.9f, 3.4f, 12.1f, 9.7f}};
+    int total = 0;
+    int step = MAX_LINES / numLines;
+    for (int i = 0; i < numLines; i++) {
+        float ms = lineMs[i * step + step - 1] * p.ereffactor;
+        mLength[i] = nextPrime((int)(ms * SAMPLE_RATE / 1000.0f));
+        mMask[i] = nextPowerOfTwo(mLength[i] + 1) - 1;
+        mOffset[i] = total;
+        total += mMask[i] + 1;
+    }
+    for (int c = 0; c < 2; c++) {
+        for (int d = 0; d < NUM_DIFFUSERS; d++) {
+            mDiffSize[c][d] = nextPrime((int)(diffMs[c][d] * SAMPLE_RATE / 1000.0f));
+            total += mDiffSize[c][d];
+        }
+    }
+    mPreDelaySize = (int)(std::max(p.delay, 0.0f) * SAMPLE_RATE) + 1;
+    total += 2 * mPreDelaySize;
+
+    if (buffer(total) == nullptr) {
+        mNumLines = 0;
+        return false;
+    }
+    std::memset(mBuffer, 0, sizeof(float) * total);
+    float *next = mBuffer + (mOffset[numLines - 1] + mMask[numLines - 1] + 1);
+    for (int c = 0; c < 2; c++) {
+        for (int d = 0; d < NUM_DIFFUSERS; d++) {
+            mDiffBuf[c][d] = next;
+            mDiffPos[c][d] = 0;
+            next += mDiffSize[c][d];
+        }
+    }
+    mPreDelay[0] = next;
+    mPreDelay[1] = next + mPreDelaySize;
+    mPreDelayPos = 0;
+    mWritePos = 0;
+
+    // even lines carry the left channel in and out, odd lines the right
+    float tapGain = 1.0f / sqrtf(numLines / 2.0f);
+    for (int i = 0; i < MAX_LINES; i++) {
+        float sign = ((i >> 1) & 1) ? -tapGain : tapGain;
+        mOutL[i] = (i < numLines && !(i & 1)) ? sign : 0.0f;
+        mOutR[i] = (i < numLines && (i & 1)) ? sign : 0.0f;
+        mGain[i] = i < numLines ? powf(10.0f, -3.0f * mLength[i] / (p.rt60 * SAMPLE_RATE)) : 0.0f;
+        mDamp[i] = 0.0f;
+    }
+    mDampCoef = onePoleCoef(p.damplpf);
+    mInLPCoef = onePoleCoef(p.inputlpf);
+    mBassCoef = onePoleCoef(p.basslpf);
+    mBassBoost = p.bassb;
+    mInLP[0] = mInLP[1] = mBassLP[0] = mBassLP[1] = 0.0f;
+
+    mDry = dbToLinear(p.dry);
+    mEarly = dbToLinear(p.erefwet) * p.ertolate;
+    float wet = dbToLinear(p.wet);
+    mWet1 = wet * (p.width * 0.5f + 0.5f);
+    mWet2 = wet * ((1.0f - p.width) * 0.5f);
+    mNumLines = numLines;
+    return true;
+}
+
+void FDNReverb::process(const float *in, float *out, int frames)
+{
+    const float diffGain = 0.6f;
+    const int n = mNumLines;
+    alignas(16) float v[MAX_LINES];
+    for (int f = 0; f < frames; f++) {
+        float x[2] = {in[2 * f], in[2 * f + 1]};
+        float d[2];
+        for (int c = 0; c < 2; c++) {
+            // input lowpass, pre-delay and all-pass diffusion
+            mInLP[c] += mInLPCoef * (x[c] - mInLP[c]);
+            float s = mPreDelay[c][mPreDelayPos];
+            mPreDelay[c][mPreDelayPos] = mInLP[c];
+            for (int k = 0; k < NUM_DIFFUSERS; k++) {
+                float *buf = mDiffBuf[c][k];
+                int pos = mDiffPos[c][k];
+                float z = buf[pos];
+                float w = s + diffGain * z;
+                buf[pos] = w;
+                s = z - diffGain * w;
+                mDiffPos[c][k] = pos + 1 == mDiffSize[c][k] ? 0 : pos + 1;
+            }
+            d[c] = s;
+        }
+        mPreDelayPos = mPreDelayPos + 1 == mPreDelaySize ? 0 : mPreDelayPos + 1;
+
+        float tank[2] = {0.0f, 0.0f};
+        for (int i = 0; i < n; i++) {
+            v[i] = mBuffer[mOffset[i] + ((mWritePos - mLength[i]) & mMask[i])];
+            tank[0] += v[i] * mOutL[i];
+            tank[1] += v[i] * mOutR[i];
+        }
+        mixLines(v, mDamp, mGain, mDampCoef, n);
+        for (int i = 0; i < n; i++) {
+            float inject = d[0] * mOutL[i] + d[1] * mOutR[i];
+            mBuffer[mOffset[i] + (mWritePos & mMask[i])] = v[i] + inject;
+        }
+        mWritePos++;
+
+        for (int c = 0; c < 2; c++) {
+            mBassLP[c] += mBassCoef * (tank[c] - mBassLP[c]);
+            tank[c] += mBassBoost * mBassLP[c];
+        }
+        out[2 * f] = mDry * x[0] + mEarly * d[0] + mWet1 * tank[0] + mWet2 * tank[1];
+        out[2 * f + 1] = mDry * x[1] + mEarly * d[1] + mWet1 * tank[1] + mWet2 * tank[0];
+    }
+}
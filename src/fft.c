@@ -0,0 +1,88 @@
+#include "fft.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+
+bool fft_init(fft_plan *plan, int n)
+{
+    int bits = 0;
+    while ((1 << bits) < n) {
+        bits++;
+    }
+    plan->n = n;
+    plan->cosTable = (float *)malloc(sizeof(float) * (n / 2));
+    plan->sinTable = (float *)malloc(sizeof(float) * (n / 2));
+    plan->bitReverse = (int *)malloc(sizeof(int) * n);
+    if (plan->cosTable == NULL || plan->sinTable == NULL ||
+        plan->bitReverse == NULL || (1 << bits) != n) {
+        fft_free(plan);
+        return false;
+    }
+    for (int i = 0; i < n / 2; i++) {
+        double a = 2.0 * M_PI * i / n;
+        plan->cosTable[i] = (float)cos(a);
+        plan->sinTable[i] = (float)sin(a);
+    }
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bitReverse[i] = r;
+    }
+    return true;
+}
+
+void fft_free(fft_plan *plan)
+{
+    free(plan->cosTable);
+    free(plan->sinTable);
+    free(plan->bitReverse);
+    plan->cosTable = plan->sinTable = NULL;
+    plan->bitReverse = NULL;
+}
+
+// sign is -1 for the forward transform, +1 for the inverse
+static void fft_run(const fft_plan *plan, float *re, float *im, float sign)
+{
+    int n = plan->n;
+    for (int i = 0; i < n; i++) {
+        int j = plan->bitReverse[i];
+        if (j > i) {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (int size = 2; size <= n; size *= 2) {
+        int half = size / 2;
+        int step = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < half; k++) {
+                float wr = plan->cosTable[k * step];
+                float wi = sign * plan->sinTable[k * step];
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void fft_forward(const fft_plan *plan, float *re, float *im)
+{
+    fft_run(plan, re, im, -1.0f);
+}
+
+void fft_inverse(const fft_plan *plan, float *re, float *im)
+{
+    fft_run(plan, re, im, 1.0f);
+}
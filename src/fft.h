@@ -0,0 +1,26 @@
+#ifndef ROGOSYNTH_FFT_H
+#define ROGOSYNTH_FFT_H
+#include <stdbool.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+// In-place radix-2 complex FFT on split real/imaginary arrays.
+// n must be a power of two.
+typedef struct {
+    int n;
+    float *cosTable; // n/2 twiddles
+    float *sinTable;
+    int *bitReverse; // n entries
+} fft_plan;
+
+// returns false if the tables couldn't be allocated
+bool fft_init(fft_plan *plan, int n);
+void fft_free(fft_plan *plan);
+// X[k] = sum x[j] e^(-2 pi i jk/n)
+void fft_forward(const fft_plan *plan, float *re, float *im);
+// x[j] = sum X[k] e^(2 pi i jk/n), not scaled by 1/n
+void fft_inverse(const fft_plan *plan, float *re, float *im);
+#ifdef __cplusplus
+}
+#endif
+#endif
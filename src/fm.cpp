@@ -0,0 +1,263 @@
+#include "fm.h"
+#include "simd.h"
+#include <cstring>
+
+static_assert(FmPatch::NUM_OPERATORS == 4, "the operators fill one SIMD vector");
+
+// the sine table, as (value, difference to the next) pairs so one 8 byte
+// load has everything the interpolation needs
+const int SINE_BITS = 10;
+const int SINE_LENGTH = 1 << SINE_BITS;
+static float *generateSinePairs()
+{
+    float *pairs = new float[2 * SINE_LENGTH];
+    for (int i = 0; i < SINE_LENGTH; i++) {
+        pairs[2 * i] = (float)sin(2.0 * M_PI * i / SINE_LENGTH);
+        pairs[2 * i + 1] = (float)sin(2.0 * M_PI * (i + 1) / SINE_LENGTH) - pairs[2 * i];
+    }
+    return pairs;
+}
+static const float *cSinePairs = generateSinePairs();
+
+// phase modulation, in cycles, from a modulator at level 1 (about 12.6
+// radians) and from full feedback
+static const float cModDepth = 2.0f;
+static const float cFeedbackDepth = 0.25f;
+// Modulation goes to fixed point as 4.28 and is shifted up to the phase's
+// 0.32, which wraps it for free.  No operator takes more than two
+// modulators plus feedback, so it stays inside the 8 cycles that allows.
+static const float cModToFixed = 268435456.0f; // 2^28
+
+// cModulates[algorithm][from] is a mask of the operators from modulates
+static const uint8_t cModulates[FmPatch::NUM_ALGORITHMS][FmPatch::NUM_OPERATORS] = {
+    {0, 1 << 0, 1 << 1, 1 << 2}, {0, 1 << 0, 1 << 1, 1 << 1}, {0, 1 << 0, 1 << 0, 1 << 2},
+    {0, 1 << 0, 1 << 0, 1 << 1}, {0, 1 << 0, 0, 1 << 2},      {0, 0, 0, 0x7},
+    {0, 0, 0, 1 << 2},           {0, 0, 0, 0}};
+
+FmPatch::FmPatch() : mAlgorithm(4), mFeedback(0.0f)
+{
+    // two stacks with bright, decaying modulators: a simple electric piano
+    mOperators[1].level = 0.35f;
+    mOperators[1].decay = 1.5f;
+    mOperators[1].sustain = 0.2f;
+    mOperators[3].ratio = 14.0f;
+    mOperators[3].level = 0.15f;
+    mOperators[3].decay = 0.3f;
+    mOperators[3].sustain = 0.0f;
+    build();
+}
+
+void FmPatch::build()
+{
+    const uint8_t *modulates = cModulates[mAlgorithm];
+    int carriers = 0;
+    for (int from = 0; from < NUM_OPERATORS; from++) {
+        for (int to = 0; to < NUM_OPERATORS; to++) {
+            mColumn[from][to] = (modulates[from] & (1 << to)) ? cModDepth : 0.0f;
+        }
+        mFeedbackGain[from] = 0.0f;
+        carriers += (modulates[from] == 0);
+    }
+    // averaged over the last two samples
+    mFeedbackGain[3] = 0.5f * cFeedbackDepth * mFeedback;
+    for (int i = 0; i < NUM_OPERATORS; i++) {
+        mCarrierGain[i] = (modulates[i] == 0) ? 1.0f / carriers : 0.0f;
+    }
+}
+
+void FmPatch::algorithm(int v)
+{
+    mAlgorithm = std::clamp(v, 0, NUM_ALGORITHMS - 1);
+    build();
+}
+
+void FmPatch::feedback(float v)
+{
+    mFeedback = std::clamp(v, 0.0f, 1.0f);
+    build();
+}
+
+void FmPatch::op(int i, const Operator &v)
+{
+    Operator &o = mOperators[i];
+    o = v;
+    o.ratio = std::clamp(o.ratio, 0.125f, 32.0f);
+    o.level = std::clamp(o.level, 0.0f, 1.0f);
+}
+
+FmVoice::FmVoice(const FmPatch *patch) : mPatch(patch)
+{
+    for (int i = 0; i < FmPatch::NUM_OPERATORS; i++) {
+        mPhase[i] = 0;
+        mOut[i] = mOut2[i] = 0.0f;
+        mLevel[i] = mLevelStep[i] = 0.0f;
+        mIncScale[i] = 0.0f;
+    }
+}
+
+// operators restart from phase 0 so every note has the same timbre
+void FmVoice::noteOn(float time)
+{
+    for (int i = 0; i < FmPatch::NUM_OPERATORS; i++) {
+        mPhase[i] = 0;
+        mOut[i] = mOut2[i] = 0.0f;
+        mEnvelope[i].noteOn(time);
+    }
+}
+
+void FmVoice::noteOff(float time)
+{
+    for (int i = 0; i < FmPatch::NUM_OPERATORS; i++) {
+        mEnvelope[i].noteOff(time);
+    }
+}
+
+void FmVoice::controlTick(float time, bool snap)
+{
+    const float tickEnd = time + CONTROL_RATE * SAMPLE_PERIOD;
+    for (int i = 0; i < FmPatch::NUM_OPERATORS; i++) {
+        const FmPatch::Operator &o = mPatch->mOperators[i];
+        Envelope &env = mEnvelope[i];
+        env.attack(o.attack);
+        env.decay(o.decay);
+        env.sustain(o.sustain);
+        env.release(o.release);
+        if (snap) {
+            mLevel[i] = 0.0f;
+        }
+        float target = o.level * env.amplitude(tickEnd);
+        mLevelStep[i] = (target - mLevel[i]) / CONTROL_RATE;
+        mIncScale[i] = o.ratio * 4294967296.0f;
+    }
+}
+
+void FmVoice::addSamples(float *samples, int frames, int tableLength, const float *increment,
+                         const float *gain, const float *left, const float *right)
+{
+    // below Nyquist, which also keeps the increment in an int32
+    const float maxInc = 2147483520.0f;
+    const float toCycles = 1.0f / tableLength;
+#if defined(ROGOSYNTH_SSE)
+    __m128i phase = _mm_load_si128((const __m128i *)mPhase);
+    __m128 out = _mm_load_ps(mOut), out2 = _mm_load_ps(mOut2);
+    __m128 level = _mm_load_ps(mLevel), step = _mm_load_ps(mLevelStep);
+    const __m128 incScale = _mm_mul_ps(_mm_load_ps(mIncScale), _mm_set1_ps(toCycles));
+    const __m128 col0 = _mm_load_ps(mPatch->mColumn[0]), col1 = _mm_load_ps(mPatch->mColumn[1]);
+    const __m128 col2 = _mm_load_ps(mPatch->mColumn[2]), col3 = _mm_load_ps(mPatch->mColumn[3]);
+    const __m128 feedback = _mm_load_ps(mPatch->mFeedbackGain);
+    const __m128 carrier = _mm_load_ps(mPatch->mCarrierGain);
+    const __m128 modToFixed = _mm_set1_ps(cModToFixed), fracScale = _mm_set1_ps(1.0f / 65536.0f);
+    const __m128 maxIncV = _mm_set1_ps(maxInc);
+    const char *base = (const char *)cSinePairs;
+    for (int f = 0; f < frames; f++) {
+        // modulation in cycles; the sums are paired to keep the chain from
+        // one sample's output to the next one's short
+        __m128 m01 = _mm_add_ps(
+            _mm_mul_ps(col0, _mm_shuffle_ps(out, out, _MM_SHUFFLE(0, 0, 0, 0))),
+            _mm_mul_ps(col1, _mm_shuffle_ps(out, out, _MM_SHUFFLE(1, 1, 1, 1))));
+        __m128 m23 = _mm_add_ps(
+            _mm_mul_ps(col2, _mm_shuffle_ps(out, out, _MM_SHUFFLE(2, 2, 2, 2))),
+            _mm_mul_ps(col3, _mm_shuffle_ps(out, out, _MM_SHUFFLE(3, 3, 3, 3))));
+        __m128 mod = _mm_add_ps(_mm_add_ps(m01, m23),
+                                _mm_mul_ps(feedback, _mm_add_ps(out, out2)));
+        __m128i p = _mm_add_epi32(
+            phase, _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(mod, modToFixed)), 4));
+        // byte offsets of the table pairs, taken straight from the register
+        // (a store and reload would sit in the feedback path)
+        __m128i offset = _mm_slli_epi32(_mm_srli_epi32(p, 32 - SINE_BITS), 3);
+        __m128 frac = _mm_mul_ps(
+            _mm_cvtepi32_ps(_mm_srli_epi32(_mm_slli_epi32(p, SINE_BITS), 16)), fracScale);
+        const __m64 *p0 = (const __m64 *)(base + _mm_cvtsi128_si32(offset));
+        const __m64 *p1 = (const __m64 *)(base + _mm_cvtsi128_si32(_mm_shuffle_epi32(offset, 1)));
+        const __m64 *p2 = (const __m64 *)(base + _mm_cvtsi128_si32(_mm_shuffle_epi32(offset, 2)));
+        const __m64 *p3 = (const __m64 *)(base + _mm_cvtsi128_si32(_mm_shuffle_epi32(offset, 3)));
+        __m128 a = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), p0), p1);
+        __m128 b = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), p2), p3);
+        __m128 value = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 delta = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        out2 = out;
+        out = _mm_mul_ps(_mm_add_ps(value, _mm_mul_ps(delta, frac)), level);
+        // mix the carriers
+        __m128 mix = _mm_mul_ps(out, carrier);
+        mix = _mm_add_ps(mix, _mm_movehl_ps(mix, mix));
+        mix = _mm_add_ss(mix, _mm_shuffle_ps(mix, mix, _MM_SHUFFLE(1, 1, 1, 1)));
+        float sample = _mm_cvtss_f32(mix) * gain[f];
+        samples[2 * f] += sample * left[f];
+        samples[2 * f + 1] += sample * right[f];
+        __m128 inc = _mm_min_ps(_mm_mul_ps(_mm_set1_ps(increment[f]), incScale), maxIncV);
+        phase = _mm_add_epi32(phase, _mm_cvttps_epi32(inc));
+        level = _mm_add_ps(level, step);
+    }
+    _mm_store_si128((__m128i *)mPhase, phase);
+    _mm_store_ps(mOut, out);
+    _mm_store_ps(mOut2, out2);
+    _mm_store_ps(mLevel, level);
+#elif defined(ROGOSYNTH_NEON)
+    uint32x4_t phase = vld1q_u32(mPhase);
+    float32x4_t out = vld1q_f32(mOut), out2 = vld1q_f32(mOut2);
+    float32x4_t level = vld1q_f32(mLevel), step = vld1q_f32(mLevelStep);
+    const float32x4_t incScale = vmulq_n_f32(vld1q_f32(mIncScale), toCycles);
+    const float32x4_t col0 = vld1q_f32(mPatch->mColumn[0]), col1 = vld1q_f32(mPatch->mColumn[1]);
+    const float32x4_t col2 = vld1q_f32(mPatch->mColumn[2]), col3 = vld1q_f32(mPatch->mColumn[3]);
+    const float32x4_t feedback = vld1q_f32(mPatch->mFeedbackGain);
+    const float32x4_t carrier = vld1q_f32(mPatch->mCarrierGain);
+    const float32x4_t maxIncV = vdupq_n_f32(maxInc);
+    uint32_t index[4];
+    for (int f = 0; f < frames; f++) {
+        float32x2_t lo = vget_low_f32(out), hi = vget_high_f32(out);
+        float32x4_t m01 = vmlaq_lane_f32(vmulq_lane_f32(col0, lo, 0), col1, lo, 1);
+        float32x4_t m23 = vmlaq_lane_f32(vmulq_lane_f32(col2, hi, 0), col3, hi, 1);
+        float32x4_t mod = vmlaq_f32(vaddq_f32(m01, m23), feedback, vaddq_f32(out, out2));
+        uint32x4_t p = vaddq_u32(phase, vshlq_n_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(
+                                                        vmulq_n_f32(mod, cModToFixed))),
+                                                    4));
+        vst1q_u32(index, vshrq_n_u32(p, 32 - SINE_BITS));
+        float32x4_t frac = vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(vshlq_n_u32(p, SINE_BITS), 16)),
+                                       1.0f / 65536.0f);
+        float32x4_t a = vcombine_f32(vld1_f32(cSinePairs + 2 * index[0]),
+                                     vld1_f32(cSinePairs + 2 * index[1]));
+        float32x4_t b = vcombine_f32(vld1_f32(cSinePairs + 2 * index[2]),
+                                     vld1_f32(cSinePairs + 2 * index[3]));
+        float32x4x2_t split = vuzpq_f32(a, b);
+        out2 = out;
+        out = vmulq_f32(vmlaq_f32(split.val[0], split.val[1], frac), level);
+        float32x4_t mix = vmulq_f32(out, carrier);
+        float32x2_t half = vadd_f32(vget_low_f32(mix), vget_high_f32(mix));
+        float sample = vget_lane_f32(vpadd_f32(half, half), 0) * gain[f];
+        samples[2 * f] += sample * left[f];
+        samples[2 * f + 1] += sample * right[f];
+        float32x4_t inc = vminq_f32(vmulq_n_f32(incScale, increment[f]), maxIncV);
+        phase = vaddq_u32(phase, vreinterpretq_u32_s32(vcvtq_s32_f32(inc)));
+        level = vaddq_f32(level, step);
+    }
+    vst1q_u32(mPhase, phase);
+    vst1q_f32(mOut, out);
+    vst1q_f32(mOut2, out2);
+    vst1q_f32(mLevel, level);
+#else
+    const int n = FmPatch::NUM_OPERATORS;
+    for (int f = 0; f < frames; f++) {
+        float next[FmPatch::NUM_OPERATORS];
+        float sample = 0.0f;
+        for (int to = 0; to < n; to++) {
+            float mod = mPatch->mFeedbackGain[to] * (mOut[to] + mOut2[to]);
+            for (int from = 0; from < n; from++) {
+                mod += mPatch->mColumn[from][to] * mOut[from];
+            }
+            uint32_t p = mPhase[to] + ((uint32_t)(int32_t)(mod * cModToFixed) << 4);
+            const float *pair = cSinePairs + 2 * (p >> (32 - SINE_BITS));
+            float frac = ((p << SINE_BITS) >> 16) * (1.0f / 65536.0f);
+            next[to] = (pair[0] + pair[1] * frac) * mLevel[to];
+            sample += next[to] * mPatch->mCarrierGain[to];
+            float inc = std::min(increment[f] * toCycles * mIncScale[to], maxInc);
+            mPhase[to] += (uint32_t)(int32_t)inc;
+            mLevel[to] += mLevelStep[to];
+        }
+        memcpy(mOut2, mOut, sizeof(mOut));
+        memcpy(mOut, next, sizeof(mOut));
+        sample *= gain[f];
+        samples[2 * f] += sample * left[f];
+        samples[2 * f + 1] += sample * right[f];
+    }
+#endif
+}
@@ -0,0 +1,86 @@
+#ifndef ROGOSYNTH_FM_H
+#define ROGOSYNTH_FM_H
+#include "constants.h"
+#include "envelope.h"
+#include <algorithm>
+#include <cstdint>
+
+// Four operator FM (phase modulation), after the DX21/TX81Z.  Operators are
+// numbered from 0 here; operator 3 has the feedback.
+//
+// The algorithms:
+//   0: 3 > 2 > 1 > 0            4: 1 > 0, 3 > 2
+//   1: (2 + 3) > 1 > 0          5: 3 > (0, 1, 2)
+//   2: (1 + (3 > 2)) > 0        6: 3 > 2, 1, 0
+//   3: ((3 > 1) + 2) > 0        7: 0, 1, 2, 3
+// Carriers are the operators nothing else takes; they are mixed at equal
+// levels.
+//
+// The patch is shared by every voice.  Settings are written by the UI
+// thread and read by the voices each control tick, like the other
+// parameters.
+class FmPatch {
+  public:
+    static const int NUM_OPERATORS = 4;
+    static const int NUM_ALGORITHMS = 8;
+
+    struct Operator {
+        float ratio = 1.0f; // of the note's frequency
+        float level = 1.0f; // output for carriers, modulation index for modulators
+        float attack = 0.0f, decay = 0.0f, sustain = 1.0f, release = 0.2f;
+    };
+
+  private:
+    Operator mOperators[NUM_OPERATORS];
+    int mAlgorithm;
+    float mFeedback; // 0..1
+
+    // derived from the algorithm for FmVoice: mColumn[from][to] is how much
+    // of operator from's output, in cycles, moves operator to's phase
+    alignas(16) float mColumn[NUM_OPERATORS][NUM_OPERATORS];
+    alignas(16) float mFeedbackGain[NUM_OPERATORS];
+    alignas(16) float mCarrierGain[NUM_OPERATORS];
+    void build();
+
+    friend class FmVoice;
+
+  public:
+    FmPatch();
+    int algorithm() const { return mAlgorithm; }
+    void algorithm(int v);
+    float feedback() const { return mFeedback; }
+    void feedback(float v);
+    Operator op(int i) const { return mOperators[i]; }
+    void op(int i, const Operator &v);
+};
+
+// One voice's operators, rendered together in the lanes of a SIMD vector.
+// Each operator keeps a 32 bit fixed-point phase, so wrapping is free and
+// modulation is an integer add; the top bits index a sine table and the
+// next 16 interpolate.  Modulation reaches an operator one sample later,
+// which is what lets all four run at once; feedback averages the last two
+// samples to keep it from turning to noise.
+//
+// Operator envelopes are evaluated per control tick and ramped per sample.
+class FmVoice {
+    alignas(16) uint32_t mPhase[FmPatch::NUM_OPERATORS];
+    alignas(16) float mOut[FmPatch::NUM_OPERATORS];  // last sample
+    alignas(16) float mOut2[FmPatch::NUM_OPERATORS]; // the one before
+    alignas(16) float mLevel[FmPatch::NUM_OPERATORS];
+    alignas(16) float mLevelStep[FmPatch::NUM_OPERATORS];
+    alignas(16) float mIncScale[FmPatch::NUM_OPERATORS]; // table increment to fixed point
+    Envelope mEnvelope[FmPatch::NUM_OPERATORS];
+    const FmPatch *mPatch;
+
+  public:
+    FmVoice(const FmPatch *patch);
+    void noteOn(float time);
+    void noteOff(float time);
+    // aim the operator levels at their values one tick after time
+    void controlTick(float time, bool snap);
+    // increment is the note's per sample phase increment in table units of
+    // length tableLength; the mix is scaled by gain and panned by left/right
+    void addSamples(float *samples, int frames, int tableLength, const float *increment,
+                    const float *gain, const float *left, const float *right);
+};
+#endif
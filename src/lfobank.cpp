@@ -0,0 +1,267 @@
+#include "lfobank.h"
+#include "simd.h"
+#include <algorithm>
+
+static_assert(LfoBank::MAX_LANES % 4 == 0, "lanes are processed four at a time");
+
+static inline uint32_t xorshift(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// top 24 bits of the generator to -1..1
+static const float cRandomScale = 2.0f / 16777216.0f;
+static inline float randomValue(uint32_t x) { return (float)(x >> 8) * cRandomScale - 1.0f; }
+
+LfoBank::LfoBank()
+    : mIncrement(0.0f), mSin(0.0f), mCos(1.0f), mRetrigger(0), mShape(LfoShape::sine),
+      mTrigger(LfoTrigger::free), mRate(5.0f), mSync(0.0f), mStartPhase(0.0f)
+{
+    for (int i = 0; i < MAX_LANES; i++) {
+        mPhase[i] = 0.0f;
+        mRe[i] = 1.0f;
+        mIm[i] = 0.0f;
+        // any nonzero seed; the lanes' sequences differ
+        mRandom[i] = 0x9e3779b9u * (i + 1);
+        mRandom[i] = xorshift(mRandom[i]);
+        mHeld[i] = randomValue(mRandom[i]);
+        mRandom[i] = xorshift(mRandom[i]);
+        mNext[i] = randomValue(mRandom[i]);
+    }
+    std::fill(&mOut[0][0], &mOut[0][0] + CONTROL_TICKS * MAX_LANES, 0.0f);
+}
+
+void LfoBank::beginBuffer(float bpm)
+{
+    float hz = (mSync > 0.0f) ? bpm / (60.0f * mSync) : mRate;
+    // no faster than half the control rate
+    mIncrement = std::clamp(hz * CONTROL_RATE / SAMPLE_RATE, 0.0f, 0.5f);
+    mSin = sinf(2.0f * (float)M_PI * mIncrement);
+    mCos = cosf(2.0f * (float)M_PI * mIncrement);
+    if (mTrigger == LfoTrigger::free) {
+        for (int i = 0; i < GLOBAL_LANE; i++) {
+            mPhase[i] = mPhase[GLOBAL_LANE];
+            mRandom[i] = mRandom[GLOBAL_LANE];
+            mHeld[i] = mHeld[GLOBAL_LANE];
+            mNext[i] = mNext[GLOBAL_LANE];
+        }
+    }
+    // restart the phasors from the phases so their rounding stays bounded
+    if (mShape == LfoShape::sine) {
+        for (int i = 0; i < MAX_LANES; i++) {
+            mRe[i] = cosf(2.0f * (float)M_PI * mPhase[i]);
+            mIm[i] = sinf(2.0f * (float)M_PI * mPhase[i]);
+        }
+    }
+}
+
+void LfoBank::retrigger(uint32_t lanes)
+{
+    if (mTrigger == LfoTrigger::free) {
+        return;
+    }
+    for (int i = 0; i < GLOBAL_LANE; i++) {
+        if (!(lanes & (1u << i))) {
+            continue;
+        }
+        mPhase[i] = mStartPhase;
+        mRe[i] = cosf(2.0f * (float)M_PI * mStartPhase);
+        mIm[i] = sinf(2.0f * (float)M_PI * mStartPhase);
+        mRandom[i] = xorshift(mRandom[i]);
+        mHeld[i] = randomValue(mRandom[i]);
+        mRandom[i] = xorshift(mRandom[i]);
+        mNext[i] = randomValue(mRandom[i]);
+    }
+}
+
+// Each tick writes every lane's value at the start of the tick, then
+// advances the lanes.  A random lane draws a new value when its phase wraps.
+void LfoBank::fill(int from, int to)
+{
+    uint32_t lanes = mRetrigger.exchange(0);
+    if (lanes) {
+        retrigger(lanes);
+    }
+    const LfoShape shape = mShape;
+    const bool random = (shape == LfoShape::sampleHold || shape == LfoShape::randomSmooth);
+#if defined(ROGOSYNTH_SSE)
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), half = _mm_set1_ps(0.5f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 inc = _mm_set1_ps(mIncrement), sn = _mm_set1_ps(mSin), co = _mm_set1_ps(mCos);
+    const __m128 scale = _mm_set1_ps(cRandomScale);
+    for (int t = from; t <= to; t++) {
+        for (int i = 0; i < MAX_LANES; i += 4) {
+            __m128 phase = _mm_load_ps(mPhase + i);
+            __m128 v;
+            switch (shape) {
+            case LfoShape::triangle:
+                v = _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(4.0f),
+                                               _mm_and_ps(_mm_sub_ps(phase, half), absMask)));
+                break;
+            case LfoShape::sawtooth:
+                v = _mm_sub_ps(_mm_mul_ps(two, phase), one);
+                break;
+            case LfoShape::square: {
+                __m128 low = _mm_cmplt_ps(phase, half);
+                v = _mm_sub_ps(_mm_and_ps(low, two), one);
+                break;
+            }
+            case LfoShape::sampleHold:
+                v = _mm_load_ps(mHeld + i);
+                break;
+            case LfoShape::randomSmooth: {
+                __m128 a = _mm_load_ps(mHeld + i);
+                __m128 s = _mm_mul_ps(_mm_mul_ps(phase, phase),
+                                      _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(two, phase)));
+                v = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(mNext + i), a), s));
+                break;
+            }
+            default: {
+                __m128 re = _mm_load_ps(mRe + i), im = _mm_load_ps(mIm + i);
+                v = im;
+                _mm_store_ps(mRe + i, _mm_sub_ps(_mm_mul_ps(re, co), _mm_mul_ps(im, sn)));
+                _mm_store_ps(mIm + i, _mm_add_ps(_mm_mul_ps(re, sn), _mm_mul_ps(im, co)));
+                break;
+            }
+            }
+            _mm_store_ps(mOut[t] + i, v);
+            phase = _mm_add_ps(phase, inc);
+            __m128 wrap = _mm_cmpge_ps(phase, one);
+            _mm_store_ps(mPhase + i, _mm_sub_ps(phase, _mm_and_ps(wrap, one)));
+            if (random && _mm_movemask_ps(wrap)) {
+                __m128i old = _mm_load_si128((const __m128i *)(mRandom + i));
+                __m128i x = _mm_xor_si128(old, _mm_slli_epi32(old, 13));
+                x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+                x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+                __m128i w = _mm_castps_si128(wrap);
+                _mm_store_si128((__m128i *)(mRandom + i),
+                                _mm_or_si128(_mm_and_si128(w, x), _mm_andnot_si128(w, old)));
+                __m128 r = _mm_cvtepi32_ps(_mm_srli_epi32(x, 8));
+                r = _mm_sub_ps(_mm_mul_ps(r, scale), one);
+                __m128 held = _mm_load_ps(mHeld + i), next = _mm_load_ps(mNext + i);
+                if (shape == LfoShape::sampleHold) {
+                    held = _mm_or_ps(_mm_and_ps(wrap, r), _mm_andnot_ps(wrap, held));
+                }
+                else {
+                    held = _mm_or_ps(_mm_and_ps(wrap, next), _mm_andnot_ps(wrap, held));
+                    next = _mm_or_ps(_mm_and_ps(wrap, r), _mm_andnot_ps(wrap, next));
+                }
+                _mm_store_ps(mHeld + i, held);
+                _mm_store_ps(mNext + i, next);
+            }
+        }
+    }
+#elif defined(ROGOSYNTH_NEON)
+    const float32x4_t one = vdupq_n_f32(1.0f), two = vdupq_n_f32(2.0f), half = vdupq_n_f32(0.5f);
+    const float32x4_t inc = vdupq_n_f32(mIncrement), sn = vdupq_n_f32(mSin), co = vdupq_n_f32(mCos);
+    const float32x4_t scale = vdupq_n_f32(cRandomScale);
+    for (int t = from; t <= to; t++) {
+        for (int i = 0; i < MAX_LANES; i += 4) {
+            float32x4_t phase = vld1q_f32(mPhase + i);
+            float32x4_t v;
+            switch (shape) {
+            case LfoShape::triangle:
+                v = vmlsq_f32(one, vdupq_n_f32(4.0f), vabsq_f32(vsubq_f32(phase, half)));
+                break;
+            case LfoShape::sawtooth:
+                v = vsubq_f32(vmulq_f32(two, phase), one);
+                break;
+            case LfoShape::square:
+                v = vbslq_f32(vcltq_f32(phase, half), one, vnegq_f32(one));
+                break;
+            case LfoShape::sampleHold:
+                v = vld1q_f32(mHeld + i);
+                break;
+            case LfoShape::randomSmooth: {
+                float32x4_t a = vld1q_f32(mHeld + i);
+                float32x4_t s = vmulq_f32(vmulq_f32(phase, phase),
+                                          vmlsq_f32(vdupq_n_f32(3.0f), two, phase));
+                v = vmlaq_f32(a, vsubq_f32(vld1q_f32(mNext + i), a), s);
+                break;
+            }
+            default: {
+                float32x4_t re = vld1q_f32(mRe + i), im = vld1q_f32(mIm + i);
+                v = im;
+                vst1q_f32(mRe + i, vmlsq_f32(vmulq_f32(re, co), im, sn));
+                vst1q_f32(mIm + i, vmlaq_f32(vmulq_f32(re, sn), im, co));
+                break;
+            }
+            }
+            vst1q_f32(mOut[t] + i, v);
+            phase = vaddq_f32(phase, inc);
+            uint32x4_t wrap = vcgeq_f32(phase, one);
+            vst1q_f32(mPhase + i, vbslq_f32(wrap, vsubq_f32(phase, one), phase));
+            uint32x2_t any = vorr_u32(vget_low_u32(wrap), vget_high_u32(wrap));
+            if (random && (vget_lane_u32(any, 0) | vget_lane_u32(any, 1))) {
+                uint32x4_t old = vld1q_u32(mRandom + i);
+                uint32x4_t x = veorq_u32(old, vshlq_n_u32(old, 13));
+                x = veorq_u32(x, vshrq_n_u32(x, 17));
+                x = veorq_u32(x, vshlq_n_u32(x, 5));
+                vst1q_u32(mRandom + i, vbslq_u32(wrap, x, old));
+                float32x4_t r = vsubq_f32(vmulq_f32(vcvtq_f32_u32(vshrq_n_u32(x, 8)), scale), one);
+                float32x4_t held = vld1q_f32(mHeld + i), next = vld1q_f32(mNext + i);
+                if (shape == LfoShape::sampleHold) {
+                    held = vbslq_f32(wrap, r, held);
+                }
+                else {
+                    held = vbslq_f32(wrap, next, held);
+                    next = vbslq_f32(wrap, r, next);
+                }
+                vst1q_f32(mHeld + i, held);
+                vst1q_f32(mNext + i, next);
+            }
+        }
+    }
+#else
+    for (int t = from; t <= to; t++) {
+        for (int i = 0; i < MAX_LANES; i++) {
+            float phase = mPhase[i];
+            float v;
+            switch (shape) {
+            case LfoShape::triangle:
+                v = 1.0f - 4.0f * fabsf(phase - 0.5f);
+                break;
+            case LfoShape::sawtooth:
+                v = 2.0f * phase - 1.0f;
+                break;
+            case LfoShape::square:
+                v = phase < 0.5f ? 1.0f : -1.0f;
+                break;
+            case LfoShape::sampleHold:
+                v = mHeld[i];
+                break;
+            case LfoShape::randomSmooth:
+                v = mHeld[i] + (mNext[i] - mHeld[i]) * phase * phase * (3.0f - 2.0f * phase);
+                break;
+            default: {
+                float re = mRe[i], im = mIm[i];
+                v = im;
+                mRe[i] = re * mCos - im * mSin;
+                mIm[i] = re * mSin + im * mCos;
+                break;
+            }
+            }
+            mOut[t][i] = v;
+            phase += mIncrement;
+            if (phase >= 1.0f) {
+                phase -= 1.0f;
+                if (random) {
+                    mRandom[i] = xorshift(mRandom[i]);
+                    float r = randomValue(mRandom[i]);
+                    if (shape == LfoShape::sampleHold) {
+                        mHeld[i] = r;
+                    }
+                    else {
+                        mHeld[i] = mNext[i];
+                        mNext[i] = r;
+                    }
+                }
+            }
+            mPhase[i] = phase;
+        }
+    }
+#endif
+}
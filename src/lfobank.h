@@ -0,0 +1,68 @@
+#ifndef ROGOSYNTH_LFOBANK_H
+#define ROGOSYNTH_LFOBANK_H
+#include "constants.h"
+#include <atomic>
+#include <cstdint>
+
+enum class LfoShape { sine, triangle, sawtooth, square, sampleHold, randomSmooth };
+
+// free: every voice follows one running LFO; retrigger: a voice's LFO
+// restarts from the start phase at its note on
+enum class LfoTrigger { free, retrigger };
+
+// One LFO for every voice at once.  Each voice has a lane with its own
+// phase, and all lanes advance together in SIMD vectors, one control tick
+// at a time, into a buffer of per tick values.  The last lane is never
+// retriggered and drives what all voices share (the filter).
+//
+// Sine is a rotating complex phasor per lane like the reverb's LFO, so no
+// sinf is evaluated per tick; it is rebuilt from the phase every buffer so
+// rounding can't accumulate.  The random shapes use a xorshift generator
+// per lane.
+class LfoBank {
+  public:
+    static const int MAX_LANES = 12; // a multiple of 4
+    static const int GLOBAL_LANE = MAX_LANES - 1;
+
+  private:
+    alignas(16) float mPhase[MAX_LANES]; // 0..1
+    alignas(16) float mRe[MAX_LANES];
+    alignas(16) float mIm[MAX_LANES];
+    alignas(16) float mHeld[MAX_LANES]; // S&H value, or smooth random start
+    alignas(16) float mNext[MAX_LANES]; // smooth random end
+    alignas(16) uint32_t mRandom[MAX_LANES];
+    alignas(16) float mOut[CONTROL_TICKS][MAX_LANES];
+    float mIncrement; // phase per tick
+    float mSin, mCos; // phasor rotation per tick
+    std::atomic<uint32_t> mRetrigger; // lanes with a note on to apply
+
+    LfoShape mShape;
+    LfoTrigger mTrigger;
+    float mRate;       // Hz when not synced
+    float mSync;       // beats per cycle, 0 for free running Hz
+    float mStartPhase; // where retriggered lanes start, 0..1
+
+    void retrigger(uint32_t lanes);
+
+  public:
+    LfoBank();
+    // audio thread: per buffer setup, then fill ticks as they are needed
+    void beginBuffer(float bpm);
+    void fill(int from, int to);
+    float value(int t, int lane) const { return mOut[t][lane]; }
+    // any thread; applied at the next fill
+    void noteOn(int lane) { mRetrigger.fetch_or(1u << lane); }
+
+    // UI thread
+    LfoShape shape() const { return mShape; }
+    void shape(LfoShape v) { mShape = v; }
+    LfoTrigger trigger() const { return mTrigger; }
+    void trigger(LfoTrigger v) { mTrigger = v; }
+    float rate() const { return mRate; }
+    void rate(float hz) { mRate = hz; }
+    float sync() const { return mSync; }
+    void sync(float beats) { mSync = beats; }
+    float startPhase() const { return mStartPhase; }
+    void startPhase(float v) { mStartPhase = v; }
+};
+#endif
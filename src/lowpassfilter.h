@@ -1,9 +1,11 @@
 #ifndef ROGOSYNTH_LOWPASSFILTER_H
 #define ROGOSYNTH_LOWPASSFILTER_H
 #include "constants.h"
+#include "modmatrix.h"
 extern "C" {
 #include "sndfilter/biquad.h"
 }
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
 
@@ -12,10 +14,24 @@ class LowPassFilter {
     float mCutoff;
     float mResonance;
     float mTempSamples[AUDIO_BUFFER_SAMPLES];
+    float mOctaves; // cutoff modulation the coefficients are for
+
+    // sf_lowpass also clears the history, which would click mid-stream.
+    // Its angle for the cutoff reaches pi at a quarter of the sample rate,
+    // past which the filter is unstable, so modulation has to stop short.
+    void coefficients(float cutoff)
+    {
+        sf_biquad_state_st state = mState;
+        sf_lowpass(&mState, SAMPLE_RATE, std::min(cutoff, 0.24f * SAMPLE_RATE), mResonance);
+        mState.xn1 = state.xn1;
+        mState.xn2 = state.xn2;
+        mState.yn1 = state.yn1;
+        mState.yn2 = state.yn2;
+    }
 
   public:
     LowPassFilter(float cutoff, float resonance)
-        : mCutoff(cutoff), mResonance(resonance)
+        : mCutoff(cutoff), mResonance(resonance), mOctaves(0.0f)
     {
         sf_lowpass(&mState, SAMPLE_RATE, cutoff, resonance);
     }
@@ -28,11 +44,30 @@ class LowPassFilter {
         std::memcpy(samples, mTempSamples, sizeof(float) * length);
     }
 
+    // Cutoff modulated by octaves[t] for each control tick.  The
+    // coefficients change per tick, keeping the filter's history, and are
+    // only recomputed when the modulation moves.
+    void updateSamples(float *samples, long length, const float *octaves)
+    {
+        assert(length == AUDIO_BUFFER_SAMPLES);
+        sf_sample_st *in = (sf_sample_st *)samples;
+        sf_sample_st *out = (sf_sample_st *)mTempSamples;
+        for (int t = 0; t < CONTROL_TICKS; t++) {
+            if (octaves[t] != mOctaves) {
+                mOctaves = octaves[t];
+                coefficients(mCutoff * exp2f(mOctaves));
+            }
+            sf_biquad_process(&mState, CONTROL_RATE, in + t * CONTROL_RATE,
+                              out + t * CONTROL_RATE);
+        }
+        std::memcpy(samples, mTempSamples, sizeof(float) * length);
+    }
+
     void cutoff(float v)
     {
         if (mCutoff != v) {
             mCutoff = v;
-            sf_lowpass(&mState, SAMPLE_RATE, mCutoff, mResonance);
+            coefficients(mCutoff * exp2f(mOctaves));
         }
     }
     float cutoff() { return mCutoff; }
@@ -40,7 +75,7 @@ class LowPassFilter {
     {
         if (mResonance != v) {
             mResonance = v;
-            sf_lowpass(&mState, SAMPLE_RATE, mCutoff, mResonance);
+            coefficients(mCutoff * exp2f(mOctaves));
         }
     }
     float resonance() { return mResonance; }
@@ -1,5 +1,8 @@
 #include "app.h"
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 void usage()
@@ -9,16 +12,102 @@ void usage()
     std::cout << "          - https://github.com/rogerallen/rogosynth\n";
     std::cout << "options:\n";
     std::cout << "  -h      - this message.\n";
+    std::cout << "  -b      - benchmark a reverb tail with and without denormals\n";
+    std::cout << "            flushed to zero, then exit.\n";
+    std::cout << "  -i file - convolution reverb impulse response (.wav).\n";
+    std::cout << "  -m file - play a MIDI file (.mid).\n";
+    std::cout << "  -o file - with -m, render it offline to a .wav and exit.\n";
+    std::cout << "  -f bits - with -o, write 16 (default) or 24 bit PCM, or 32 bit float.\n";
+    std::cout << "  -w file - play a sample (.wav), unity note from its smpl chunk or\n";
+    std::cout << "            middle C.  Repeat for a multisample.\n";
+    std::cout << "  -W file - import a wavetable (.wav), frames as long as its clm chunk\n";
+    std::cout << "            says or 2048 samples.\n";
+    std::cout << "  -s file - tune to a Scala scale (.scl), middle C on degree 0.\n";
+    std::cout << "  -r prio - lock memory and run audio at SCHED_FIFO prio (1-99).\n";
+    std::cout << "  -c cpus - pin audio to the first cpu, workers to the rest (2,3).\n";
+    std::cout << "  -t file - write a trace (chrome://tracing json) from the start.\n";
+    std::cout << "            F2 starts/stops tracing at any time.\n";
+}
+
+// a whole decimal number in [lo, hi], or false
+static bool parseInt(const char *s, long lo, long hi, int &value)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || v < lo || v > hi) {
+        return false;
+    }
+    value = (int)v;
+    return true;
 }
 
 int main(int argc, char *argv[])
 {
+    AppOptions options;
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
             if (argv[i][1] == 'h') {
                 usage();
                 return 0;
             }
+            else if (argv[i][1] == 'b') {
+                options.benchmark = true;
+            }
+            else if (argv[i][1] == 'i' && i + 1 < argc) {
+                options.impulseResponse = argv[++i];
+            }
+            else if (argv[i][1] == 'm' && i + 1 < argc) {
+                options.midiFile = argv[++i];
+            }
+            else if (argv[i][1] == 'o' && i + 1 < argc) {
+                options.outputPath = argv[++i];
+            }
+            else if (argv[i][1] == 'f' && i + 1 < argc) {
+                int bits;
+                if (!parseInt(argv[++i], 16, 32, bits) || bits % 8 != 0) {
+                    std::cerr << "ERROR: -f takes 16, 24 or 32 bits\n";
+                    usage();
+                    return 1;
+                }
+                options.outputFormat = (bits == 16)   ? WavFormat::pcm16
+                                       : (bits == 24) ? WavFormat::pcm24
+                                                      : WavFormat::float32;
+            }
+            else if (argv[i][1] == 's' && i + 1 < argc) {
+                options.scalaFile = argv[++i];
+            }
+            else if (argv[i][1] == 'w' && i + 1 < argc) {
+                options.sampleFiles.push_back(argv[++i]);
+            }
+            else if (argv[i][1] == 'W' && i + 1 < argc) {
+                options.wavetableFile = argv[++i];
+            }
+            else if (argv[i][1] == 't' && i + 1 < argc) {
+                options.tracePath = argv[++i];
+            }
+            else if (argv[i][1] == 'r' && i + 1 < argc) {
+                options.realtime.enabled = true;
+                if (!parseInt(argv[++i], 1, 99, options.realtime.priority)) {
+                    std::cerr << "ERROR: -r takes a priority from 1 to 99\n";
+                    usage();
+                    return 1;
+                }
+            }
+            else if (argv[i][1] == 'c' && i + 1 < argc) {
+                std::stringstream cpus(argv[++i]);
+                std::string cpu;
+                while (std::getline(cpus, cpu, ',')) {
+                    // 64 cpus fit every platform's affinity mask
+                    int n;
+                    if (!parseInt(cpu.c_str(), 0, 63, n)) {
+                        std::cerr << "ERROR: -c takes cpu numbers from 0 to 63, like 2,3\n";
+                        usage();
+                        return 1;
+                    }
+                    options.realtime.cpus.push_back(n);
+                }
+            }
             // else if (argv[i][1] == 'd') {
             //    cudaDevice = std::stoi(argv[++i]);
             //}
@@ -30,7 +119,14 @@ int main(int argc, char *argv[])
             }
         }
     }
+    if (!options.outputPath.empty() && options.midiFile.empty()) {
+        std::cerr << "ERROR: -o needs a MIDI file to render (-m)\n";
+        usage();
+        return 1;
+    }
+    // worker threads pick this up as the engine starts them
+    Realtime::configure(options.realtime);
     App app;
-    app.run(/* send options here */);
+    app.run(options);
     return 0;
 }
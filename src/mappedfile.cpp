@@ -0,0 +1,130 @@
+#include "mappedfile.h"
+#include <algorithm>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : mData(nullptr), mSize(0), mFile(nullptr), mMapping(nullptr) {}
+#else
+MappedFile::MappedFile() : mData(nullptr), mSize(0) {}
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+bool MappedFile::open(const char *path)
+{
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "ERROR: Couldn't open " << path << "\n";
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        std::cerr << "ERROR: " << path << " is empty\n";
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        std::cerr << "ERROR: Couldn't map " << path << "\n";
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    mFile = file;
+    mMapping = mapping;
+    mData = (const uint8_t *)data;
+    mSize = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData != nullptr) {
+        UnmapViewOfFile(mData);
+        CloseHandle((HANDLE)mMapping);
+        CloseHandle((HANDLE)mFile);
+    }
+    mData = nullptr;
+    mSize = 0;
+    mFile = mMapping = nullptr;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+#if _WIN32_WINNT >= 0x0602
+    if (offset >= mSize) {
+        return;
+    }
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (void *)(mData + offset);
+    range.NumberOfBytes = std::min(length, mSize - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    // PrefetchVirtualMemory needs Windows 8; pages just come in as touched
+    (void)offset;
+    (void)length;
+#endif
+}
+#else
+bool MappedFile::open(const char *path)
+{
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR: Couldn't open " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "ERROR: " << path << " is empty\n";
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "ERROR: Couldn't map " << path << "\n";
+        return false;
+    }
+    mData = (const uint8_t *)data;
+    mSize = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData != nullptr) {
+        munmap((void *)mData, mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (offset >= mSize) {
+        return;
+    }
+    // madvise wants a page aligned start
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset / page * page;
+    size_t end = std::min(offset + length, mSize);
+    madvise((void *)(mData + start), end - start, MADV_WILLNEED);
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef ROGOSYNTH_MAPPEDFILE_H
+#define ROGOSYNTH_MAPPEDFILE_H
+#include <cstddef>
+#include <cstdint>
+
+// A whole file mapped read-only into memory.  Nothing is read up front:
+// pages come in from the page cache as they are touched, and are shared
+// with every other mapping of the same file.
+class MappedFile {
+    const uint8_t *mData;
+    size_t mSize;
+#ifdef _WIN32
+    void *mFile;
+    void *mMapping;
+#endif
+
+  public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // prints the reason and returns false if the file couldn't be mapped
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return mData != nullptr; }
+    const uint8_t *data() const { return mData; }
+    size_t size() const { return mSize; }
+    // ask the OS to start reading a range into the page cache, without
+    // waiting for it
+    void prefetch(size_t offset, size_t length) const;
+};
+#endif
@@ -0,0 +1,211 @@
+#include "midifile.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// an event still timed in MIDI ticks; tempo changes ride along with status
+// 0xFF and their microseconds per quarter note in tempo
+struct TickEvent {
+    uint64_t tick;
+    uint32_t tempo;
+    MidiEvent event;
+};
+
+static uint32_t readU32BE(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint16_t readU16BE(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+// variable length quantity, at most 4 bytes
+static bool readVarLen(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (p >= end) {
+            return false;
+        }
+        uint8_t b = *p++;
+        value = (value << 7) | (b & 0x7f);
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Append one track's note, CC and pitch bend messages (and tempo changes)
+// to events.  Returns false if the track is malformed; what was read up to
+// that point is kept.
+static bool parseTrack(const uint8_t *p, const uint8_t *end, std::vector<TickEvent> &events,
+                       uint64_t &endTick)
+{
+    uint64_t tick = 0;
+    uint8_t running = 0;
+    endTick = 0;
+    while (p < end) {
+        uint32_t delta;
+        if (!readVarLen(p, end, delta) || p >= end) {
+            return false;
+        }
+        tick += delta;
+        endTick = tick;
+        uint8_t status = *p;
+        if (status & 0x80) {
+            p++;
+        }
+        else if (running != 0) {
+            status = running;
+        }
+        else {
+            return false;
+        }
+
+        if (status == 0xFF || status == 0xF0 || status == 0xF7) {
+            // meta and sysex events cancel running status
+            running = 0;
+            uint8_t type = 0;
+            if (status == 0xFF) {
+                if (p >= end) {
+                    return false;
+                }
+                type = *p++;
+            }
+            uint32_t length;
+            if (!readVarLen(p, end, length) || length > (size_t)(end - p)) {
+                return false;
+            }
+            if (status == 0xFF && type == 0x2F) {
+                return true; // end of track
+            }
+            if (status == 0xFF && type == 0x51 && length == 3) {
+                uint32_t tempo = (p[0] << 16) | (p[1] << 8) | p[2];
+                events.push_back({tick, tempo, {0, 0xFF, 0, 0}});
+            }
+            p += length;
+            continue;
+        }
+        if (status >= 0xF0) {
+            return false; // real-time and common messages don't belong in files
+        }
+
+        running = status;
+        uint8_t kind = status & 0xF0;
+        int numData = (kind == 0xC0 || kind == 0xD0) ? 1 : 2;
+        if (end - p < numData) {
+            return false;
+        }
+        uint8_t data1 = p[0] & 0x7f;
+        uint8_t data2 = numData == 2 ? p[1] & 0x7f : 0;
+        p += numData;
+        if (kind == 0x90 && data2 == 0) {
+            status = 0x80 | (status & 0x0F);
+            kind = 0x80;
+        }
+        // program change and aftertouch have nothing to drive yet
+        if (kind == 0x80 || kind == 0x90 || kind == 0xB0 || kind == 0xE0) {
+            events.push_back({tick, 0, {0, status, data1, data2}});
+        }
+    }
+    // a missing end of track event is common enough to let through
+    return true;
+}
+
+bool MidiFile::load(const char *path, int sampleRate)
+{
+    mEvents.clear();
+    mLength = 0;
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    const uint8_t *p = file.data();
+    const uint8_t *end = p + file.size();
+    if (file.size() < 14 || std::string((const char *)p, 4) != "MThd" || readU32BE(p + 4) < 6 ||
+        readU32BE(p + 4) > file.size() - 8) {
+        std::cerr << "ERROR: " << path << " is not a MIDI file\n";
+        return false;
+    }
+    mFormat = readU16BE(p + 8);
+    mNumTracks = readU16BE(p + 10);
+    uint16_t division = readU16BE(p + 12);
+    if (mFormat > 1) {
+        std::cerr << "ERROR: " << path << " is a format " << mFormat
+                  << " MIDI file, only formats 0 and 1 are supported\n";
+        return false;
+    }
+    // SMPTE timing is a negative frame rate in the high byte and ticks per
+    // frame in the low one
+    const bool smpte = (division & 0x8000) != 0;
+    const int fps = -(int8_t)(division >> 8);
+    if (smpte && ((fps != 24 && fps != 25 && fps != 29 && fps != 30) || (division & 0xff) == 0)) {
+        std::cerr << "ERROR: " << path << " has a bad SMPTE time division\n";
+        return false;
+    }
+    p += 8 + readU32BE(p + 4);
+
+    // Tracks are appended one after another, so a stable sort by tick
+    // leaves simultaneous events in track order and then file order.
+    std::vector<TickEvent> events;
+    events.reserve(file.size() / 3);
+    uint64_t endTick = 0;
+    int track = 0;
+    while (end - p >= 8 && track < mNumTracks) {
+        uint32_t length = readU32BE(p + 4);
+        const uint8_t *data = p + 8;
+        if (length > (size_t)(end - data)) {
+            std::cerr << "WARNING: " << path << " is truncated\n";
+            length = (uint32_t)(end - data);
+        }
+        if (std::string((const char *)p, 4) == "MTrk") {
+            uint64_t trackEnd;
+            if (!parseTrack(data, data + length, events, trackEnd)) {
+                std::cerr << "WARNING: " << path << " track " << track
+                          << " is malformed, using what could be read\n";
+            }
+            endTick = std::max(endTick, trackEnd);
+            track++;
+        }
+        p = data + length;
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TickEvent &a, const TickEvent &b) { return a.tick < b.tick; });
+
+    // Apply the tempo map.  Time is accumulated in microseconds (in double,
+    // exact enough for hours of ticks) and only rounded to a frame per event,
+    // so rounding never drifts.
+    double usPerTick;
+    if (smpte) {
+        double rate = (fps == 29) ? 29.97 : fps;
+        usPerTick = 1.0e6 / (rate * (division & 0xff));
+    }
+    else {
+        usPerTick = 500000.0 / std::max(1, (int)division); // 120 bpm until told otherwise
+    }
+    double us = 0.0;
+    uint64_t lastTick = 0;
+    mEvents.reserve(events.size());
+    for (const TickEvent &e : events) {
+        us += (e.tick - lastTick) * usPerTick;
+        lastTick = e.tick;
+        if (e.event.status == 0xFF) {
+            if (!smpte) {
+                usPerTick = (double)e.tempo / std::max(1, (int)division);
+            }
+            continue;
+        }
+        MidiEvent m = e.event;
+        m.frame = (uint64_t)std::llround(us * sampleRate / 1.0e6);
+        mEvents.push_back(m);
+    }
+    us += (endTick - lastTick) * usPerTick;
+    mLength = (uint64_t)std::llround(us * sampleRate / 1.0e6);
+#ifndef NDEBUG
+    std::cout << path << ": format " << mFormat << ", " << track << " tracks, "
+              << mEvents.size() << " events, " << us / 1.0e6 << " s\n";
+#endif
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef ROGOSYNTH_MIDIFILE_H
+#define ROGOSYNTH_MIDIFILE_H
+#include "constants.h"
+#include <cstdint>
+#include <vector>
+
+// A channel message at a sample position.  Note on with velocity 0 is
+// stored as note off, so consumers only need to check the status nibble.
+struct MidiEvent {
+    uint64_t frame; // sample frames from the start of the timeline
+    uint8_t status; // 0x80 note off, 0x90 note on, 0xB0 CC, 0xE0 pitch bend | channel
+    uint8_t data1;
+    uint8_t data2;
+};
+
+// Standard MIDI File (format 0 or 1) reader.  The file is memory-mapped and
+// parsed once; every track's channel messages are merged into one flat array
+// sorted by time, with the tempo map already applied, so playback only has
+// to walk a cursor through it.  Events at the same time keep the order of
+// their tracks, and their order within a track, so a render is repeatable.
+class MidiFile {
+    std::vector<MidiEvent> mEvents;
+    uint64_t mLength; // frame of the end of the last track
+    int mFormat;
+    int mNumTracks;
+
+  public:
+    MidiFile() : mLength(0), mFormat(0), mNumTracks(0) {}
+    // prints the reason and returns false if the file can't be used
+    bool load(const char *path, int sampleRate = SAMPLE_RATE);
+    const std::vector<MidiEvent> &events() const { return mEvents; }
+    uint64_t length() const { return mLength; }
+    int format() const { return mFormat; }
+    int numTracks() const { return mNumTracks; }
+};
+#endif
@@ -176,6 +176,7 @@ void mtr_init_from_stream(void *stream) {
 	event_buffer = (raw_event_t *)malloc(INTERNAL_MINITRACE_BUFFER_SIZE * sizeof(raw_event_t));
 	flush_buffer = (raw_event_t *)malloc(INTERNAL_MINITRACE_BUFFER_SIZE * sizeof(raw_event_t));
 	is_tracing = 1;
+	is_flushing = FALSE;
 	event_count = 0;
 	f = (FILE *)stream;
 	const char *header = "{\"traceEvents\":[\n";
@@ -210,6 +211,8 @@ void mtr_shutdown() {
 	f = 0;
 	free(event_buffer);
 	event_buffer = 0;
+	free(flush_buffer);
+	flush_buffer = 0;
 	for (i = 0; i < STRING_POOL_SIZE; i++) {
 		if (str_pool[i]) {
 			free(str_pool[i]);
@@ -482,3 +485,43 @@ void internal_mtr_raw_event_arg(const char *category, const char *name, char ph,
 	pthread_mutex_unlock(&event_mutex);
 }
 
+void internal_mtr_raw_event_at(const char *category, const char *name, char ph, double ts, int tid, mtr_arg_type arg_type, const char *arg_name, void *arg_value) {
+#ifndef MTR_ENABLED
+	return;
+#endif
+	pthread_mutex_lock(&mutex);
+	if (!is_tracing || event_count >= INTERNAL_MINITRACE_BUFFER_SIZE) {
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+	raw_event_t *ev = &event_buffer[event_count];
+	++event_count;
+	pthread_mutex_lock(&event_mutex);
+	++events_in_progress;
+	pthread_mutex_unlock(&event_mutex);
+	pthread_mutex_unlock(&mutex);
+
+	if (!cur_process_id) {
+		cur_process_id = get_cur_process_id();
+	}
+
+	ev->cat = category;
+	ev->name = name;
+	ev->id = 0;
+	ev->ts = (int64_t)(ts * 1000000);
+	ev->ph = ph;
+	ev->tid = tid;
+	ev->pid = cur_process_id;
+	ev->arg_type = arg_type;
+	ev->arg_name = arg_name;
+	switch (arg_type) {
+	case MTR_ARG_TYPE_INT: ev->a_int = (int)(uintptr_t)arg_value; break;
+	case MTR_ARG_TYPE_STRING_CONST:	ev->a_str = (const char*)arg_value; break;
+	case MTR_ARG_TYPE_STRING_COPY: ev->a_str = strdup((const char*)arg_value); break;
+	case MTR_ARG_TYPE_NONE: break;
+	}
+
+	pthread_mutex_lock(&event_mutex);
+	--events_in_progress;
+	pthread_mutex_unlock(&event_mutex);
+}
@@ -87,6 +87,9 @@ typedef enum {
 // Only use the macros to call these.
 void internal_mtr_raw_event(const char *category, const char *name, char ph, void *id);
 void internal_mtr_raw_event_arg(const char *category, const char *name, char ph, void *id, mtr_arg_type arg_type, const char *arg_name, void *arg_value);
+// Record an event captured earlier (for example by a real-time thread into its own lock-free
+// buffer) with its original mtr_time_s() timestamp and thread id.
+void internal_mtr_raw_event_at(const char *category, const char *name, char ph, double ts, int tid, mtr_arg_type arg_type, const char *arg_name, void *arg_value);
 
 #ifdef MTR_ENABLED
 
@@ -0,0 +1,75 @@
+#include "modmatrix.h"
+#include <algorithm>
+
+// each destination's range for an amount of 1
+static const float cDestRange[ModMatrix::NUM_DESTS] = {12.0f, 1.0f, 1.0f, 4.0f, 1.0f};
+
+// controllers settle in about 10ms
+static const float cSmoothing = 1.0f - expf(-CONTROL_RATE / (0.01f * SAMPLE_RATE));
+
+ModMatrix::ModMatrix()
+    : mTempo(120.0f), mBendTarget(0.0f), mWheelTarget(0.0f), mBend(0.0f), mWheel(0.0f),
+      mPrepared(-1)
+{
+    mLfos[1].rate(0.5f);
+    mLfos[1].shape(LfoShape::triangle);
+    std::fill(&mGlobal[0][0], &mGlobal[0][0] + NUM_SOURCES * CONTROL_TICKS, 0.0f);
+}
+
+void ModMatrix::beginBuffer()
+{
+    mPrepared = -1;
+    for (int i = 0; i < NUM_LFOS; i++) {
+        mLfos[i].beginBuffer(mTempo);
+    }
+}
+
+void ModMatrix::prepare(int lastTick)
+{
+    if (mPrepared >= lastTick) {
+        return;
+    }
+    for (int i = 0; i < NUM_LFOS; i++) {
+        mLfos[i].fill(mPrepared + 1, lastTick);
+    }
+    while (mPrepared < lastTick) {
+        tick(++mPrepared);
+    }
+}
+
+void ModMatrix::tick(int t)
+{
+    mBend += cSmoothing * (mBendTarget - mBend);
+    mWheel += cSmoothing * (mWheelTarget - mWheel);
+    mGlobal[(int)ModSource::none][t] = 0.0f;
+    mGlobal[(int)ModSource::modEnvelope][t] = 0.0f;
+    mGlobal[(int)ModSource::pitchBend][t] = mBend;
+    mGlobal[(int)ModSource::modWheel][t] = mWheel;
+    mCutoff[t] = evaluate(ModDest::cutoff, t, LfoBank::GLOBAL_LANE, 0.0f);
+}
+
+float ModMatrix::evaluate(ModDest dest, int t, int voice, float modEnvelope) const
+{
+    float sum = 0.0f;
+    for (int i = 0; i < MAX_ROUTES; i++) {
+        const ModRoute &r = mRoutes[i];
+        if (r.dest != dest || r.source == ModSource::none) {
+            continue;
+        }
+        float value;
+        switch (r.source) {
+        case ModSource::lfo1:
+        case ModSource::lfo2:
+            value = mLfos[(int)r.source - (int)ModSource::lfo1].value(t, voice);
+            break;
+        case ModSource::modEnvelope:
+            value = modEnvelope;
+            break;
+        default:
+            value = mGlobal[(int)r.source][t];
+            break;
+        }
+        sum += r.amount * value;
+    }
+    return sum * cDestRange[(int)dest];
+}
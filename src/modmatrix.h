@@ -0,0 +1,91 @@
+#ifndef ROGOSYNTH_MODMATRIX_H
+#define ROGOSYNTH_MODMATRIX_H
+#include "constants.h"
+#include "lfobank.h"
+#include <algorithm>
+
+enum class ModSource {
+    none,
+    lfo1,        // -1..1, per voice
+    lfo2,        // -1..1, per voice
+    modEnvelope, // 0..1, per voice
+    pitchBend,   // -1..1
+    modWheel,    // 0..1
+    NUM_SOURCES
+};
+
+// amounts are -1..1 of each destination's range
+enum class ModDest {
+    pitch,     // +-12 semitones
+    amplitude, // gain 1 +- 1
+    pan,       // +-1, hard left to hard right
+    cutoff,    // +-4 octaves; the filter is shared, so it sees the envelope at 0 and
+               // the LFOs' global lanes
+    position,  // +-1, across the whole wavetable
+    NUM_DESTS
+};
+
+struct ModRoute {
+    ModSource source = ModSource::none;
+    ModDest dest = ModDest::pitch;
+    float amount = 0.0f;
+};
+
+// The routing table plus the modulation sources outside the voices.  They
+// are computed for the whole engine as ticks are needed and the tick values
+// of the current buffer are kept, so every voice reads the same ones.  The
+// LFOs have a lane per voice, filled for all voices at once.  MIDI
+// controllers are smoothed over a few ticks so steps in them don't click.
+//
+// Audio thread: beginBuffer(), then prepare() up to the last tick a batch
+// of voice rendering will reach.  Voices call global() and evaluate().
+class ModMatrix {
+  public:
+    static const int MAX_ROUTES = 6;
+    static const int NUM_LFOS = 2;
+    static const int NUM_SOURCES = (int)ModSource::NUM_SOURCES;
+    static const int NUM_DESTS = (int)ModDest::NUM_DESTS;
+
+  private:
+    LfoBank mLfos[NUM_LFOS];
+    ModRoute mRoutes[MAX_ROUTES];
+    float mTempo; // bpm, for tempo synced LFOs
+    float mBendTarget, mWheelTarget;
+    float mBend, mWheel;
+    // global source values for each tick of the buffer
+    float mGlobal[NUM_SOURCES][CONTROL_TICKS];
+    float mCutoff[CONTROL_TICKS]; // octaves, with the LFOs' global lanes
+    int mPrepared;                // last tick computed, -1 at buffer start
+
+    void tick(int t);
+
+  public:
+    ModMatrix();
+    // audio thread
+    void beginBuffer();
+    void prepare(int lastTick);
+    float global(ModSource source, int t) const { return mGlobal[(int)source][t]; }
+    // sum of amount * source into dest for one voice, scaled to the
+    // destination's range
+    float evaluate(ModDest dest, int t, int voice, float modEnvelope) const;
+    const float *cutoff() const { return mCutoff; }
+
+    // MIDI controllers, on the audio thread in event order
+    void pitchBend(int value) { mBendTarget = (value - 8192) / 8192.0f; }
+    void modWheel(int value) { mWheelTarget = value / 127.0f; }
+    // any thread; retriggers the voice's LFO lanes
+    void noteOn(int voice)
+    {
+        for (int i = 0; i < NUM_LFOS; i++) {
+            mLfos[i].noteOn(voice);
+        }
+    }
+
+    // UI thread
+    ModRoute route(int slot) const { return mRoutes[slot]; }
+    void route(int slot, const ModRoute &route) { mRoutes[slot] = route; }
+    LfoBank &lfo(int i) { return mLfos[i]; }
+    float tempo() const { return mTempo; }
+    void tempo(float bpm) { mTempo = std::max(1.0f, bpm); }
+};
+#endif
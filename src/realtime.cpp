@@ -0,0 +1,189 @@
+#include "realtime.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__)
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+RealtimeOptions Realtime::cOptions;
+char Realtime::cReports[Realtime::MAX_REPORTS][Realtime::REPORT_LENGTH];
+std::atomic<bool> Realtime::cReady[Realtime::MAX_REPORTS];
+std::atomic<int> Realtime::cNextReport{0};
+int Realtime::cPrinted = 0;
+thread_local bool Realtime::tConfigured = false;
+
+void Realtime::report(const char *line)
+{
+    int slot = cNextReport.fetch_add(1);
+    if (slot >= MAX_REPORTS) {
+        return;
+    }
+    snprintf(cReports[slot], REPORT_LENGTH, "%s", line);
+    cReady[slot].store(true, std::memory_order_release);
+}
+
+void Realtime::printReport()
+{
+    int end = std::min(cNextReport.load(), MAX_REPORTS);
+    while (cPrinted < end && cReady[cPrinted].load(std::memory_order_acquire)) {
+        std::cout << "realtime: " << cReports[cPrinted++] << "\n";
+    }
+}
+
+void Realtime::lockMemory()
+{
+#if defined(__linux__)
+    // With a limited RLIMIT_MEMLOCK, MCL_FUTURE would make later
+    // allocations (an impulse response, the GL driver) fail outright.
+    struct rlimit limit;
+    bool future = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+    if (mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0)) != 0) {
+        char line[REPORT_LENGTH];
+        snprintf(line, sizeof(line),
+                 "mlockall failed: %s (raise RLIMIT_MEMLOCK or grant CAP_IPC_LOCK)",
+                 strerror(errno));
+        report(line);
+        return;
+    }
+#if defined(__GLIBC__)
+    // keep freed memory mapped (and locked) instead of handing it back
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    report(future ? "memory locked (current and future pages)"
+                  : "memory locked (current pages only, RLIMIT_MEMLOCK is limited)");
+#else
+    report("memory locking is not supported on this platform");
+#endif
+}
+
+void Realtime::prefault(void *memory, size_t bytes)
+{
+#if defined(__linux__)
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#else
+    size_t page = 4096;
+#endif
+    volatile char *p = (volatile char *)memory;
+    for (size_t i = 0; i < bytes; i += page) {
+        p[i] = p[i];
+    }
+}
+
+// printf onto the end of line, which holds len bytes of text so far
+static void appendf(char *line, size_t size, int &len, const char *format, ...)
+{
+    if ((size_t)len >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line + len, size - len, format, args);
+    va_end(args);
+    len = std::min(len + std::max(n, 0), (int)size - 1);
+}
+
+// fault in the stack the DSP code will use
+static void prefaultStack()
+{
+    volatile char stack[256 * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+void Realtime::configureThread(ThreadRole role, const char *name)
+{
+    if (tConfigured) {
+        return;
+    }
+    tConfigured = true;
+    if (!cOptions.enabled && cOptions.cpus.empty()) {
+        return;
+    }
+    if (role == ThreadRole::audio) {
+        prefaultStack();
+    }
+
+    // the audio thread gets the first cpu to itself when there are more
+    const std::vector<int> &cpus = cOptions.cpus;
+    size_t first = 0, last = cpus.size();
+    if (cpus.size() > 1) {
+        if (role == ThreadRole::audio) {
+            last = 1;
+        }
+        else {
+            first = 1;
+        }
+    }
+    char line[REPORT_LENGTH];
+    int n = 0;
+    appendf(line, sizeof(line), n, "%s thread:", name);
+#if defined(__linux__)
+    if (cOptions.enabled && role != ThreadRole::background) {
+        int priority = cOptions.priority - (role == ThreadRole::audio ? 0 : 10);
+        priority = std::max(sched_get_priority_min(SCHED_FIFO),
+                            std::min(priority, sched_get_priority_max(SCHED_FIFO)));
+        sched_param param = {};
+        param.sched_priority = priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            appendf(line, sizeof(line), n, " SCHED_FIFO %d", priority);
+        }
+        else {
+            appendf(line, sizeof(line), n, " SCHED_FIFO %d denied (%s)", priority,
+                          strerror(err));
+        }
+    }
+    if (first < last) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = first; i < last; i++) {
+            CPU_SET(cpus[i], &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        appendf(line, sizeof(line), n, err == 0 ? " pinned to cpu" : " pinning to cpu");
+        for (size_t i = first; i < last; i++) {
+            appendf(line, sizeof(line), n, " %d", cpus[i]);
+        }
+        if (err != 0) {
+            appendf(line, sizeof(line), n, " denied (%s)", strerror(err));
+        }
+    }
+#elif defined(_WIN32)
+    if (cOptions.enabled && role != ThreadRole::background) {
+        int priority = role == ThreadRole::audio ? THREAD_PRIORITY_TIME_CRITICAL
+                                                 : THREAD_PRIORITY_HIGHEST;
+        bool ok = SetThreadPriority(GetCurrentThread(), priority) != 0;
+        appendf(line, sizeof(line), n, ok ? " %s priority" : " %s priority denied",
+                      role == ThreadRole::audio ? "time critical" : "highest");
+    }
+    if (first < last) {
+        DWORD_PTR mask = 0;
+        for (size_t i = first; i < last; i++) {
+            mask |= (DWORD_PTR)1 << cpus[i];
+        }
+        bool ok = SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+        appendf(line, sizeof(line), n, ok ? " pinned to cpu mask 0x%llx"
+                                                     : " pinning to cpu mask 0x%llx denied",
+                      (unsigned long long)mask);
+    }
+#else
+    (void)first;
+    (void)last;
+    appendf(line, sizeof(line), n, " scheduling and pinning are not supported on this platform");
+#endif
+    report(line);
+}
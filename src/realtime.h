@@ -0,0 +1,52 @@
+#ifndef ROGOSYNTH_REALTIME_H
+#define ROGOSYNTH_REALTIME_H
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// what the user asked for on the command line
+struct RealtimeOptions {
+    bool enabled = false;   // lock memory and ask for SCHED_FIFO
+    int priority = 80;      // audio thread; DSP workers run 10 below
+    std::vector<int> cpus;  // audio thread on the first, workers on the rest
+};
+
+enum class ThreadRole {
+    audio,     // the render callback
+    dsp,       // work the callback depends on (convolution tail)
+    background // everything else (preset building)
+};
+
+// Memory locking, real-time scheduling and CPU pinning for the audio side
+// of the app.  Every request is best effort: what was and wasn't granted
+// is collected lock-free (the audio thread reports too) and printed by the
+// UI thread from printReport().
+class Realtime {
+    static const int MAX_REPORTS = 16;
+    static const int REPORT_LENGTH = 160;
+    static RealtimeOptions cOptions;
+    // fixed size so that reporting from the audio thread doesn't allocate
+    static char cReports[MAX_REPORTS][REPORT_LENGTH];
+    static std::atomic<bool> cReady[MAX_REPORTS];
+    static std::atomic<int> cNextReport;
+    static int cPrinted;
+    static thread_local bool tConfigured;
+
+    static void report(const char *line);
+
+  public:
+    // set before the engine starts any threads
+    static void configure(const RealtimeOptions &options) { cOptions = options; }
+    static bool enabled() { return cOptions.enabled; }
+    static bool pinning() { return !cOptions.cpus.empty(); }
+    // mlockall(), current and (if the limit allows) future pages
+    static void lockMemory();
+    // touch every page so the first callback doesn't take the faults
+    static void prefault(void *memory, size_t bytes);
+    // call from the thread itself; only the first call does anything, so
+    // the audio thread can call it every callback
+    static void configureThread(ThreadRole role, const char *name);
+    // UI thread: print anything reported since the last call
+    static void printReport();
+};
+#endif
@@ -1,32 +1,261 @@
 #ifndef ROGOSYNTH_REVERB_H
 #define ROGOSYNTH_REVERB_H
 #include "constants.h"
+#include "denormals.h"
+#include "enginearena.h"
+#include "fdnreverb.h"
+#include "realtime.h"
 extern "C" {
 #include "sndfilter/reverb.h"
 }
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
+// Which algorithm renders the presets: the Progenitor2 port from sndfilter,
+// or the much cheaper 8 or 16 line feedback delay network.
+enum class ReverbEngine { progenitor, fdn8, fdn16 };
+
+// Preset (and engine) changes are built on a worker thread into a spare state from a
+// small pool and handed to the audio thread through mPending.  The audio
+// thread crossfades from the old state to the new one over a single buffer
+// and then gives the old state back to the pool.  Once every slot has been
+// used, their delay line arenas are reused so switching doesn't allocate.
 class Reverb {
-    sf_reverb_state_st mState;
+    // active + crossfading out + pending + being built
+    static const int NUM_SLOTS = 4;
+
+    struct Slot {
+        ReverbEngine engine = ReverbEngine::progenitor;
+        sf_reverb_state_st state = {};
+        FDNReverb fdn;
+        bool built = false; // holds a complete preset
+        std::atomic<bool> free{true};
+    };
+    Slot mSlots[NUM_SLOTS];
+
+    // audio thread only
+    int mActive;
+    // slot index published by the worker, -1 if there is none
+    std::atomic<int> mPending{-1};
+
+    // UI thread side
     sf_reverb_preset mPreset;
+    ReverbEngine mEngine;
+    // engine and preset packed by request()
+    std::atomic<int> mRequested;
+
+    // worker side
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mQuit = false;
+    // the last request the worker finished, and a signal for wait()
+    int mBuilt;
+    std::condition_variable mBuiltChanged;
+
     float mTempSamples[AUDIO_BUFFER_SAMPLES];
+    float mFadeSamples[AUDIO_BUFFER_SAMPLES];
+
+    static int request(ReverbEngine engine, sf_reverb_preset preset)
+    {
+        return ((int)engine << 8) | (int)preset;
+    }
+
+    // (re)build a slot; false if its memory couldn't be allocated
+    bool build(Slot &slot, int req)
+    {
+        slot.engine = (ReverbEngine)(req >> 8);
+        sf_reverb_preset preset = (sf_reverb_preset)(req & 0xff);
+        switch (slot.engine) {
+        case ReverbEngine::fdn8:
+            slot.built = slot.fdn.preset(preset, 8);
+            break;
+        case ReverbEngine::fdn16:
+            slot.built = slot.fdn.preset(preset, 16);
+            break;
+        default:
+            slot.built = sf_presetreverb(&slot.state, SAMPLE_RATE, preset);
+            break;
+        }
+        return slot.built;
+    }
 
-public:
-    // NOTE: For some reason allocating this on
-    // the stack results in corruption.  Allocate
-    // on the heap via new instead.
-    Reverb(sf_reverb_preset preset) : mPreset(preset) 
+    bool ready(Slot &slot) { return slot.built; }
+
+    void process(Slot &slot, float *in, float *out, long length)
     {
-        sf_presetreverb(&mState, SAMPLE_RATE, preset);
+        if (slot.engine == ReverbEngine::progenitor) {
+            sf_reverb_process(&slot.state, length / 2, (sf_sample_st *)in,
+                              (sf_sample_st *)out);
+        }
+        else {
+            slot.fdn.process(in, out, length / 2);
+        }
     }
-        
+
+    // the most delay memory any preset needs from each engine.  The first
+    // call also generates sndfilter's shared noise table, so it runs once
+    // whichever thread gets here first.
+    static void largestPresets(int &progenitorFloats, int &fdnFloats)
+    {
+        static int progenitor = 0, fdn = 0;
+        static std::once_flag once;
+        std::call_once(once, [] {
+            for (int p = 0; p <= SF_REVERB_PRESET_LONGREVERB2; p++) {
+                sf_reverb_state_st state = {};
+                if (sf_presetreverb(&state, SAMPLE_RATE, (sf_reverb_preset)p)) {
+                    progenitor = std::max(progenitor, state.arenasize);
+                }
+                sf_reverb_free(&state);
+                for (int lines = 8; lines <= FDNReverb::MAX_LINES; lines += 8) {
+                    FDNReverb f;
+                    if (f.preset((sf_reverb_preset)p, lines)) {
+                        fdn = std::max(fdn, f.bufferFloats());
+                    }
+                }
+            }
+        });
+        progenitorFloats = progenitor;
+        fdnFloats = fdn;
+    }
+
+    int grabFreeSlot()
+    {
+        for (int i = 0; i < NUM_SLOTS; i++) {
+            bool expected = true;
+            if (mSlots[i].free.compare_exchange_strong(expected, false)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void workerLoop()
+    {
+        Realtime::configureThread(ThreadRole::background, "reverb preset");
+        ScopedDenormalsDisable noDenormals;
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mQuit) {
+            int want = mRequested.load();
+            if (want == mBuilt) {
+                mWake.wait(lock);
+                continue;
+            }
+            int slot = grabFreeSlot();
+            if (slot < 0) {
+                // every slot is in use until the audio thread finishes a
+                // crossfade; it never blocks on us, so just poll.
+                mWake.wait_for(lock, std::chrono::milliseconds(5));
+                continue;
+            }
+            lock.unlock();
+            bool ok = build(mSlots[slot], want);
+            lock.lock();
+            mBuilt = want;
+            mBuiltChanged.notify_all();
+            if (!ok) {
+                std::cerr << "ERROR: Couldn't allocate reverb delay lines.\n";
+                mSlots[slot].free.store(true);
+                continue;
+            }
+            // replace a pending state the audio thread hasn't picked up yet
+            int stale = mPending.exchange(slot);
+            if (stale >= 0) {
+                mSlots[stale].free.store(true);
+            }
+        }
+    }
+
+    void rebuild()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequested.store(request(mEngine, mPreset));
+        }
+        mWake.notify_one();
+    }
+
+  public:
+    // Every slot's delay memory (from sf_malloc) is reserved for the largest
+    // preset of either engine here, so building presets later never
+    // allocates.  reserveBytes() is what that costs, for sizing an arena.
+    static size_t reserveBytes()
+    {
+        int progenitorFloats, fdnFloats;
+        largestPresets(progenitorFloats, fdnFloats);
+        return NUM_SLOTS * (EngineArena::padded(sf_reverb_reservebytes(progenitorFloats)) +
+                            EngineArena::padded(sizeof(float) * fdnFloats));
+    }
+
+    // NOTE: this is too big for the stack (the sample buffers alone are
+    // 32kB); RogoSynth places it in its EngineArena.
+    Reverb(sf_reverb_preset preset, ReverbEngine engine = ReverbEngine::progenitor)
+        : mPreset(preset), mEngine(engine), mRequested(request(engine, preset)),
+          mBuilt(request(engine, preset))
+    {
+        // The presets are built here first so the shared noise table is
+        // generated before the worker can call into sndfilter.
+        int progenitorFloats, fdnFloats;
+        largestPresets(progenitorFloats, fdnFloats);
+        for (int i = 0; i < NUM_SLOTS; i++) {
+            if (!sf_reverb_reserve(&mSlots[i].state, progenitorFloats) ||
+                !mSlots[i].fdn.reserve(fdnFloats)) {
+                std::cerr << "ERROR: Couldn't reserve reverb delay lines.\n";
+            }
+        }
+        mActive = grabFreeSlot();
+        if (!build(mSlots[mActive], mRequested.load())) {
+            std::cerr << "ERROR: Couldn't allocate reverb delay lines.\n";
+        }
+        mWorker = std::thread(&Reverb::workerLoop, this);
+    }
+    ~Reverb()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWake.notify_one();
+        mWorker.join();
+        for (int i = 0; i < NUM_SLOTS; i++) {
+            sf_reverb_free(&mSlots[i].state);
+        }
+    }
+
     void updateSamples(float *samples, long length)
     {
         assert(length == AUDIO_BUFFER_SAMPLES);
-        sf_reverb_process(&mState, length / 2, (sf_sample_st *)samples,
-                          (sf_sample_st *)mTempSamples);
+        int next = mPending.exchange(-1);
+        if (next >= 0) {
+            // crossfade from the old state to the new one over this buffer
+            int prev = mActive;
+            mActive = next;
+            if (!ready(mSlots[prev])) {
+                std::memcpy(mTempSamples, samples, sizeof(float) * length);
+            }
+            else {
+                process(mSlots[prev], samples, mTempSamples, length);
+            }
+            process(mSlots[next], samples, mFadeSamples, length);
+            const float step = 1.0f / (length / 2);
+            for (int i = 0; i < length; i++) {
+                float g = (i / 2) * step;
+                samples[i] = mTempSamples[i] + g * (mFadeSamples[i] - mTempSamples[i]);
+            }
+            mSlots[prev].free.store(true);
+            return;
+        }
+        if (!ready(mSlots[mActive])) {
+            return; // no delay lines, pass the dry signal through
+        }
+        process(mSlots[mActive], samples, mTempSamples, length);
         std::memcpy(samples, mTempSamples, sizeof(float) * length);
     }
 
@@ -34,9 +263,24 @@ public:
     {
         if (mPreset != v) {
             mPreset = v;
-            sf_presetreverb(&mState, SAMPLE_RATE, mPreset);
+            rebuild();
         }
     }
     sf_reverb_preset preset() { return mPreset; }
+    void engine(ReverbEngine v)
+    {
+        if (mEngine != v) {
+            mEngine = v;
+            rebuild();
+        }
+    }
+    ReverbEngine engine() { return mEngine; }
+    // blocks until the worker has handed the latest preset and engine to the
+    // audio thread, for measurements that mustn't depend on thread timing
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mBuiltChanged.wait(lock, [this] { return mBuilt == mRequested.load(); });
+    }
 };
 #endif
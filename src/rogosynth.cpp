@@ -1,67 +1,273 @@
 #include "rogosynth.h"
-#include "audio.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <string>
 
-#ifdef MTR_ENABLED
-#include "minitrace/minitrace.h"
-#else
-#define mtr_init(X) {}
-#define mtr_shutdown() {}
-#define MTR_BEGIN(X,Y) {}
-#define MTR_END(X,Y) {}
-#endif
+#include "trace.h"
+
+// everything RogoSynth::RogoSynth() puts in the arena
+size_t RogoSynth::arenaBytes()
+{
+    return EngineArena::padded(sizeof(Tuning)) + EngineArena::padded(sizeof(ModMatrix)) +
+           EngineArena::padded(sizeof(FmPatch)) + EngineArena::padded(sizeof(Wavetable)) +
+           NUM_SYNTHS * EngineArena::padded(sizeof(SynthVoice)) +
+           EngineArena::padded(sizeof(Compressor)) + EngineArena::padded(sizeof(LowPassFilter)) +
+           EngineArena::padded(sizeof(Reverb)) + EngineArena::padded(sizeof(Convolver)) +
+           EngineArena::padded(sizeof(StageProfiler)) + Reverb::reserveBytes();
+}
 
 RogoSynth::RogoSynth() 
 {
+    // size the arena before opening it; working out the reverb's share
+    // builds every preset once
+    mArena = new EngineArena(arenaBytes());
+    mArena->openSndfilter();
+    mTuning = mArena->create<Tuning>();
+    mModMatrix = mArena->create<ModMatrix>();
+    static_assert(NUM_SYNTHS <= LfoBank::GLOBAL_LANE, "every voice needs an LFO lane");
+    mFmPatch = mArena->create<FmPatch>();
+    mWavetable = mArena->create<Wavetable>();
     for (int i = 0; i < NUM_SYNTHS; i++) {
-        mSynths[i] = new SynthVoice(SYNTH_AMPLITUDE);
+        mSynths[i] = mArena->create<SynthVoice>(SYNTH_AMPLITUDE, mTuning, mModMatrix, mFmPatch,
+                                                mWavetable, i);
     }
     mPanPosition = 0.0f;
-    mCompressor = new Compressor();
-    mLowPassFilter = new LowPassFilter(500.0f, 5.0f);
-    mReverb = new Reverb(SF_REVERB_PRESET_DEFAULT);
+    mPanSpread = 0.0f;
+    for (int i = 0; i < NUM_SYNTHS; i++) {
+        mNoteSerial[i] = 0;
+        mSustained[i] = false;
+    }
+    mNextSerial = 0;
+    mSustainPedal = false;
+    mCompressor = mArena->create<Compressor>();
+    mLowPassFilter = mArena->create<LowPassFilter>(500.0f, 5.0f);
+    mReverb = mArena->create<Reverb>(SF_REVERB_PRESET_DEFAULT);
+    mConvolver = mArena->create<Convolver>();
+    mProfiler = mArena->create<StageProfiler>();
+    // impulse responses are loaded later, from the heap
+    EngineArena::closeSndfilter();
+#ifndef NDEBUG
+    std::cout << "engine arena: " << mArena->used() << " of " << mArena->size() << " bytes\n";
+#endif
+    mReverbType = ReverbType::algorithmic;
+    mProfiler->add("voices");
+    for (int i = 0; i < NUM_SYNTHS; i++) {
+        mProfiler->add("  voice " + std::to_string(i));
+    }
+    mProfiler->add("compressor");
+    mProfiler->add("LPF");
+    mProfiler->add("reverb");
+    assert(mProfiler->numSlots() == NUM_STAGES);
+}
+
+// the arena destroys the engine objects in reverse order
+RogoSynth::~RogoSynth() { delete mArena; }
+
+// load an impulse response and switch to the convolution reverb
+bool RogoSynth::loadImpulseResponse(const char *path)
+{
+    if (!mConvolver->load(path)) {
+        return false;
+    }
+    mReverbType = ReverbType::convolution;
+    return true;
+}
 
+bool RogoSynth::loadSample(const char *path)
+{
+    std::shared_ptr<const Sample> sample = SamplePool::shared().load(path);
+    if (!sample) {
+        return false;
+    }
+    auto at = std::upper_bound(mSamples.begin(), mSamples.end(), sample->rootNote(),
+                               [](int root, const std::shared_ptr<const Sample> &s) {
+                                   return root < s->rootNote();
+                               });
+    mSamples.insert(at, sample);
+    if (sample->streamed()) {
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            mSynths[i]->enableStreaming();
+        }
+    }
+    return true;
 }
 
-RogoSynth::~RogoSynth()
+// the sample with the nearest root, the lower one on a tie
+const Sample *RogoSynth::sampleFor(int pitch)
 {
+    if (mSamples.empty()) {
+        return nullptr;
+    }
+    auto above = std::lower_bound(mSamples.begin(), mSamples.end(), pitch,
+                                  [](const std::shared_ptr<const Sample> &s, int pitch) {
+                                      return s->rootNote() < pitch;
+                                  });
+    if (above == mSamples.end()) {
+        return mSamples.back().get();
+    }
+    if (above != mSamples.begin() &&
+        pitch - (*(above - 1))->rootNote() <= (*above)->rootNote() - pitch) {
+        return (above - 1)->get();
+    }
+    return above->get();
+}
+
+// A free voice if there is one, otherwise steal the oldest note that is
+// releasing, otherwise the oldest note.
+int RogoSynth::allocateVoice()
+{
+    int oldest = 0, oldestReleasing = -1;
     for (int i = 0; i < NUM_SYNTHS; i++) {
-        delete mSynths[i];
+        if (!mSynths[i]->active()) {
+            return i;
+        }
+        if (mNoteSerial[i] < mNoteSerial[oldest]) {
+            oldest = i;
+        }
+        if (mSynths[i]->releasing() &&
+            (oldestReleasing < 0 || mNoteSerial[i] < mNoteSerial[oldestReleasing])) {
+            oldestReleasing = i;
+        }
     }
-    delete mCompressor;
-    delete mLowPassFilter;
-    delete mReverb;
+    return oldestReleasing >= 0 ? oldestReleasing : oldest;
 }
 
-void RogoSynth::updateSamples(float *samples, long length)
+void RogoSynth::midiEvent(const MidiEvent &event)
 {
+    int pitch = event.data1;
+    switch (event.status & 0xF0) {
+    case 0x90: {
+        int voice = allocateVoice();
+        noteOn(voice, pitch);
+        mSustained[voice] = false;
+        break;
+    }
+    case 0x80:
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            if (mSynths[i]->pitch() == pitch && mSynths[i]->active() &&
+                !mSynths[i]->releasing() && !mSustained[i]) {
+                if (mSustainPedal) {
+                    mSustained[i] = true;
+                }
+                else {
+                    mSynths[i]->noteOff();
+                }
+                break;
+            }
+        }
+        break;
+    case 0xB0:
+        switch (event.data1) {
+        case 1: // mod wheel
+            mModMatrix->modWheel(event.data2);
+            break;
+        case 7: // volume
+            amplitude(SYNTH_AMPLITUDE * event.data2 / 127.0f);
+            break;
+        case 10: // pan
+            panPosition(std::clamp((event.data2 - 64) / 63.0f, -1.0f, 1.0f));
+            break;
+        case 64: // sustain pedal
+            mSustainPedal = event.data2 >= 64;
+            if (!mSustainPedal) {
+                for (int i = 0; i < NUM_SYNTHS; i++) {
+                    if (mSustained[i]) {
+                        mSynths[i]->noteOff();
+                        mSustained[i] = false;
+                    }
+                }
+            }
+            break;
+        case 71: // resonance, over the GUI's range
+            lpfResonance(100.0f * event.data2 / 127.0f);
+            break;
+        case 74: // brightness: cutoff from 20Hz to 2kHz like the GUI
+            lpfCutoff(20.0f * powf(100.0f, event.data2 / 127.0f));
+            break;
+        case 120: // all sound off
+        case 123: // all notes off
+            for (int i = 0; i < NUM_SYNTHS; i++) {
+                if (mSynths[i]->active() && !mSynths[i]->releasing()) {
+                    mSynths[i]->noteOff();
+                }
+                mSustained[i] = false;
+            }
+            break;
+        }
+        break;
+    case 0xE0:
+        mModMatrix->pitchBend(event.data1 | (event.data2 << 7));
+        break;
+    }
+}
 
-    MTR_BEGIN("RogoSynth", "voices");
-    // add all active synths together
+// add all the synths together; always call addSamples on every voice so
+// time & phase are consistent
+void RogoSynth::renderVoices(float *samples, long length, int frame)
+{
+    // the voices reach the control tick of their last frame
+    mModMatrix->prepare((frame + length / 2 - 1) / CONTROL_RATE);
+    uint64_t t = StageProfiler::now();
+    for (int i = 0; i < NUM_SYNTHS; i++) {
+        mSynths[i]->addSamples(samples, length, frame);
+        t = mProfiler->lap(STAGE_VOICE0 + i, t);
+    }
+}
+
+void RogoSynth::updateSamples(float *samples, long length, const MidiEvent *events,
+                              int numEvents, uint64_t frame)
+{
+
+    uint64_t start = StageProfiler::now();
+    uint64_t t = start;
+    TRACE_BEGIN("RogoSynth", "voices");
+    // Render the voices piecewise, up to each event's frame, so notes start
+    // and stop on the exact sample.  Late events apply at the first frame.
+    const int frames = AUDIO_BUFFER_STEREO_SAMPLES;
+    int done = 0, next = 0;
+    mModMatrix->beginBuffer();
+    while (done < frames) {
+        while (next < numEvents && events[next].frame <= frame + done) {
+            midiEvent(events[next++]);
+        }
+        int until = frames;
+        if (next < numEvents) {
+            until = (int)std::min<uint64_t>(events[next].frame - frame, frames);
+        }
+        renderVoices(samples + 2 * done, 2 * (until - done), done);
+        done = until;
+    }
+    assert(next == numEvents);
     int numActiveSynths = 0;
     for (int i = 0; i < NUM_SYNTHS; i++) {
         if (mSynths[i]->active()) {
             numActiveSynths++;
         }
-        // always call addSamples so time & phase are consistent
-        mSynths[i]->addSamples(samples, AUDIO_BUFFER_SAMPLES);
-    }
-    MTR_COUNTER("RogoSynth", "numVoices", numActiveSynths);
-    MTR_END("RogoSynth", "voices");
-    MTR_BEGIN("RogoSynth", "pan");
-    // pan synths left/right
-    pan(samples, AUDIO_BUFFER_SAMPLES, mPanPosition);
-    MTR_END("RogoSynth", "pan");
+    }
+    t = mProfiler->lap(STAGE_VOICES, start);
+    TRACE_COUNTER("RogoSynth", "numVoices", numActiveSynths);
+    TRACE_END("RogoSynth", "voices");
     // compressor to try to keep synths from cracking
-    MTR_BEGIN("RogoSynth", "compressor");
+    TRACE_BEGIN("RogoSynth", "compressor");
     mCompressor->updateSamples(samples, AUDIO_BUFFER_SAMPLES);
-    MTR_END("RogoSynth", "compressor");
+    t = mProfiler->lap(STAGE_COMPRESSOR, t);
+    TRACE_END("RogoSynth", "compressor");
     // low pass resonant filter
-    MTR_BEGIN("RogoSynth", "LPF");
-    mLowPassFilter->updateSamples(samples, AUDIO_BUFFER_SAMPLES);
-    MTR_END("RogoSynth", "LPF");
+    TRACE_BEGIN("RogoSynth", "LPF");
+    mLowPassFilter->updateSamples(samples, AUDIO_BUFFER_SAMPLES, mModMatrix->cutoff());
+    t = mProfiler->lap(STAGE_LPF, t);
+    TRACE_END("RogoSynth", "LPF");
     // reverb
-    MTR_BEGIN("RogoSynth", "reverb");
-    mReverb->updateSamples(samples, AUDIO_BUFFER_SAMPLES);
-    MTR_END("RogoSynth", "reverb");
-
+    TRACE_BEGIN("RogoSynth", "reverb");
+    if (mReverbType == ReverbType::convolution && mConvolver->loaded()) {
+        mConvolver->updateSamples(samples, AUDIO_BUFFER_SAMPLES);
+    }
+    else {
+        mReverb->updateSamples(samples, AUDIO_BUFFER_SAMPLES);
+    }
+    mProfiler->lap(STAGE_REVERB, t);
+    TRACE_END("RogoSynth", "reverb");
+    mProfiler->commit();
 }
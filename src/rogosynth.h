@@ -2,31 +2,99 @@
 #define ROGOSYNTH_H
 #include "compressor.h"
 #include "constants.h"
+#include "convolver.h"
+#include "enginearena.h"
 #include "lowpassfilter.h"
+#include "midifile.h"
+#include "modmatrix.h"
 #include "reverb.h"
+#include "samplepool.h"
+#include "stageprofiler.h"
 #include "synthvoice.h"
+#include "tuning.h"
+#include <memory>
+#include <vector>
+
+enum class ReverbType { algorithmic, convolution };
 
 class RogoSynth {
 
     static const int NUM_SYNTHS = 8;
     const float SYNTH_AMPLITUDE = 1.0f / NUM_SYNTHS;
 
+    // All engine state lives in one arena, each object on its own cache
+    // lines, so voices never share a line with each other or with the
+    // effects.  The state structures are also too big for the stack.
+    EngineArena *mArena;
+    Tuning *mTuning;
+    ModMatrix *mModMatrix;
+    FmPatch *mFmPatch;
+    Wavetable *mWavetable;
     SynthVoice *mSynths[NUM_SYNTHS];
-    float mPanPosition;
-    // These need to be on the heap, not the stack as the state structures
-    // are pretty big.
+    float mPanPosition; // -1..1, every voice
+    float mPanSpread;   // how far notes move from it by pitch
     Compressor *mCompressor;
     LowPassFilter *mLowPassFilter;
     Reverb *mReverb;
+    Convolver *mConvolver;
+    ReverbType mReverbType;
+    // what WaveType::sample plays, sorted by root note
+    std::vector<std::shared_ptr<const Sample>> mSamples;
+    // profiler slots, in the order they are added in the constructor
+    enum Stage {
+        STAGE_VOICES,
+        STAGE_VOICE0,
+        STAGE_COMPRESSOR = STAGE_VOICE0 + NUM_SYNTHS,
+        STAGE_LPF,
+        STAGE_REVERB,
+        NUM_STAGES
+    };
+    StageProfiler *mProfiler;
+    // MIDI voice allocation
+    uint32_t mNoteSerial[NUM_SYNTHS]; // when each voice's note started
+    uint32_t mNextSerial;
+    bool mSustained[NUM_SYNTHS]; // released while the pedal is down
+    bool mSustainPedal;
+
+    static size_t arenaBytes();
+    int allocateVoice();
+    void placeVoice(int voice)
+    {
+        int fromMiddleC = mSynths[voice]->pitch() - Tuning::REFERENCE_NOTE;
+        mSynths[voice]->pan(mPanPosition + mPanSpread * fromMiddleC / 64.0f);
+    }
+    const Sample *sampleFor(int pitch);
+    void renderVoices(float *samples, long length, int frame);
 
   public:
     RogoSynth();
     ~RogoSynth();
-    void updateSamples(float *samples, long length);
+    // Render one buffer.  MIDI events, sorted and timed on the same
+    // timeline as frame (the time of samples[0]), take effect at their
+    // exact sample.
+    void updateSamples(float *samples, long length, const MidiEvent *events = nullptr,
+                       int numEvents = 0, uint64_t frame = 0);
+    // note on/off (picking the voice), sustain pedal and the CCs that map
+    // onto engine parameters
+    void midiEvent(const MidiEvent &event);
+    bool loadImpulseResponse(const char *path);
+    // add a sample for WaveType::sample; each note plays the one whose root
+    // is nearest.  Like the impulse response, load before audio starts.
+    bool loadSample(const char *path);
+    int numSamples() { return (int)mSamples.size(); }
+    // import frames for WaveType::wavetable, once, before audio starts;
+    // they play once their mip-maps are built in the background
+    bool loadWavetable(const char *path) { return mWavetable->load(path); }
     // getters/setters
     int numSynths() { return NUM_SYNTHS; }
     bool active(int voice) { return mSynths[voice]->active(); }
-    void noteOn(int voice, int pitch) { mSynths[voice]->noteOn(pitch); }
+    void noteOn(int voice, int pitch)
+    {
+        mSynths[voice]->noteOn(pitch, sampleFor(pitch));
+        placeVoice(voice);
+        mModMatrix->noteOn(voice);
+        mNoteSerial[voice] = ++mNextSerial;
+    }
     void noteOff(int voice) { mSynths[voice]->noteOff(); }
     int pitch(int voice) { return mSynths[voice]->pitch(); }
     bool releasing(int voice) { return mSynths[voice]->releasing(); }
@@ -72,13 +140,83 @@ class RogoSynth {
             mSynths[i]->type(v);
         }
     }
+    int unison() { return mSynths[0]->unison(); }
+    void unison(int v)
+    {
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            mSynths[i]->unison(v);
+        }
+    }
+    float unisonDetune() { return mSynths[0]->unisonDetune(); }
+    void unisonDetune(float v)
+    {
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            mSynths[i]->unisonDetune(v);
+        }
+    }
+    float unisonSpread() { return mSynths[0]->unisonSpread(); }
+    void unisonSpread(float v)
+    {
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            mSynths[i]->unisonSpread(v);
+        }
+    }
+    float fineTune() { return mTuning->fineTune(); }
+    void fineTune(float cents) { mTuning->fineTune(cents); }
+    float bendRange() { return mTuning->bendRange(); }
+    void bendRange(float semitones) { mTuning->bendRange(semitones); }
+    bool loadScala(const char *path) { return mTuning->loadScala(path); }
+    void equalTemperament() { mTuning->equalTemperament(); }
+    const std::string &tuningName() { return mTuning->name(); }
+    // routes and LFOs are edited in place
+    ModMatrix *modMatrix() { return mModMatrix; }
+    // the operators used by WaveType::fm, also edited in place
+    FmPatch *fmPatch() { return mFmPatch; }
+    // likewise the table used by WaveType::wavetable
+    Wavetable *wavetable() { return mWavetable; }
+    Envelope &modEnvelope() { return mSynths[0]->modEnvelope(); }
+    void modEnvelope(float attack, float decay, float sustain, float release)
+    {
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            Envelope &env = mSynths[i]->modEnvelope();
+            env.attack(attack);
+            env.decay(decay);
+            env.sustain(sustain);
+            env.release(release);
+        }
+    }
+    // the voices apply pan as they mix, each note placed at the position
+    // plus spread * its distance from middle C, a full step per 64 notes
     float panPosition() { return mPanPosition; }
-    void panPosition(float v) { mPanPosition = v; }
+    void panPosition(float v)
+    {
+        mPanPosition = v;
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            placeVoice(i);
+        }
+    }
+    float panSpread() { return mPanSpread; }
+    void panSpread(float v)
+    {
+        mPanSpread = v;
+        for (int i = 0; i < NUM_SYNTHS; i++) {
+            placeVoice(i);
+        }
+    }
     float lpfCutoff() { return mLowPassFilter->cutoff(); }
     void lpfCutoff(float v) { mLowPassFilter->cutoff(v); }
     float lpfResonance() { return mLowPassFilter->resonance(); }
     void lpfResonance(float v) { mLowPassFilter->resonance(v); }
     sf_reverb_preset reverbPreset() { return mReverb->preset(); }
     void reverbPreset(sf_reverb_preset v) { mReverb->preset(v); }
+    ReverbEngine reverbEngine() { return mReverb->engine(); }
+    void reverbEngine(ReverbEngine v) { mReverb->engine(v); }
+    void waitReverb() { mReverb->wait(); }
+    bool hasImpulseResponse() { return mConvolver->loaded(); }
+    ReverbType reverbType() { return mReverbType; }
+    void reverbType(ReverbType v) { mReverbType = v; }
+    float convolutionWet() { return mConvolver->wet(); }
+    void convolutionWet(float v) { mConvolver->wet(v); }
+    StageProfiler *profiler() { return mProfiler; }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "sampleplayer.h"
+#include <algorithm>
+
+// 4 point, 3rd order Hermite through x[1]..x[2]
+static inline float hermite(const float *x, float t)
+{
+    float c1 = 0.5f * (x[2] - x[0]);
+    float c2 = x[0] - 2.5f * x[1] + 2.0f * x[2] - 0.5f * x[3];
+    float c3 = 0.5f * (x[3] - x[0]) + 1.5f * (x[1] - x[2]);
+    return ((c3 * t + c2) * t + c1) * t + x[1];
+}
+
+// one output frame from the points around it; a null point is silence
+template <WavFormat F>
+static inline void mixFrame(const uint8_t *const *p, int second, float t, float g, float left,
+                            float right, float *out)
+{
+    float l[4], r[4];
+    for (int k = 0; k < 4; k++) {
+        l[k] = p[k] ? wavSample<F>(p[k]) : 0.0f;
+        r[k] = p[k] ? wavSample<F>(p[k] + second) : 0.0f;
+    }
+    out[0] += hermite(l, t) * g * left;
+    out[1] += hermite(r, t) * g * right;
+}
+
+// all of the sample is in its attack
+template <WavFormat F>
+static void playResident(const Sample &sample, double &position, float *samples, int frames,
+                         const float *increment, float incrementToStep, const float *gain,
+                         const float *left, const float *right)
+{
+    const WavInfo &w = sample.info();
+    // the last frame before the loop goes back, or the end
+    const int64_t last = (int64_t)sample.length() - 1;
+    const double loopLength = w.looped ? (double)(w.loopEnd - w.loopStart + 1) : 0.0;
+    const int stride = w.frameBytes;
+    const int second = (w.channels > 1) ? w.bytesPerSample : 0;
+    const uint8_t *data = sample.attack();
+    for (int f = 0; f < frames; f++) {
+        int64_t i = (int64_t)position;
+        if (i > last) {
+            break; // a one shot sample has finished
+        }
+        const uint8_t *p[4];
+        for (int k = 0; k < 4; k++) {
+            int64_t j = i - 1 + k;
+            // the points around the loop point come from the loop's start
+            if (w.looped && j > last) {
+                j -= (int64_t)loopLength;
+            }
+            p[k] = (j < 0 || j > last) ? nullptr : data + j * stride;
+        }
+        mixFrame<F>(p, second, (float)(position - (double)i), gain[f], left[f], right[f],
+                    samples + 2 * f);
+        position += increment[f] * incrementToStep;
+        while (w.looped && position >= last + 1) {
+            position -= loopLength;
+        }
+    }
+}
+
+// the attack, then the stream, which has the loops unrolled; false if the
+// voice caught up with the stream
+template <WavFormat F>
+static bool playStreamed(const Sample &sample, const SampleStream &stream, double &position,
+                         float *samples, int frames, const float *increment,
+                         float incrementToStep, const float *gain, const float *left,
+                         const float *right)
+{
+    const WavInfo &w = sample.info();
+    const int64_t attack = (int64_t)sample.attackFrames();
+    const int64_t end = w.looped ? INT64_MAX : (int64_t)sample.length();
+    const int64_t written = (int64_t)stream.available();
+    const int stride = w.frameBytes;
+    const int second = (w.channels > 1) ? w.bytesPerSample : 0;
+    const uint8_t *head = sample.attack();
+    bool kept = true;
+    for (int f = 0; f < frames; f++) {
+        int64_t i = (int64_t)position;
+        if (i >= end) {
+            break;
+        }
+        const uint8_t *p[4];
+        const uint8_t *run = nullptr;
+        if (i >= 1 && i + 2 < attack) {
+            run = head + (i - 1) * stride;
+        }
+        else if (i - 1 >= attack && i + 2 < written && stream.contiguous(i - 1, 4)) {
+            run = stream.frame(i - 1, stride);
+        }
+        for (int k = 0; k < 4; k++) {
+            int64_t j = i - 1 + k;
+            if (run) {
+                p[k] = run + k * stride;
+            }
+            else if (j < 0 || j >= end) {
+                p[k] = nullptr;
+            }
+            else if (j < attack) {
+                p[k] = head + j * stride;
+            }
+            else if (j < written) {
+                p[k] = stream.frame(j, stride);
+            }
+            else {
+                p[k] = nullptr;
+                kept = false;
+            }
+        }
+        mixFrame<F>(p, second, (float)(position - (double)i), gain[f], left[f], right[f],
+                    samples + 2 * f);
+        position += increment[f] * incrementToStep;
+    }
+    return kept;
+}
+
+template <WavFormat F>
+static void play(const Sample &sample, SampleStream &stream, double &position, float *samples,
+                 int frames, const float *increment, float incrementToStep, const float *gain,
+                 const float *left, const float *right)
+{
+    if (!sample.streamed()) {
+        playResident<F>(sample, position, samples, frames, increment, incrementToStep, gain,
+                        left, right);
+        return;
+    }
+    if (!playStreamed<F>(sample, stream, position, samples, frames, increment, incrementToStep,
+                         gain, left, right) &&
+        stream.enabled()) {
+        SampleStreamer::shared().underrun();
+    }
+    // the Hermite points start a frame back
+    stream.played((uint64_t)std::max<int64_t>((int64_t)position - 1, 0));
+}
+
+void SamplePlayer::addSamples(float *samples, int frames, const float *increment,
+                              float incrementToStep, const float *gain, const float *left,
+                              const float *right)
+{
+    if (mSample == nullptr) {
+        return;
+    }
+    switch (mSample->info().format) {
+    case WavFormat::pcm16:
+        play<WavFormat::pcm16>(*mSample, mStream, mPosition, samples, frames, increment,
+                               incrementToStep, gain, left, right);
+        break;
+    case WavFormat::pcm24:
+        play<WavFormat::pcm24>(*mSample, mStream, mPosition, samples, frames, increment,
+                               incrementToStep, gain, left, right);
+        break;
+    case WavFormat::pcm32:
+        play<WavFormat::pcm32>(*mSample, mStream, mPosition, samples, frames, increment,
+                               incrementToStep, gain, left, right);
+        break;
+    case WavFormat::float32:
+        play<WavFormat::float32>(*mSample, mStream, mPosition, samples, frames, increment,
+                                 incrementToStep, gain, left, right);
+        break;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef ROGOSYNTH_SAMPLEPLAYER_H
+#define ROGOSYNTH_SAMPLEPLAYER_H
+#include "samplepool.h"
+#include "samplestream.h"
+
+// Plays a Sample at a varying rate with 4 point Hermite interpolation,
+// from its attack in memory and, for a streamed sample, then from the
+// voice's stream.  A sample with loop points loops between them for as
+// long as the voice lasts; one without stops at its end.  Mono samples
+// play in both channels.
+class SamplePlayer {
+    const Sample *mSample;
+    // in the sample's frames; a streamed sample counts on through loops,
+    // like its stream
+    double mPosition;
+    SampleStream mStream;
+
+  public:
+    SamplePlayer() : mSample(nullptr), mPosition(0.0) {}
+    // sample may be null, for silence
+    void noteOn(const Sample *sample)
+    {
+        mSample = sample;
+        mPosition = 0.0;
+        if (sample && sample->streamed()) {
+            mStream.start(sample);
+        }
+    }
+    const Sample *sample() const { return mSample; }
+    // before audio starts, if any sample will be streamed; without it a
+    // streamed sample goes silent after its attack
+    void enableStreaming() { mStream.enable(); }
+    // frame f advances increment[f] * incrementToStep sample frames; the
+    // output is scaled by gain and panned by left/right
+    void addSamples(float *samples, int frames, const float *increment, float incrementToStep,
+                    const float *gain, const float *left, const float *right);
+};
+#endif
@@ -0,0 +1,54 @@
+#include "samplepool.h"
+#include "samplestream.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+bool Sample::load(const char *path)
+{
+    if (!mFile.open(path) || !parseWav(mFile.data(), mFile.size(), path, mInfo)) {
+        mFile.close();
+        return false;
+    }
+    // a voice plays two channels, and streams at most MAX_FRAME_BYTES a frame
+    if (mInfo.channels > 2) {
+        std::cerr << "ERROR: " << path << " has " << mInfo.channels
+                  << " channels; samples are mono or stereo\n";
+        mFile.close();
+        return false;
+    }
+    assert(mInfo.frameBytes <= SampleStream::MAX_FRAME_BYTES);
+    mPath = path;
+    mLength = mInfo.looped ? mInfo.loopEnd + 1 : mInfo.frames;
+    mAttackFrames = std::min(mLength, ATTACK_BYTES / mInfo.frameBytes);
+    size_t attackBytes = mAttackFrames * mInfo.frameBytes;
+    mAttack.reset(new uint8_t[attackBytes]);
+    memcpy(mAttack.get(), mInfo.data, attackBytes);
+    if (streamed()) {
+        // have the first stream reads waiting in the page cache
+        prefetch(mAttackFrames, ATTACK_BYTES / mInfo.frameBytes);
+    }
+    return true;
+}
+
+SamplePool &SamplePool::shared()
+{
+    static SamplePool pool;
+    return pool;
+}
+
+std::shared_ptr<const Sample> SamplePool::load(const char *path)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::shared_ptr<const Sample> sample = mSamples[path].lock();
+    if (sample) {
+        return sample;
+    }
+    auto loaded = std::make_shared<Sample>();
+    if (!loaded->load(path)) {
+        mSamples.erase(path);
+        return nullptr;
+    }
+    mSamples[path] = loaded;
+    return loaded;
+}
@@ -0,0 +1,65 @@
+#ifndef ROGOSYNTH_SAMPLEPOOL_H
+#define ROGOSYNTH_SAMPLEPOOL_H
+#include "mappedfile.h"
+#include "wavfile.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// A WAV file mapped for playback.  Its attack, the first ATTACK_BYTES, is
+// copied into memory when it loads, so voices start without touching the
+// disk.  A sample that is longer than that is streamed: SampleStream
+// copies the rest from the mapping ahead of each voice that plays it, on
+// an I/O thread.
+class Sample {
+    MappedFile mFile;
+    WavInfo mInfo;
+    std::string mPath;
+    std::unique_ptr<uint8_t[]> mAttack;
+    size_t mAttackFrames;
+    size_t mLength; // frames played before it stops or loops back
+
+  public:
+    static const size_t ATTACK_BYTES = 128 * 1024;
+
+    Sample() : mAttackFrames(0), mLength(0) {}
+    bool load(const char *path);
+    const WavInfo &info() const { return mInfo; }
+    const std::string &path() const { return mPath; }
+    // the first frames, in memory; every frame that plays unless streamed
+    const uint8_t *attack() const { return mAttack.get(); }
+    size_t attackFrames() const { return mAttackFrames; }
+    size_t length() const { return mLength; }
+    bool streamed() const { return mAttackFrames < mLength; }
+    // the frame played at position k, counting on through any loops
+    size_t frameAt(uint64_t k) const
+    {
+        if (k < mLength) {
+            return (size_t)k;
+        }
+        size_t loopLength = mInfo.loopEnd - mInfo.loopStart + 1;
+        return mInfo.loopStart + (size_t)((k - mInfo.loopStart) % loopLength);
+    }
+    // in the mapping, so only for the I/O thread
+    const uint8_t *mapped(size_t frame) const { return mInfo.data + frame * mInfo.frameBytes; }
+    void prefetch(size_t frame, size_t frames) const
+    {
+        mFile.prefetch(mapped(frame) - mFile.data(), frames * mInfo.frameBytes);
+    }
+    // MIDI note it plays at its own pitch, middle C if the file doesn't say
+    int rootNote() const { return mInfo.rootNote >= 0 ? mInfo.rootNote : 60; }
+};
+
+// Every Sample in the process, one per file however many voices or engines
+// play it.  A file stays mapped while anything holds its shared_ptr.
+class SamplePool {
+    std::mutex mMutex;
+    std::map<std::string, std::weak_ptr<const Sample>> mSamples;
+
+  public:
+    static SamplePool &shared();
+    // prints the reason and returns null if the file can't be played
+    std::shared_ptr<const Sample> load(const char *path);
+};
+#endif
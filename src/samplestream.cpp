@@ -0,0 +1,130 @@
+#include "samplestream.h"
+#include "realtime.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+SampleStream::SampleStream()
+    : mRing(nullptr), mRequested(nullptr), mRequest(0), mRead(0), mServing(0), mWritten(0),
+      mServed(0), mSample(nullptr), mNext(0)
+{
+}
+
+SampleStream::~SampleStream()
+{
+    if (mRing) {
+        SampleStreamer::shared().remove(this);
+        delete[] mRing;
+    }
+}
+
+void SampleStream::enable()
+{
+    if (mRing) {
+        return;
+    }
+    mRing = new uint8_t[RING_FRAMES * MAX_FRAME_BYTES];
+    SampleStreamer::shared().add(this);
+}
+
+// The ring is only read once the I/O thread has answered this request, by
+// which time it has also seen the new read position.
+void SampleStream::start(const Sample *sample)
+{
+    if (mRing == nullptr) {
+        return;
+    }
+    mRead.store(0, std::memory_order_relaxed);
+    mRequested.store(sample, std::memory_order_relaxed);
+    mRequest.fetch_add(1, std::memory_order_release);
+}
+
+// I/O thread: copy up to maxFrames into the ring, as far ahead of the
+// voice as it has room for
+size_t SampleStream::fill(size_t maxFrames)
+{
+    uint32_t request = mRequest.load(std::memory_order_acquire);
+    if (request != mServed) {
+        mServed = request;
+        mSample = mRequested.load(std::memory_order_relaxed);
+        mNext = mSample ? mSample->attackFrames() : 0;
+        mWritten.store(mNext, std::memory_order_relaxed);
+        mServing.store(request, std::memory_order_release);
+    }
+    if (mSample == nullptr || !mSample->streamed()) {
+        return 0;
+    }
+    uint64_t end = mRead.load(std::memory_order_acquire) + RING_FRAMES;
+    if (!mSample->info().looped) {
+        end = std::min<uint64_t>(end, mSample->length());
+    }
+    if (mNext >= end) {
+        return 0;
+    }
+    const size_t frames = (size_t)std::min<uint64_t>(end - mNext, maxFrames);
+    const int frameBytes = mSample->info().frameBytes;
+    // in runs that end at the ring's end or where a loop goes back
+    for (size_t done = 0; done < frames;) {
+        uint64_t k = mNext + done;
+        size_t from = mSample->frameAt(k);
+        size_t slot = (size_t)(k & (RING_FRAMES - 1));
+        size_t run = std::min({frames - done, RING_FRAMES - slot, mSample->length() - from});
+        memcpy(mRing + slot * frameBytes, mSample->mapped(from), run * frameBytes);
+        done += run;
+    }
+    mNext += frames;
+    mWritten.store(mNext, std::memory_order_release);
+    // have the next pass find its frames in the page cache
+    mSample->prefetch(mSample->frameAt(mNext), maxFrames);
+    return frames;
+}
+
+SampleStreamer &SampleStreamer::shared()
+{
+    static SampleStreamer streamer;
+    return streamer;
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    if (mWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWake.notify_one();
+        mWorker.join();
+    }
+}
+
+void SampleStreamer::add(SampleStream *stream)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStreams.push_back(stream);
+    if (!mWorker.joinable()) {
+        mWorker = std::thread(&SampleStreamer::workerLoop, this);
+    }
+}
+
+// waits for a pass that is filling the stream to finish
+void SampleStreamer::remove(SampleStream *stream)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStreams.erase(std::remove(mStreams.begin(), mStreams.end(), stream), mStreams.end());
+}
+
+void SampleStreamer::workerLoop()
+{
+    Realtime::configureThread(ThreadRole::background, "sample streaming");
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mQuit) {
+        // a chunk for each stream in turn, so one voice can't starve the rest
+        size_t copied = 0;
+        for (SampleStream *stream : mStreams) {
+            copied += stream->fill(CHUNK_FRAMES);
+        }
+        if (copied == 0) {
+            mWake.wait_for(lock, std::chrono::milliseconds(2));
+        }
+    }
+}
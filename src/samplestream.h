@@ -0,0 +1,92 @@
+#ifndef ROGOSYNTH_SAMPLESTREAM_H
+#define ROGOSYNTH_SAMPLESTREAM_H
+#include "samplepool.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One voice's stream of a Sample, past its attack.  The voice starts it at
+// note on and says how far it has played; the streamer's I/O thread copies
+// frames from the mapping into the ring ahead of that.  The ring is a
+// single producer, single consumer queue without locks: frames are kept in
+// the order they play, loops unrolled, position k in slot k % RING_FRAMES.
+class SampleStream {
+    friend class SampleStreamer;
+
+  public:
+    static const int RING_FRAMES = 32768; // a power of 2
+    static const int MAX_FRAME_BYTES = 8; // 32 bit stereo
+
+  private:
+    uint8_t *mRing;
+    // from the voice
+    std::atomic<const Sample *> mRequested;
+    std::atomic<uint32_t> mRequest; // bumped by every start()
+    std::atomic<uint64_t> mRead;    // the first position still needed
+    // from the I/O thread
+    std::atomic<uint32_t> mServing; // the request the ring holds frames for
+    std::atomic<uint64_t> mWritten; // positions up to here are in the ring
+    // the I/O thread's own
+    uint32_t mServed;
+    const Sample *mSample;
+    uint64_t mNext;
+
+    size_t fill(size_t maxFrames);
+
+  public:
+    SampleStream();
+    ~SampleStream();
+    // allocate the ring and register with the streamer, before audio
+    // starts; until then start() is ignored
+    void enable();
+    bool enabled() const { return mRing != nullptr; }
+    // the voice's side
+    void start(const Sample *sample);
+    // positions before this are in the ring for the latest start()
+    uint64_t available() const
+    {
+        if (mServing.load(std::memory_order_acquire) != mRequest.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        return mWritten.load(std::memory_order_acquire);
+    }
+    const uint8_t *frame(uint64_t k, int frameBytes) const
+    {
+        return mRing + (k & (RING_FRAMES - 1)) * frameBytes;
+    }
+    // the frames after position k are contiguous in the ring
+    bool contiguous(uint64_t k, int count) const
+    {
+        return (k & (RING_FRAMES - 1)) + count <= RING_FRAMES;
+    }
+    void played(uint64_t position) { mRead.store(position, std::memory_order_release); }
+};
+
+// The I/O thread that keeps every enabled SampleStream's ring full.  It
+// starts with the first stream and polls them, as the convolution tail
+// worker polls for work, so a voice never has to wake it.
+class SampleStreamer {
+    std::vector<SampleStream *> mStreams;
+    std::atomic<uint32_t> mUnderruns{0};
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mQuit;
+
+    void workerLoop();
+
+  public:
+    static const size_t CHUNK_FRAMES = 4096; // per stream per pass
+
+    SampleStreamer() : mQuit(false) {}
+    ~SampleStreamer();
+    static SampleStreamer &shared();
+    void add(SampleStream *stream);
+    void remove(SampleStream *stream);
+    // buffers in which a voice reached the end of its ring
+    void underrun() { mUnderruns.fetch_add(1, std::memory_order_relaxed); }
+    uint32_t underruns() const { return mUnderruns.load(std::memory_order_relaxed); }
+};
+#endif
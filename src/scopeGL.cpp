@@ -0,0 +1,217 @@
+#include "scopeGL.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static const char *vertexShaderSource = R"(#version 330 core
+layout(location = 0) in vec2 position;
+void main() { gl_Position = vec4(position, 0.0, 1.0); }
+)";
+
+static const char *fragmentShaderSource = R"(#version 330 core
+uniform vec4 color;
+out vec4 fragColor;
+void main() { fragColor = color; }
+)";
+
+static const float SPECTRUM_MIN_HZ = 20.0f;
+static const float SPECTRUM_MAX_HZ = 20000.0f;
+static const float SPECTRUM_FLOOR_DB = -90.0f;
+static const float SPECTRUM_FALLOFF_DB = 1.5f; // per update
+
+static GLuint compileShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint ok;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLchar log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << "ERROR: scope shader: " << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+ScopeGL::ScopeGL()
+{
+    mProgram = 0;
+    mMapped = nullptr;
+    mStaging = nullptr;
+    mRegion = 0;
+    mHaveFrame = false;
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        mFences[i] = 0;
+    }
+    initProgram();
+
+    glGenVertexArrays(1, &mVAO);
+    glBindVertexArray(mVAO);
+    glGenBuffers(1, &mVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    const GLsizeiptr regionBytes = sizeof(float) * 2 * VERTICES;
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, NUM_REGIONS * regionBytes, NULL, flags);
+        mMapped = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, NUM_REGIONS * regionBytes, flags);
+    }
+    if (mMapped == nullptr) {
+        glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+        mStaging = new float[2 * VERTICES];
+    }
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glBindVertexArray(0);
+
+    mHaveSpectrum = fft_init(&mPlan, FFT_SIZE);
+    if (!mHaveSpectrum) {
+        std::cerr << "ERROR: Couldn't allocate FFT tables, the scope has no spectrum.\n";
+    }
+    mRe = new float[FFT_SIZE];
+    mIm = new float[FFT_SIZE];
+    for (int i = 0; i < FFT_SIZE; i++) {
+        mWindow[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / FFT_SIZE);
+    }
+    for (int i = 0; i < SPECTRUM_POINTS; i++) {
+        mSpectrum[i] = SPECTRUM_FLOOR_DB;
+    }
+}
+
+ScopeGL::~ScopeGL()
+{
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        if (mFences[i]) {
+            glDeleteSync(mFences[i]);
+        }
+    }
+    if (mMapped != nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &mVBO);
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteProgram(mProgram);
+    delete[] mStaging;
+    delete[] mRe;
+    delete[] mIm;
+    fft_free(&mPlan);
+}
+
+bool ScopeGL::initProgram()
+{
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+    if (!vs || !fs) {
+        return false;
+    }
+    mProgram = glCreateProgram();
+    glAttachShader(mProgram, vs);
+    glAttachShader(mProgram, fs);
+    glLinkProgram(mProgram);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok;
+    glGetProgramiv(mProgram, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GLchar log[1024];
+        glGetProgramInfoLog(mProgram, sizeof(log), NULL, log);
+        std::cerr << "ERROR: scope program: " << log << std::endl;
+        glDeleteProgram(mProgram);
+        mProgram = 0;
+        return false;
+    }
+    mColorLoc = glGetUniformLocation(mProgram, "color");
+    return true;
+}
+
+// Hann windowed FFT of the mono mix, resampled onto log spaced points
+void ScopeGL::computeSpectrum(const float *samples)
+{
+    for (int i = 0; i < FFT_SIZE; i++) {
+        mRe[i] = 0.5f * (samples[2 * i] + samples[2 * i + 1]) * mWindow[i];
+        mIm[i] = 0.0f;
+    }
+    fft_forward(&mPlan, mRe, mIm);
+    // a full scale sine reads 0dB (the Hann window's gain is 1/2)
+    const float scale = 4.0f / FFT_SIZE;
+    for (int k = 0; k <= FFT_SIZE / 2; k++) {
+        mRe[k] = scale * sqrtf(mRe[k] * mRe[k] + mIm[k] * mIm[k]);
+    }
+    const float octaves = log2f(SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ);
+    for (int p = 0; p < SPECTRUM_POINTS; p++) {
+        float hz = SPECTRUM_MIN_HZ * exp2f(octaves * p / (SPECTRUM_POINTS - 1));
+        float bin = std::min(hz * FFT_SIZE / SAMPLE_RATE, FFT_SIZE / 2 - 1.0f);
+        int k = (int)bin;
+        float frac = bin - k;
+        float mag = mRe[k] + frac * (mRe[k + 1] - mRe[k]);
+        float db = std::max(20.0f * log10f(mag + 1e-9f), SPECTRUM_FLOOR_DB);
+        mSpectrum[p] = std::max(db, mSpectrum[p] - SPECTRUM_FALLOFF_DB);
+    }
+}
+
+void ScopeGL::update(const ScopeFrame &frame)
+{
+    if (mHaveSpectrum) {
+        computeSpectrum(frame.samples);
+    }
+
+    float *v = mStaging;
+    if (mMapped != nullptr) {
+        // don't overwrite a region the GPU may still be drawing from
+        int region = (mRegion + 1) % NUM_REGIONS;
+        if (mFences[region]) {
+            glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(mFences[region]);
+            mFences[region] = 0;
+        }
+        mRegion = region;
+        v = mMapped + 2 * VERTICES * region;
+    }
+    for (int c = 0; c < 2; c++) {
+        float center = c == 0 ? 0.75f : 0.25f;
+        for (int i = 0; i < SCOPE_POINTS; i++) {
+            *v++ = -1.0f + 2.0f * i / (SCOPE_POINTS - 1);
+            *v++ = center + 0.25f * std::max(-1.0f, std::min(1.0f, frame.samples[2 * i + c]));
+        }
+    }
+    for (int p = 0; p < SPECTRUM_POINTS; p++) {
+        *v++ = -1.0f + 2.0f * p / (SPECTRUM_POINTS - 1);
+        *v++ = -mSpectrum[p] / SPECTRUM_FLOOR_DB; // 0dB at the middle, floor at the bottom
+    }
+    if (mMapped == nullptr) {
+        const GLsizeiptr bytes = sizeof(float) * 2 * VERTICES;
+        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW); // orphan
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, mStaging);
+    }
+    mHaveFrame = true;
+}
+
+void ScopeGL::render()
+{
+    if (!mHaveFrame || mProgram == 0) {
+        return;
+    }
+    int first = mMapped != nullptr ? VERTICES * mRegion : 0;
+    glUseProgram(mProgram);
+    glBindVertexArray(mVAO);
+    glUniform4f(mColorLoc, 0.35f, 0.85f, 0.45f, 1.0f);
+    glDrawArrays(GL_LINE_STRIP, first, SCOPE_POINTS);
+    glUniform4f(mColorLoc, 0.35f, 0.65f, 0.95f, 1.0f);
+    glDrawArrays(GL_LINE_STRIP, first + SCOPE_POINTS, SCOPE_POINTS);
+    if (mHaveSpectrum) {
+        glUniform4f(mColorLoc, 0.95f, 0.75f, 0.30f, 1.0f);
+        glDrawArrays(GL_LINE_STRIP, first + 2 * SCOPE_POINTS, SPECTRUM_POINTS);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    if (mMapped != nullptr) {
+        if (mFences[mRegion]) {
+            glDeleteSync(mFences[mRegion]);
+        }
+        mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef ROGOSYNTH_SCOPE_GL_H
+#define ROGOSYNTH_SCOPE_GL_H
+
+#include "constants.h"
+extern "C" {
+#include "fft.h"
+}
+#include <GL/glew.h>
+
+// one callback's worth of the final interleaved stereo output, handed from
+// the audio thread to the UI through a TripleBuffer
+struct ScopeFrame {
+    float samples[AUDIO_BUFFER_SAMPLES];
+};
+
+// Oscilloscope (left channel above right) in the top half of the window and
+// a log-frequency spectrum of the mono mix in the bottom half.  Vertices
+// are streamed through a persistently mapped buffer split into three
+// regions fenced against the GPU; without ARB_buffer_storage each update
+// orphans and refills a plain buffer instead.
+class ScopeGL {
+    static const int SCOPE_POINTS = AUDIO_BUFFER_STEREO_SAMPLES; // per channel
+    static const int FFT_SIZE = AUDIO_BUFFER_STEREO_SAMPLES;
+    static const int SPECTRUM_POINTS = 512;
+    static const int VERTICES = 2 * SCOPE_POINTS + SPECTRUM_POINTS;
+    static const int NUM_REGIONS = 3;
+
+    GLuint mProgram;
+    GLint mColorLoc;
+    GLuint mVAO, mVBO;
+    float *mMapped; // all regions when persistently mapped, else nullptr
+    float *mStaging;
+    GLsync mFences[NUM_REGIONS];
+    int mRegion;
+    bool mHaveFrame;
+
+    bool mHaveSpectrum; // false if the FFT tables couldn't be allocated
+    fft_plan mPlan;
+    float *mRe, *mIm;
+    float mWindow[FFT_SIZE];
+    float mSpectrum[SPECTRUM_POINTS]; // dB, with slow falloff
+
+    bool initProgram();
+    void computeSpectrum(const float *samples);
+
+  public:
+    ScopeGL();
+    ~ScopeGL();
+    // new audio to display, interleaved stereo
+    void update(const ScopeFrame &frame);
+    void render();
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ROGOSYNTH_SEQUENCER_H
+#define ROGOSYNTH_SEQUENCER_H
+#include "midifile.h"
+
+// Plays a MidiFile's timeline one audio buffer at a time.  advance() only
+// moves a cursor through the pre-sorted events and hands back the ones due
+// in the next buffer as a range of the timeline, so it doesn't allocate and
+// can run on the audio thread.  Offline renders call it exactly the same
+// way, just as fast as they can.
+class Sequencer {
+    MidiFile mFile;
+    size_t mNext;
+    uint64_t mFrame;
+
+  public:
+    Sequencer() : mNext(0), mFrame(0) {}
+    bool load(const char *path)
+    {
+        rewind();
+        return mFile.load(path);
+    }
+    void rewind()
+    {
+        mNext = 0;
+        mFrame = 0;
+    }
+    // Events in the next frames; they are timed from the start of the file,
+    // and frame() before the call is the time of the buffer's first frame.
+    const MidiEvent *advance(int frames, int &count)
+    {
+        const std::vector<MidiEvent> &events = mFile.events();
+        size_t first = mNext;
+        mFrame += frames;
+        while (mNext < events.size() && events[mNext].frame < mFrame) {
+            mNext++;
+        }
+        count = (int)(mNext - first);
+        return events.data() + first;
+    }
+    uint64_t frame() const { return mFrame; }
+    uint64_t length() const { return mFile.length(); }
+    bool finished() const { return mNext == mFile.events().size() && mFrame >= mFile.length(); }
+};
+#endif
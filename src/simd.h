@@ -0,0 +1,14 @@
+#ifndef ROGOSYNTH_SIMD_H
+#define ROGOSYNTH_SIMD_H
+// Pick the vector instruction set for the inner DSP loops.  x86-64 always
+// has SSE2; 64-bit ARM (Jetson) always has NEON.  Anything else uses the
+// plain C++ loops, which every SIMD path must keep as a fallback.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROGOSYNTH_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define ROGOSYNTH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
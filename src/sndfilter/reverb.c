@@ -3,6 +3,8 @@
 // Project Home: https://github.com/velipso/sndfilter
 
 #include "reverb.h"
+#include "mem.h"
+#include "../simd.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdint.h>
@@ -22,6 +24,150 @@ static inline float clampf(float v, float min, float max){
 	return v < min ? min : (v > max ? max : v);
 }
 
+// step a read/write position forward around a buffer of the given size
+// (a compare is much cheaper than the integer division `%` costs in the inner loops)
+static inline int wrapinc(int pos, int size){
+	pos++;
+	return pos == size ? 0 : pos;
+}
+
+// floor of a float as an int, without the libm call
+static inline int floori(float v){
+	int i = (int)v;
+	return (float)i > v ? i - 1 : i;
+}
+
+//
+// lanes
+//
+// the L/R channels of a stage (or two skewed stages' L/R pairs) are run side by side as the lanes
+// of one vector; each lane does exactly the scalar arithmetic, in the same order, so the output is
+// bit for bit the same as the plain loops kept for other targets
+//
+// the delay lines are still read and written one lane at a time, since every lane has its own
+// buffer and position
+#if defined(ROGOSYNTH_SSE) || defined(ROGOSYNTH_NEON)
+#define SF_REVERB_LANES 1
+
+#if defined(ROGOSYNTH_SSE)
+typedef __m128  sf_rv_f4;
+typedef __m128i sf_rv_i4;
+
+static inline sf_rv_f4 f4_set(float a, float b, float c, float d){ return _mm_setr_ps(a, b, c, d); }
+static inline sf_rv_f4 f4_dup(float v){ return _mm_set1_ps(v); }
+static inline sf_rv_f4 f4_add(sf_rv_f4 a, sf_rv_f4 b){ return _mm_add_ps(a, b); }
+static inline sf_rv_f4 f4_sub(sf_rv_f4 a, sf_rv_f4 b){ return _mm_sub_ps(a, b); }
+static inline sf_rv_f4 f4_mul(sf_rv_f4 a, sf_rv_f4 b){ return _mm_mul_ps(a, b); }
+static inline void f4_store(float *p, sf_rv_f4 v){ _mm_storeu_ps(p, v); }
+
+// lanes 0 and 1 from a's lanes 2 and 3, lanes 2 and 3 from the pair at p
+static inline sf_rv_f4 f4_shiftin(sf_rv_f4 a, const sf_sample_st *p){
+	return _mm_loadh_pi(_mm_movehl_ps(a, a), (const __m64 *)p);
+}
+static inline void f4_storelo(sf_sample_st *p, sf_rv_f4 v){ _mm_storel_pi((__m64 *)p, v); }
+
+// { p[0], p[0], p[1], p[1] }
+static inline sf_rv_f4 f4_spread(const float *p){
+	__m128 v = _mm_castpd_ps(_mm_load_sd((const double *)p));
+	return _mm_unpacklo_ps(v, v);
+}
+
+// L/R pairs, in lanes 0 and 1
+static inline sf_rv_f4 f4_pair(float L, float R){
+	return _mm_unpacklo_ps(_mm_set_ss(L), _mm_set_ss(R));
+}
+static inline sf_rv_f4 f4_loadpair(const sf_sample_st *p){
+	return _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+}
+static inline sf_rv_f4 f4_swap(sf_rv_f4 v){ return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 0, 1)); }
+static inline sf_rv_f4 f4_neg(sf_rv_f4 v){ return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+static inline float f4_L(sf_rv_f4 v){ return _mm_cvtss_f32(v); }
+static inline float f4_R(sf_rv_f4 v){
+	return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+static inline sf_rv_i4 i4_set(int a, int b, int c, int d){ return _mm_setr_epi32(a, b, c, d); }
+static inline sf_rv_i4 i4_dup(int v){ return _mm_set1_epi32(v); }
+static inline sf_rv_i4 i4_sub(sf_rv_i4 a, sf_rv_i4 b){ return _mm_sub_epi32(a, b); }
+static inline void i4_store(int *p, sf_rv_i4 v){ _mm_storeu_si128((__m128i *)p, v); }
+static inline sf_rv_f4 i4_tof4(sf_rv_i4 v){ return _mm_cvtepi32_ps(v); }
+
+// floori on every lane
+static inline sf_rv_i4 f4_floori(sf_rv_f4 v){
+	__m128i i = _mm_cvttps_epi32(v);
+	return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), v)));
+}
+
+// add size to the lanes that went below 0
+static inline sf_rv_i4 i4_wrapneg(sf_rv_i4 pos, sf_rv_i4 size){
+	return _mm_add_epi32(pos, _mm_and_si128(_mm_cmpgt_epi32(_mm_setzero_si128(), pos), size));
+}
+
+// wrapinc on every lane
+static inline sf_rv_i4 i4_wrapinc(sf_rv_i4 pos, sf_rv_i4 size){
+	pos = _mm_sub_epi32(pos, _mm_set1_epi32(-1));
+	return _mm_andnot_si128(_mm_cmpeq_epi32(pos, size), pos);
+}
+#else
+typedef float32x4_t sf_rv_f4;
+typedef int32x4_t   sf_rv_i4;
+
+static inline sf_rv_f4 f4_set(float a, float b, float c, float d){
+	float v[4] = { a, b, c, d };
+	return vld1q_f32(v);
+}
+static inline sf_rv_f4 f4_dup(float v){ return vdupq_n_f32(v); }
+static inline sf_rv_f4 f4_add(sf_rv_f4 a, sf_rv_f4 b){ return vaddq_f32(a, b); }
+static inline sf_rv_f4 f4_sub(sf_rv_f4 a, sf_rv_f4 b){ return vsubq_f32(a, b); }
+static inline sf_rv_f4 f4_mul(sf_rv_f4 a, sf_rv_f4 b){ return vmulq_f32(a, b); }
+static inline void f4_store(float *p, sf_rv_f4 v){ vst1q_f32(p, v); }
+
+static inline sf_rv_f4 f4_shiftin(sf_rv_f4 a, const sf_sample_st *p){
+	return vcombine_f32(vget_high_f32(a), vld1_f32(&p->L));
+}
+static inline void f4_storelo(sf_sample_st *p, sf_rv_f4 v){ vst1_f32(&p->L, vget_low_f32(v)); }
+
+static inline sf_rv_f4 f4_spread(const float *p){
+	float32x2x2_t v = vzip_f32(vld1_f32(p), vld1_f32(p));
+	return vcombine_f32(v.val[0], v.val[1]);
+}
+
+static inline sf_rv_f4 f4_pair(float L, float R){ return f4_set(L, R, 0, 0); }
+static inline sf_rv_f4 f4_loadpair(const sf_sample_st *p){
+	return vcombine_f32(vld1_f32(&p->L), vdup_n_f32(0));
+}
+static inline sf_rv_f4 f4_swap(sf_rv_f4 v){
+	return vcombine_f32(vrev64_f32(vget_low_f32(v)), vget_high_f32(v));
+}
+static inline sf_rv_f4 f4_neg(sf_rv_f4 v){ return vnegq_f32(v); }
+static inline float f4_L(sf_rv_f4 v){ return vgetq_lane_f32(v, 0); }
+static inline float f4_R(sf_rv_f4 v){ return vgetq_lane_f32(v, 1); }
+
+static inline sf_rv_i4 i4_set(int a, int b, int c, int d){
+	int32_t v[4] = { a, b, c, d };
+	return vld1q_s32(v);
+}
+static inline sf_rv_i4 i4_dup(int v){ return vdupq_n_s32(v); }
+static inline sf_rv_i4 i4_sub(sf_rv_i4 a, sf_rv_i4 b){ return vsubq_s32(a, b); }
+static inline void i4_store(int *p, sf_rv_i4 v){ vst1q_s32((int32_t *)p, v); }
+static inline sf_rv_f4 i4_tof4(sf_rv_i4 v){ return vcvtq_f32_s32(v); }
+
+static inline sf_rv_i4 f4_floori(sf_rv_f4 v){
+	int32x4_t i = vcvtq_s32_f32(v);
+	return vaddq_s32(i, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(i), v)));
+}
+
+static inline sf_rv_i4 i4_wrapneg(sf_rv_i4 pos, sf_rv_i4 size){
+	return vaddq_s32(pos, vandq_s32(vreinterpretq_s32_u32(vcltq_s32(pos, vdupq_n_s32(0))), size));
+}
+
+static inline sf_rv_i4 i4_wrapinc(sf_rv_i4 pos, sf_rv_i4 size){
+	pos = vaddq_s32(pos, vdupq_n_s32(1));
+	return vbicq_s32(pos, vreinterpretq_s32_u32(vceqq_s32(pos, size)));
+}
+#endif
+#endif // ROGOSYNTH_SSE || ROGOSYNTH_NEON
+
 static bool isprime(int v){
 	if (v < 0)
 		return isprime(-v);
@@ -65,6 +211,9 @@ static inline float randfloat(){
 
 // components are in the basic format of `<component>_make` to initialize a structure and
 // `<component>_step` to perform a single step with the component
+//
+// `<component>_make` only decides how long the delay lines are; the buffers themselves are handed
+// out (and cleared) afterwards by arena_layout, once the size of every line is known
 
 //
 // delay
@@ -72,13 +221,12 @@ static inline float randfloat(){
 static inline void delay_make(sf_rv_delay_st *delay, int size){
 	delay->pos = 0;
 	delay->size = clampi(size, 1, SF_REVERB_DS);
-	memset(delay->buf, 0, sizeof(float) * delay->size);
 }
 
 static inline float delay_step(sf_rv_delay_st *delay, float v){
 	float out = delay->buf[delay->pos];
 	delay->buf[delay->pos] = v;
-	delay->pos = (delay->pos + 1) % delay->size;
+	delay->pos = wrapinc(delay->pos, delay->size);
 	return out;
 }
 
@@ -243,21 +391,22 @@ static inline void earlyref_make(sf_rv_earlyref_st *earlyref, int rate, float fa
 	earlyref->hpfR = earlyref->hpfL;
 }
 
-static inline sf_sample_st earlyref_step(sf_rv_earlyref_st *earlyref, sf_sample_st input){
-	static const sf_sample_st gaintbl[18] = {
-		{ 0.841f, 0.842f }, { 0.504f, 0.506f }, { 0.491f, 0.489f }, { 0.379f, 0.382f },
-		{ 0.380f, 0.300f }, { 0.346f, 0.346f }, { 0.289f, 0.290f }, { 0.272f, 0.271f },
-		{ 0.192f, 0.193f }, { 0.193f, 0.192f }, { 0.217f, 0.217f }, { 0.181f, 0.195f },
-		{ 0.180f, 0.192f }, { 0.181f, 0.166f }, { 0.176f, 0.186f }, { 0.142f, 0.131f },
-		{ 0.167f, 0.168f }, { 0.134f, 0.133f }
-	};
+// gain of each early reflection tap
+static const sf_sample_st earlyref_gaintbl[18] = {
+	{ 0.841f, 0.842f }, { 0.504f, 0.506f }, { 0.491f, 0.489f }, { 0.379f, 0.382f },
+	{ 0.380f, 0.300f }, { 0.346f, 0.346f }, { 0.289f, 0.290f }, { 0.272f, 0.271f },
+	{ 0.192f, 0.193f }, { 0.193f, 0.192f }, { 0.217f, 0.217f }, { 0.181f, 0.195f },
+	{ 0.180f, 0.192f }, { 0.181f, 0.166f }, { 0.176f, 0.186f }, { 0.142f, 0.131f },
+	{ 0.167f, 0.168f }, { 0.134f, 0.133f }
+};
 
+static inline sf_sample_st earlyref_step(sf_rv_earlyref_st *earlyref, sf_sample_st input){
 	float wetL = 0, wetR = 0;
 	delay_step(&earlyref->delayPWL, input.L);
 	delay_step(&earlyref->delayPWR, input.R);
 	for (int i = 0; i < 18; i++){
-		wetL += gaintbl[i].L * delay_get(&earlyref->delayPWL, earlyref->delaytblL[i]);
-		wetR += gaintbl[i].R * delay_get(&earlyref->delayPWR, earlyref->delaytblR[i]);
+		wetL += earlyref_gaintbl[i].L * delay_get(&earlyref->delayPWL, earlyref->delaytblL[i]);
+		wetR += earlyref_gaintbl[i].R * delay_get(&earlyref->delayPWR, earlyref->delaytblR[i]);
 	}
 
 	float L = delay_step(&earlyref->delayRL, input.R + wetR);
@@ -329,34 +478,49 @@ static inline float dccut_step(sf_rv_dccut_st *dccut, float v){
 //
 // noise
 //
+// the noise is generated once into a table shared (read-only) by every reverb state, instead of
+// each state regenerating its own buffer from inside sf_reverb_process whenever it runs out
+//
+// the fractal generator pins both ends of the buffer to 0, so reading it in a loop is seamless
+static float noise_table[SF_REVERB_NS];
+static bool noise_ready = false;
+
+static void noise_generate(){
+	int len = SF_REVERB_NS;
+	int tot = 1;
+	float r = 0.8f;
+	float rmul = 0.7071067811865475f; // 1/sqrt(2)
+	noise_table[0] = 0;
+	while (len > 1){
+		float left = 0;
+		for (int i = tot - 1; i >= 0; i--){
+			float right = left;
+			left = noise_table[i * len];
+			float midpoint = (left + right) * 0.5f;
+			float newv = midpoint + r * (2.0f * randfloat() - 1.0f); // displace by random amt
+			noise_table[i * len + (len / 2)] = clampf(newv, -1.0f, 1.0f);
+		}
+		len /= 2;
+		tot *= 2;
+		r *= rmul;
+	}
+}
+
 static inline void noise_make(sf_rv_noise_st *noise){
-	noise->pos = SF_REVERB_NS;
+	if (!noise_ready){
+		noise_generate();
+		noise_ready = true;
+	}
+	// move the state's own read offset on each time it's populated, so states rebuilt on other
+	// threads share nothing but the table, and a state doesn't modulate in lockstep with the one
+	// it replaces
+	noise->pos = (noise->pos + SF_REVERB_NSTEP) & (SF_REVERB_NS - 1);
 }
 
 static inline float noise_step(sf_rv_noise_st *noise){
-	if (noise->pos >= SF_REVERB_NS){
-		// need to generate more noise
-		noise->pos = 0;
-		int len = SF_REVERB_NS;
-		int tot = 1;
-		float r = 0.8f;
-		float rmul = 0.7071067811865475f; // 1/sqrt(2)
-		noise->buf[0] = 0;
-		while (len > 1){
-			float left = 0;
-			for (int i = tot - 1; i >= 0; i--){
-				float right = left;
-				left = noise->buf[i * len];
-				float midpoint = (left + right) * 0.5f;
-				float newv = midpoint + r * (2.0f * randfloat() - 1.0f); // displace by random amt
-				noise->buf[i * len + (len / 2)] = clampf(newv, -1.0f, 1.0f);
-			}
-			len /= 2;
-			tot *= 2;
-			r *= rmul;
-		}
-	}
-	return noise->buf[noise->pos++];
+	float out = noise_table[noise->pos];
+	noise->pos = (noise->pos + 1) & (SF_REVERB_NS - 1);
+	return out;
 }
 
 //
@@ -396,14 +560,13 @@ static inline void allpass_make(sf_rv_allpass_st *allpass, int size, float feedb
 	allpass->size = clampi(size, 1, SF_REVERB_APS);
 	allpass->feedback = feedback;
 	allpass->decay = decay;
-	memset(allpass->buf, 0, sizeof(float) * allpass->size);
 }
 
 static inline float allpass_step(sf_rv_allpass_st *allpass, float v){
 	v += allpass->feedback * allpass->buf[allpass->pos];
 	float out = allpass->decay * allpass->buf[allpass->pos] - allpass->feedback * v;
 	allpass->buf[allpass->pos] = v;
-	allpass->pos = (allpass->pos + 1) % allpass->size;
+	allpass->pos = wrapinc(allpass->pos, allpass->size);
 	return out;
 }
 
@@ -420,8 +583,6 @@ static inline void allpass2_make(sf_rv_allpass2_st *allpass2, int size1, int siz
 	allpass2->feedback2 = feedback2;
 	allpass2->decay1 = decay1;
 	allpass2->decay2 = decay2;
-	memset(allpass2->buf1, 0, sizeof(float) * allpass2->size1);
-	memset(allpass2->buf2, 0, sizeof(float) * allpass2->size2);
 }
 
 static inline float allpass2_step(sf_rv_allpass2_st *allpass2, float v){
@@ -431,8 +592,8 @@ static inline float allpass2_step(sf_rv_allpass2_st *allpass2, float v){
 	allpass2->buf2[allpass2->pos2] = allpass2->decay1 * allpass2->buf1[allpass2->pos1] -
 		v * allpass2->feedback1;
 	allpass2->buf1[allpass2->pos1] = v;
-	allpass2->pos1 = (allpass2->pos1 + 1) % allpass2->size1;
-	allpass2->pos2 = (allpass2->pos2 + 1) % allpass2->size2;
+	allpass2->pos1 = wrapinc(allpass2->pos1, allpass2->size1);
+	allpass2->pos2 = wrapinc(allpass2->pos2, allpass2->size2);
 	return out;
 }
 
@@ -483,16 +644,13 @@ static inline void allpass3_make(sf_rv_allpass3_st *allpass3, int size1, int msi
 	allpass3->decay1 = decay1;
 	allpass3->decay2 = decay2;
 	allpass3->decay3 = decay3;
-	memset(allpass3->buf1, 0, sizeof(float) * allpass3->size1);
-	memset(allpass3->buf2, 0, sizeof(float) * allpass3->size2);
-	memset(allpass3->buf3, 0, sizeof(float) * allpass3->size3);
 }
 
 static inline float allpass3_step(sf_rv_allpass3_st *allpass3, float v, float mod){
 	mod = (mod + 1.0f) * (float)allpass3->msize1;
-	float floormod = floorf(mod);
-	float mfrac = mod - floormod;
-	int rpos1 = allpass3->rpos1 - (int)floormod;
+	int floormod = floori(mod);
+	float mfrac = mod - (float)floormod;
+	int rpos1 = allpass3->rpos1 - floormod;
 	if (rpos1 < 0)
 		rpos1 += allpass3->size1;
 	int rpos2 = rpos1 - 1;
@@ -507,10 +665,10 @@ static inline float allpass3_step(sf_rv_allpass3_st *allpass3, float v, float mo
 	v += allpass3->feedback1 * tmp;
 	allpass3->buf2[allpass3->pos2] = allpass3->decay1 * tmp - allpass3->feedback1 * v;
 	allpass3->buf1[allpass3->wpos1] = v;
-	allpass3->wpos1 = (allpass3->wpos1 + 1) % allpass3->size1;
-	allpass3->rpos1 = (allpass3->rpos1 + 1) % allpass3->size1;
-	allpass3->pos2 = (allpass3->pos2 + 1) % allpass3->size2;
-	allpass3->pos3 = (allpass3->pos3 + 1) % allpass3->size3;
+	allpass3->wpos1 = wrapinc(allpass3->wpos1, allpass3->size1);
+	allpass3->rpos1 = wrapinc(allpass3->rpos1, allpass3->size1);
+	allpass3->pos2 = wrapinc(allpass3->pos2, allpass3->size2);
+	allpass3->pos3 = wrapinc(allpass3->pos3, allpass3->size3);
 	return out;
 }
 
@@ -564,25 +722,24 @@ static inline void allpassm_make(sf_rv_allpassm_st *allpassm, int size, int msiz
 	allpassm->feedback = feedback;
 	allpassm->decay = decay;
 	allpassm->z1 = 0;
-	memset(allpassm->buf, 0, sizeof(float) * allpassm->size);
 }
 
 static inline float allpassm_step(sf_rv_allpassm_st *allpassm, float v, float mod, float fbmod){
 	float mfeedback = allpassm->feedback + fbmod;
 	mod = (mod + 1.0f) * (float)allpassm->msize;
-	float floormod = floorf(mod);
-	float mfrac = 1.0f - mod + floormod;
-	int rpos1 = allpassm->rpos - (int)floormod;
+	int floormod = floori(mod);
+	float mfrac = 1.0f - mod + (float)floormod;
+	int rpos1 = allpassm->rpos - floormod;
 	if (rpos1 < 0)
 		rpos1 += allpassm->size;
 	int rpos2 = rpos1 - 1;
 	if (rpos2 < 0)
 		rpos2 += allpassm->size;
 	allpassm->z1 = allpassm->buf[rpos2] + mfrac * (allpassm->buf[rpos1] - allpassm->z1);
-	allpassm->rpos = (allpassm->rpos + 1) % allpassm->size;
+	allpassm->rpos = wrapinc(allpassm->rpos, allpassm->size);
 	allpassm->buf[allpassm->wpos] = v + allpassm->z1 * mfeedback;
 	v = allpassm->decay * allpassm->z1 - allpassm->buf[allpassm->wpos] * mfeedback;
-	allpassm->wpos = (allpassm->wpos + 1) % allpassm->size;
+	allpassm->wpos = wrapinc(allpassm->wpos, allpassm->size);
 	return v;
 }
 
@@ -592,16 +749,140 @@ static inline float allpassm_step(sf_rv_allpassm_st *allpassm, float v, float mo
 static inline void comb_make(sf_rv_comb_st *comb, int size){
 	comb->pos = 0;
 	comb->size = clampi(size, 1, SF_REVERB_CS);
-	memset(comb->buf, 0, sizeof(float) * comb->size);
 }
 
 static inline float comb_step(sf_rv_comb_st *comb, float v, float feedback){
 	v = comb->buf[comb->pos] * feedback + v;
 	comb->buf[comb->pos] = v;
-	comb->pos = (comb->pos + 1) % comb->size;
+	comb->pos = wrapinc(comb->pos, comb->size);
 	return v;
 }
 
+//
+//
+// arena
+//
+//
+
+// every delay line is padded out to a whole number of cache lines, so that the start of each line
+// is 64-byte aligned and two lines never share a cache line
+#define SF_REVERB_ALIGN     16 // floats per cache line
+
+static inline int arena_pad(int size){
+	return (size + SF_REVERB_ALIGN - 1) & ~(SF_REVERB_ALIGN - 1);
+}
+
+typedef struct {
+	float **buf; // where to store the pointer into the arena
+	int size;    // number of floats the line needs
+} sf_rv_line_st;
+
+// number of delay lines listed by arena_lines
+#define SF_REVERB_LINES     62
+
+// list every delay line in the order sf_reverb_process touches them, so the lines that are used
+// together sit next to each other in memory; L/R pairs are kept adjacent for the same reason
+static int arena_lines(sf_reverb_state_st *rv, sf_rv_line_st *lines){
+	int n = 0;
+	#define LINE(b, s) do{ lines[n].buf = &(b); lines[n].size = (s); n++; }while(0)
+
+	// early reflection runs once per input sample
+	LINE(rv->earlyref.delayPWL.buf, rv->earlyref.delayPWL.size);
+	LINE(rv->earlyref.delayPWR.buf, rv->earlyref.delayPWR.size);
+	LINE(rv->earlyref.delayRL.buf , rv->earlyref.delayRL.size );
+	LINE(rv->earlyref.delayLR.buf , rv->earlyref.delayLR.size );
+
+	// everything else runs once per oversampled sample
+	for (int i = 0; i < 10; i++){
+		LINE(rv->diffL[i].buf, rv->diffL[i].size);
+		LINE(rv->diffR[i].buf, rv->diffR[i].size);
+	}
+	for (int i = 0; i < 4; i++){
+		LINE(rv->crossL[i].buf, rv->crossL[i].size);
+		LINE(rv->crossR[i].buf, rv->crossR[i].size);
+	}
+	LINE(rv->cdelayL.buf   , rv->cdelayL.size    );
+	LINE(rv->cdelayR.buf   , rv->cdelayR.size    );
+	LINE(rv->dampap1L.buf  , rv->dampap1L.size   );
+	LINE(rv->dampap1R.buf  , rv->dampap1R.size   );
+	LINE(rv->dampdL.buf    , rv->dampdL.size     );
+	LINE(rv->dampdR.buf    , rv->dampdR.size     );
+	LINE(rv->dampap2L.buf  , rv->dampap2L.size   );
+	LINE(rv->dampap2R.buf  , rv->dampap2R.size   );
+	LINE(rv->cbassd1L.buf  , rv->cbassd1L.size   );
+	LINE(rv->cbassd1R.buf  , rv->cbassd1R.size   );
+	LINE(rv->cbassap1L.buf1, rv->cbassap1L.size1 );
+	LINE(rv->cbassap1L.buf2, rv->cbassap1L.size2 );
+	LINE(rv->cbassap1R.buf1, rv->cbassap1R.size1 );
+	LINE(rv->cbassap1R.buf2, rv->cbassap1R.size2 );
+	LINE(rv->cbassd2L.buf  , rv->cbassd2L.size   );
+	LINE(rv->cbassd2R.buf  , rv->cbassd2R.size   );
+	LINE(rv->cbassap2L.buf1, rv->cbassap2L.size1 );
+	LINE(rv->cbassap2L.buf2, rv->cbassap2L.size2 );
+	LINE(rv->cbassap2L.buf3, rv->cbassap2L.size3 );
+	LINE(rv->cbassap2R.buf1, rv->cbassap2R.size1 );
+	LINE(rv->cbassap2R.buf2, rv->cbassap2R.size2 );
+	LINE(rv->cbassap2R.buf3, rv->cbassap2R.size3 );
+	LINE(rv->combL.buf     , rv->combL.size      );
+	LINE(rv->combR.buf     , rv->combR.size      );
+	LINE(rv->lastdelayL.buf, rv->lastdelayL.size );
+	LINE(rv->lastdelayR.buf, rv->lastdelayR.size );
+	LINE(rv->inpdelayL.buf , rv->inpdelayL.size  );
+	LINE(rv->inpdelayR.buf , rv->inpdelayR.size  );
+
+	#undef LINE
+	return n;
+}
+
+// point every delay line into the arena and clear them, growing the arena first if the current
+// sizes don't fit
+static bool arena_layout(sf_reverb_state_st *rv){
+	sf_rv_line_st lines[SF_REVERB_LINES];
+	int n = arena_lines(rv, lines);
+
+	int total = 0;
+	for (int i = 0; i < n; i++)
+		total += arena_pad(lines[i].size);
+
+	if (!sf_reverb_reserve(rv, total))
+		return false;
+
+	float *buf = rv->arena;
+	for (int i = 0; i < n; i++){
+		*lines[i].buf = buf;
+		buf += arena_pad(lines[i].size);
+	}
+	memset(rv->arena, 0, sizeof(float) * total);
+	return true;
+}
+
+bool sf_reverb_reserve(sf_reverb_state_st *rv, int floats){
+	if (floats <= rv->arenasize)
+		return true;
+	sf_reverb_free(rv);
+	// over-allocate by a cache line so the start can be aligned by hand
+	void *mem = sf_malloc(sf_reverb_reservebytes(floats));
+	if (mem == NULL)
+		return false;
+	uintptr_t align = sizeof(float) * SF_REVERB_ALIGN;
+	rv->arenamem = mem;
+	rv->arena = (float *)(((uintptr_t)mem + align - 1) & ~(align - 1));
+	rv->arenasize = floats;
+	return true;
+}
+
+size_t sf_reverb_reservebytes(int floats){
+	return sizeof(float) * (floats + SF_REVERB_ALIGN);
+}
+
+void sf_reverb_free(sf_reverb_state_st *rv){
+	if (rv->arenamem != NULL)
+		sf_free(rv->arenamem);
+	rv->arenamem = NULL;
+	rv->arena = NULL;
+	rv->arenasize = 0;
+}
+
 //
 //
 // reverb implementation
@@ -610,11 +891,9 @@ static inline float comb_step(sf_rv_comb_st *comb, float v, float feedback){
 
 // now that all the components are done (thank god), we can start on the actual reverb effect
 
-void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
+bool sf_reverb_presetparams(sf_reverb_preset preset, sf_reverb_params_st *params){
 	// sorry for the bad formatting, I've tried to cram this in as best as I could
-	struct {
-		int osf; float p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16;
-	} ps[] = {
+	static const sf_reverb_params_st ps[] = {
 
 //OSF ERtoLt ERWet Dry ERFac ERWdth Wdth Wet Wander BassB Spin InpLP BasLP DmpLP OutLP RT60  Delay
 {1, 0.40f, -9.0f,-10, 1.6f, 0.7f, 1.0f, -0, 0.27f, 0.15f, 0.7f,17000, 500, 7000,10000, 3.2f,0.020f},
@@ -639,10 +918,7 @@ void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
 
 	};
 
-	#define CASE(prs, i)                                                                        \
-		case prs: sf_advancereverb(rv, rate, ps[i].osf, ps[i].p1, ps[i].p2, ps[i].p3, ps[i].p4, \
-			ps[i].p5, ps[i].p6, ps[i].p7, ps[i].p8, ps[i].p9, ps[i].p10, ps[i].p11, ps[i].p12,  \
-			ps[i].p13, ps[i].p14, ps[i].p15, ps[i].p16); return;
+	#define CASE(prs, i)  case prs: *params = ps[i]; return true;
 	switch (preset){
 		CASE(SF_REVERB_PRESET_DEFAULT    ,  0)
 		CASE(SF_REVERB_PRESET_SMALLHALL1 ,  1)
@@ -665,9 +941,19 @@ void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
 		CASE(SF_REVERB_PRESET_LONGREVERB2, 18)
 	}
 	#undef CASE
+	return false;
 }
 
-void sf_advancereverb(sf_reverb_state_st *rv, int rate,
+bool sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
+	sf_reverb_params_st p;
+	if (!sf_reverb_presetparams(preset, &p))
+		return false;
+	return sf_advancereverb(rv, rate, p.oversamplefactor, p.ertolate, p.erefwet, p.dry,
+		p.ereffactor, p.erefwidth, p.width, p.wet, p.wander, p.bassb, p.spin, p.inputlpf, p.basslpf,
+		p.damplpf, p.outputlpf, p.rt60, p.delay);
+}
+
+bool sf_advancereverb(sf_reverb_state_st *rv, int rate,
 	int oversamplefactor, float ertolate, float erefwet, float dry, float ereffactor,
 	float erefwidth, float width, float wet, float wander, float bassb, float spin, float inputlpf,
 	float basslpf, float damplpf, float outputlpf, float rt60, float delay){
@@ -771,7 +1057,7 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 		rv->outco[i] = outco[i] * totfactor;
 
 	comb_make(&rv->combL, nextprime(22 * osrate / 1000));
-	rv->combR = rv->combL;
+	comb_make(&rv->combR, rv->combL.size);
 
 	biquad_makeLPF(&rv->lastlpfL, osrate, outputlpf, 1.0f);
 	rv->lastlpfR = rv->lastlpfL;
@@ -789,151 +1075,888 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 		delay_make(&rv->lastdelayL, 0);
 		delay_make(&rv->lastdelayR, 0);
 	}
+
+	return arena_layout(rv);
 }
 
-void sf_reverb_process(sf_reverb_state_st *rv, int size, sf_sample_st *input, sf_sample_st *output){
+//
+//
+// lane components
+//
+//
+
+// the same components with their L/R pair (or, for allpassm, up to four filters) in the lanes of a
+// vector; the block loads a stage's state into one of these, runs it, and saves it back
+#if defined(SF_REVERB_LANES)
+
+//
+// delay
+//
+// one of the lines read by the output taps, as the delay line or the allpass line it is
+typedef struct {
+	int pos;
+	int size;
+	const float *buf;
+} sf_rv_tapline_st;
+
+// delay_get for an offset already clamped to [1, size]
+static inline float line_tap(sf_rv_tapline_st line, int offset){
+	int rp = line.pos - offset;
+	if (rp < 0)
+		rp += line.size;
+	return line.buf[rp];
+}
+
+static inline sf_rv_tapline_st delay_tapline(const sf_rv_delay_st *delay){
+	return (sf_rv_tapline_st){ delay->pos, delay->size, delay->buf };
+}
+
+static inline sf_rv_f4 delayx2_step(sf_rv_delay_st *L, sf_rv_delay_st *R, sf_rv_f4 v){
+	sf_rv_f4 out = f4_pair(L->buf[L->pos], R->buf[R->pos]);
+	L->buf[L->pos] = f4_L(v);
+	R->buf[R->pos] = f4_R(v);
+	L->pos = wrapinc(L->pos, L->size);
+	R->pos = wrapinc(R->pos, R->size);
+	return out;
+}
+
+//
+// iir1
+//
+typedef struct {
+	sf_rv_f4 a2, b1, b2, y1;
+} sf_rv_iir1x2_st;
+
+static inline void iir1x2_load(sf_rv_iir1x2_st *x2, const sf_rv_iir1_st *L, const sf_rv_iir1_st *R){
+	x2->a2 = f4_pair(L->a2, R->a2);
+	x2->b1 = f4_pair(L->b1, R->b1);
+	x2->b2 = f4_pair(L->b2, R->b2);
+	x2->y1 = f4_pair(L->y1, R->y1);
+}
+
+static inline void iir1x2_save(const sf_rv_iir1x2_st *x2, sf_rv_iir1_st *L, sf_rv_iir1_st *R){
+	L->y1 = f4_L(x2->y1); R->y1 = f4_R(x2->y1);
+}
+
+static inline sf_rv_f4 iir1x2_step(sf_rv_iir1x2_st *x2, sf_rv_f4 v){
+	sf_rv_f4 out = f4_add(f4_mul(v, x2->b1), x2->y1);
+	x2->y1 = f4_add(f4_mul(out, x2->a2), f4_mul(v, x2->b2));
+	return out;
+}
+
+//
+// biquad
+//
+typedef struct {
+	sf_rv_f4 b0, b1, b2, a1, a2;
+	sf_rv_f4 xn1, xn2, yn1, yn2;
+} sf_rv_biquadx2_st;
+
+static inline void biquadx2_load(sf_rv_biquadx2_st *x2, const sf_rv_biquad_st *L,
+	const sf_rv_biquad_st *R){
+	x2->b0  = f4_pair(L->b0 , R->b0 );
+	x2->b1  = f4_pair(L->b1 , R->b1 );
+	x2->b2  = f4_pair(L->b2 , R->b2 );
+	x2->a1  = f4_pair(L->a1 , R->a1 );
+	x2->a2  = f4_pair(L->a2 , R->a2 );
+	x2->xn1 = f4_pair(L->xn1, R->xn1);
+	x2->xn2 = f4_pair(L->xn2, R->xn2);
+	x2->yn1 = f4_pair(L->yn1, R->yn1);
+	x2->yn2 = f4_pair(L->yn2, R->yn2);
+}
+
+static inline void biquadx2_save(const sf_rv_biquadx2_st *x2, sf_rv_biquad_st *L,
+	sf_rv_biquad_st *R){
+	L->xn1 = f4_L(x2->xn1); R->xn1 = f4_R(x2->xn1);
+	L->xn2 = f4_L(x2->xn2); R->xn2 = f4_R(x2->xn2);
+	L->yn1 = f4_L(x2->yn1); R->yn1 = f4_R(x2->yn1);
+	L->yn2 = f4_L(x2->yn2); R->yn2 = f4_R(x2->yn2);
+}
+
+static inline sf_rv_f4 biquadx2_step(sf_rv_biquadx2_st *x2, sf_rv_f4 v){
+	sf_rv_f4 out = f4_add(f4_mul(v, x2->b0), f4_mul(x2->xn1, x2->b1));
+	out = f4_add(out, f4_mul(x2->xn2, x2->b2));
+	out = f4_sub(out, f4_mul(x2->yn1, x2->a1));
+	out = f4_sub(out, f4_mul(x2->yn2, x2->a2));
+	x2->xn2 = x2->xn1;
+	x2->xn1 = v;
+	x2->yn2 = x2->yn1;
+	x2->yn1 = out;
+	return out;
+}
+
+//
+// dccut
+//
+typedef struct {
+	sf_rv_f4 gain, y1, y2;
+} sf_rv_dccutx2_st;
+
+static inline void dccutx2_load(sf_rv_dccutx2_st *x2, const sf_rv_dccut_st *L,
+	const sf_rv_dccut_st *R){
+	x2->gain = f4_pair(L->gain, R->gain);
+	x2->y1   = f4_pair(L->y1  , R->y1  );
+	x2->y2   = f4_pair(L->y2  , R->y2  );
+}
+
+static inline void dccutx2_save(const sf_rv_dccutx2_st *x2, sf_rv_dccut_st *L, sf_rv_dccut_st *R){
+	L->y1 = f4_L(x2->y1); R->y1 = f4_R(x2->y1);
+	L->y2 = f4_L(x2->y2); R->y2 = f4_R(x2->y2);
+}
+
+static inline sf_rv_f4 dccutx2_step(sf_rv_dccutx2_st *x2, sf_rv_f4 v){
+	sf_rv_f4 out = f4_add(f4_sub(v, x2->y1), f4_mul(x2->gain, x2->y2));
+	x2->y1 = v;
+	x2->y2 = out;
+	return out;
+}
+
+//
+// allpass
+//
+static inline sf_rv_f4 allpassx2_step(sf_rv_allpass_st *L, sf_rv_allpass_st *R,
+	sf_rv_f4 feedback, sf_rv_f4 decay, sf_rv_f4 v){
+	sf_rv_f4 buf = f4_pair(L->buf[L->pos], R->buf[R->pos]);
+	v = f4_add(v, f4_mul(feedback, buf));
+	sf_rv_f4 out = f4_sub(f4_mul(decay, buf), f4_mul(feedback, v));
+	L->buf[L->pos] = f4_L(v);
+	R->buf[R->pos] = f4_R(v);
+	L->pos = wrapinc(L->pos, L->size);
+	R->pos = wrapinc(R->pos, R->size);
+	return out;
+}
+
+//
+// allpass2
+//
+typedef struct {
+	sf_rv_allpass2_st L, R; // positions and buffers
+	sf_rv_f4 feedback1, feedback2;
+	sf_rv_f4 decay1, decay2;
+} sf_rv_allpass2x2_st;
+
+static inline void allpass2x2_load(sf_rv_allpass2x2_st *x2, const sf_rv_allpass2_st *L,
+	const sf_rv_allpass2_st *R){
+	x2->L = *L;
+	x2->R = *R;
+	x2->feedback1 = f4_pair(L->feedback1, R->feedback1);
+	x2->feedback2 = f4_pair(L->feedback2, R->feedback2);
+	x2->decay1    = f4_pair(L->decay1   , R->decay1   );
+	x2->decay2    = f4_pair(L->decay2   , R->decay2   );
+}
+
+static inline sf_rv_f4 allpass2x2_step(sf_rv_allpass2x2_st *x2, sf_rv_f4 v){
+	sf_rv_allpass2_st *L = &x2->L, *R = &x2->R;
+	sf_rv_f4 buf1 = f4_pair(L->buf1[L->pos1], R->buf1[R->pos1]);
+	sf_rv_f4 buf2 = f4_pair(L->buf2[L->pos2], R->buf2[R->pos2]);
+	v = f4_add(v, f4_mul(x2->feedback2, buf2));
+	sf_rv_f4 out = f4_sub(f4_mul(x2->decay2, buf2), f4_mul(v, x2->feedback2));
+	v = f4_add(v, f4_mul(x2->feedback1, buf1));
+	buf2 = f4_sub(f4_mul(x2->decay1, buf1), f4_mul(v, x2->feedback1));
+	L->buf2[L->pos2] = f4_L(buf2); R->buf2[R->pos2] = f4_R(buf2);
+	L->buf1[L->pos1] = f4_L(v)   ; R->buf1[R->pos1] = f4_R(v)   ;
+	L->pos1 = wrapinc(L->pos1, L->size1); R->pos1 = wrapinc(R->pos1, R->size1);
+	L->pos2 = wrapinc(L->pos2, L->size2); R->pos2 = wrapinc(R->pos2, R->size2);
+	return out;
+}
+
+//
+// allpass3
+//
+typedef struct {
+	sf_rv_allpass3_st L, R; // positions and buffers
+	sf_rv_f4 msize1;
+	sf_rv_f4 feedback1, feedback2, feedback3;
+	sf_rv_f4 decay1, decay2, decay3;
+} sf_rv_allpass3x2_st;
+
+static inline void allpass3x2_load(sf_rv_allpass3x2_st *x2, const sf_rv_allpass3_st *L,
+	const sf_rv_allpass3_st *R){
+	x2->L = *L;
+	x2->R = *R;
+	x2->msize1    = f4_pair((float)L->msize1, (float)R->msize1);
+	x2->feedback1 = f4_pair(L->feedback1, R->feedback1);
+	x2->feedback2 = f4_pair(L->feedback2, R->feedback2);
+	x2->feedback3 = f4_pair(L->feedback3, R->feedback3);
+	x2->decay1    = f4_pair(L->decay1   , R->decay1   );
+	x2->decay2    = f4_pair(L->decay2   , R->decay2   );
+	x2->decay3    = f4_pair(L->decay3   , R->decay3   );
+}
+
+static inline sf_rv_f4 allpass3x2_step(sf_rv_allpass3x2_st *x2, sf_rv_f4 v, sf_rv_f4 mod){
+	sf_rv_allpass3_st *L = &x2->L, *R = &x2->R;
+	mod = f4_mul(f4_add(mod, f4_dup(1.0f)), x2->msize1);
+	sf_rv_i4 floormod = f4_floori(mod);
+	sf_rv_f4 mfrac = f4_sub(mod, i4_tof4(floormod));
+	int fm[4];
+	i4_store(fm, floormod);
+	int rpos1L = L->rpos1 - fm[0];
+	if (rpos1L < 0)
+		rpos1L += L->size1;
+	int rpos2L = rpos1L - 1;
+	if (rpos2L < 0)
+		rpos2L += L->size1;
+	int rpos1R = R->rpos1 - fm[1];
+	if (rpos1R < 0)
+		rpos1R += R->size1;
+	int rpos2R = rpos1R - 1;
+	if (rpos2R < 0)
+		rpos2R += R->size1;
+	sf_rv_f4 buf3 = f4_pair(L->buf3[L->pos3], R->buf3[R->pos3]);
+	v = f4_add(v, f4_mul(x2->feedback3, buf3));
+	sf_rv_f4 out = f4_sub(f4_mul(x2->decay3, buf3), f4_mul(x2->feedback3, v));
+	sf_rv_f4 buf2 = f4_pair(L->buf2[L->pos2], R->buf2[R->pos2]);
+	v = f4_add(v, f4_mul(x2->feedback2, buf2));
+	buf3 = f4_sub(f4_mul(x2->decay2, buf2), f4_mul(x2->feedback2, v));
+	L->buf3[L->pos3] = f4_L(buf3); R->buf3[R->pos3] = f4_R(buf3);
+	sf_rv_f4 tmp = f4_add(
+		f4_mul(f4_pair(L->buf1[rpos2L], R->buf1[rpos2R]), mfrac),
+		f4_mul(f4_pair(L->buf1[rpos1L], R->buf1[rpos1R]), f4_sub(f4_dup(1.0f), mfrac)));
+	v = f4_add(v, f4_mul(x2->feedback1, tmp));
+	buf2 = f4_sub(f4_mul(x2->decay1, tmp), f4_mul(x2->feedback1, v));
+	L->buf2[L->pos2] = f4_L(buf2); R->buf2[R->pos2] = f4_R(buf2);
+	L->buf1[L->wpos1] = f4_L(v); R->buf1[R->wpos1] = f4_R(v);
+	L->wpos1 = wrapinc(L->wpos1, L->size1); R->wpos1 = wrapinc(R->wpos1, R->size1);
+	L->rpos1 = wrapinc(L->rpos1, L->size1); R->rpos1 = wrapinc(R->rpos1, R->size1);
+	L->pos2  = wrapinc(L->pos2 , L->size2); R->pos2  = wrapinc(R->pos2 , R->size2);
+	L->pos3  = wrapinc(L->pos3 , L->size3); R->pos3  = wrapinc(R->pos3 , R->size3);
+	return out;
+}
+
+//
+// allpassm
+//
+// either four filters, or an L/R pair in lanes 0 and 1 (lanes is 4 or 2, and c and d are NULL for
+// a pair)
+typedef struct {
+	float *buf[4];
+	sf_rv_i4 rpos, wpos, size;
+	sf_rv_f4 msize, feedback, decay, z1;
+} sf_rv_allpassmx4_st;
+
+static inline void allpassmx4_load(sf_rv_allpassmx4_st *x4, const sf_rv_allpassm_st *a,
+	const sf_rv_allpassm_st *b, const sf_rv_allpassm_st *c, const sf_rv_allpassm_st *d){
+	if (c == NULL)
+		c = d = a; // the unused lanes shadow lane 0, and are never written back
+	x4->buf[0] = a->buf; x4->buf[1] = b->buf; x4->buf[2] = c->buf; x4->buf[3] = d->buf;
+	x4->rpos     = i4_set(a->rpos, b->rpos, c->rpos, d->rpos);
+	x4->wpos     = i4_set(a->wpos, b->wpos, c->wpos, d->wpos);
+	x4->size     = i4_set(a->size, b->size, c->size, d->size);
+	x4->msize    = f4_set(a->msize, b->msize, c->msize, d->msize);
+	x4->feedback = f4_set(a->feedback, b->feedback, c->feedback, d->feedback);
+	x4->decay    = f4_set(a->decay, b->decay, c->decay, d->decay);
+	x4->z1       = f4_set(a->z1, b->z1, c->z1, d->z1);
+}
+
+static inline void allpassmx4_save(const sf_rv_allpassmx4_st *x4, sf_rv_allpassm_st *a,
+	sf_rv_allpassm_st *b, sf_rv_allpassm_st *c, sf_rv_allpassm_st *d){
+	int rpos[4], wpos[4];
+	float z1[4];
+	i4_store(rpos, x4->rpos);
+	i4_store(wpos, x4->wpos);
+	f4_store(z1, x4->z1);
+	a->rpos = rpos[0]; a->wpos = wpos[0]; a->z1 = z1[0];
+	b->rpos = rpos[1]; b->wpos = wpos[1]; b->z1 = z1[1];
+	if (c == NULL)
+		return;
+	c->rpos = rpos[2]; c->wpos = wpos[2]; c->z1 = z1[2];
+	d->rpos = rpos[3]; d->wpos = wpos[3]; d->z1 = z1[3];
+}
+
+static inline sf_rv_f4 allpassmx4_step(sf_rv_allpassmx4_st *x4, int lanes, sf_rv_f4 v,
+	sf_rv_f4 mod, sf_rv_f4 fbmod){
+	sf_rv_f4 mfeedback = f4_add(x4->feedback, fbmod);
+	mod = f4_mul(f4_add(mod, f4_dup(1.0f)), x4->msize);
+	sf_rv_i4 floormod = f4_floori(mod);
+	sf_rv_f4 mfrac = f4_add(f4_sub(f4_dup(1.0f), mod), i4_tof4(floormod));
+	sf_rv_i4 rpos1 = i4_wrapneg(i4_sub(x4->rpos, floormod), x4->size);
+	sf_rv_i4 rpos2 = i4_wrapneg(i4_sub(rpos1, i4_dup(1)), x4->size);
+	int r1[4], r2[4], w[4];
+	i4_store(r1, rpos1);
+	i4_store(r2, rpos2);
+	i4_store(w, x4->wpos);
+	float *const *buf = x4->buf;
+	sf_rv_f4 x1, x2;
+	if (lanes == 4){
+		x1 = f4_set(buf[0][r1[0]], buf[1][r1[1]], buf[2][r1[2]], buf[3][r1[3]]);
+		x2 = f4_set(buf[0][r2[0]], buf[1][r2[1]], buf[2][r2[2]], buf[3][r2[3]]);
+	}
+	else{
+		x1 = f4_pair(buf[0][r1[0]], buf[1][r1[1]]);
+		x2 = f4_pair(buf[0][r2[0]], buf[1][r2[1]]);
+	}
+	x4->z1 = f4_add(x2, f4_mul(mfrac, f4_sub(x1, x4->z1)));
+	x4->rpos = i4_wrapinc(x4->rpos, x4->size);
+	sf_rv_f4 in = f4_add(v, f4_mul(x4->z1, mfeedback));
+	float iv[4];
+	f4_store(iv, in);
+	buf[0][w[0]] = iv[0];
+	buf[1][w[1]] = iv[1];
+	if (lanes == 4){
+		buf[2][w[2]] = iv[2];
+		buf[3][w[3]] = iv[3];
+	}
+	x4->wpos = i4_wrapinc(x4->wpos, x4->size);
+	return f4_sub(f4_mul(x4->decay, x4->z1), f4_mul(in, mfeedback));
+}
+
+//
+// comb
+//
+static inline sf_rv_f4 combx2_step(sf_rv_comb_st *L, sf_rv_comb_st *R, sf_rv_f4 v,
+	sf_rv_f4 feedback){
+	v = f4_add(f4_mul(f4_pair(L->buf[L->pos], R->buf[R->pos]), feedback), v);
+	L->buf[L->pos] = f4_L(v);
+	R->buf[R->pos] = f4_R(v);
+	L->pos = wrapinc(L->pos, L->size);
+	R->pos = wrapinc(R->pos, R->size);
+	return v;
+}
+#endif // SF_REVERB_LANES
+
+// number of input samples handled per block
+//
+// sf_reverb_process runs each stage over a whole block before moving on to the next stage, which
+// keeps one component's state and delay line hot in cache at a time instead of cycling through all
+// of them for every sample
+//
+// only the feedback tank (bass boost, dampening and the cross-fade bass delays) has to run one
+// sample at a time, since its output loops back into itself through the cross delays
+#define SF_REVERB_BS        64
+
+#if defined(SF_REVERB_LANES)
+static void reverb_block(sf_reverb_state_st *rv, int size, sf_sample_st *input,
+	sf_sample_st *output){
 	// extra hardcoded constants
 	const float modnoise1 = 0.09f;
 	const float modnoise2 = 0.06f;
 	const float crossfeed = 0.4f;
 
-	// oversample buffer
-	float osL[SF_REVERB_OF], osR[SF_REVERB_OF];
+	int factor = rv->oversampleL.factor;
+	int ossize = size * factor;
+
+	sf_sample_st er   [SF_REVERB_BS];                // early reflection
+	sf_sample_st up   [SF_REVERB_BS * SF_REVERB_OF]; // oversampled input, later the oversampled mix
+	sf_sample_st out  [SF_REVERB_BS * SF_REVERB_OF]; // oversampled signal running through the stages
+	sf_sample_st cross[SF_REVERB_BS * SF_REVERB_OF]; // cross fade all-pass chain
+	float lfo1  [SF_REVERB_BS * SF_REVERB_OF];
+	float mnoise[SF_REVERB_BS * SF_REVERB_OF];
+	float lfo2  [SF_REVERB_BS * SF_REVERB_OF];
+
+	// early reflection, then oversample the single input into multiple outputs
+	{
+		sf_rv_earlyref_st *earlyref = &rv->earlyref;
+		sf_rv_biquadx2_st allpassX, allpass, lpfU;
+		sf_rv_iir1x2_st hpf, lpf;
+		biquadx2_load(&allpassX, &earlyref->allpassXL, &earlyref->allpassXR);
+		biquadx2_load(&allpass, &earlyref->allpassL, &earlyref->allpassR);
+		iir1x2_load(&hpf, &earlyref->hpfL, &earlyref->hpfR);
+		iir1x2_load(&lpf, &earlyref->lpfL, &earlyref->lpfR);
+		biquadx2_load(&lpfU, &rv->oversampleL.lpfU, &rv->oversampleR.lpfU);
+		sf_rv_f4 wet1 = f4_dup(earlyref->wet1), wet2 = f4_dup(earlyref->wet2);
+		sf_rv_f4 ertolate = f4_dup(rv->ertolate), upgain = f4_dup((float)factor);
+		int tapL[18], tapR[18];
+		for (int t = 0; t < 18; t++){
+			tapL[t] = clampi(earlyref->delaytblL[t], 1, earlyref->delayPWL.size);
+			tapR[t] = clampi(earlyref->delaytblR[t], 1, earlyref->delayPWR.size);
+		}
+		for (int i = 0; i < size; i++){
+			sf_rv_f4 in = f4_loadpair(&input[i]);
+			delay_step(&earlyref->delayPWL, input[i].L);
+			delay_step(&earlyref->delayPWR, input[i].R);
+			sf_rv_tapline_st PWL = delay_tapline(&earlyref->delayPWL);
+			sf_rv_tapline_st PWR = delay_tapline(&earlyref->delayPWR);
+			sf_rv_f4 wet = f4_dup(0);
+			for (int t = 0; t < 18; t++){
+				sf_rv_f4 tap = f4_pair(line_tap(PWL, tapL[t]), line_tap(PWR, tapR[t]));
+				wet = f4_add(wet, f4_mul(f4_loadpair(&earlyref_gaintbl[t]), tap));
+			}
+			sf_rv_f4 v = delayx2_step(&earlyref->delayRL, &earlyref->delayLR,
+				f4_swap(f4_add(in, wet)));
+			v = biquadx2_step(&allpassX, v);
+			v = biquadx2_step(&allpass, f4_add(f4_mul(wet1, wet), f4_mul(wet2, v)));
+			v = iir1x2_step(&hpf, v);
+			v = iir1x2_step(&lpf, v);
+			f4_storelo(&er[i], v);
+
+			v = f4_add(f4_mul(v, ertolate), in);
+			if (factor == 1)
+				f4_storelo(&up[i], v);
+			else{
+				f4_storelo(&up[i * factor], biquadx2_step(&lpfU, f4_mul(v, upgain)));
+				for (int i2 = 1; i2 < factor; i2++)
+					f4_storelo(&up[i * factor + i2], biquadx2_step(&lpfU, f4_dup(0)));
+			}
+		}
+		biquadx2_save(&allpassX, &earlyref->allpassXL, &earlyref->allpassXR);
+		biquadx2_save(&allpass, &earlyref->allpassL, &earlyref->allpassR);
+		iir1x2_save(&hpf, &earlyref->hpfL, &earlyref->hpfR);
+		iir1x2_save(&lpf, &earlyref->lpfL, &earlyref->lpfR);
+		biquadx2_save(&lpfU, &rv->oversampleL.lpfU, &rv->oversampleR.lpfU);
+	}
 
-	for (int i = 0; i < size; i++){
-		// early reflection
-		sf_sample_st er = earlyref_step(&rv->earlyref, input[i]);
-		float erL = er.L * rv->ertolate + input[i].L;
-		float erR = er.R * rv->ertolate + input[i].R;
+	// dc cut
+	{
+		sf_rv_dccutx2_st dccut;
+		dccutx2_load(&dccut, &rv->dccutL, &rv->dccutR);
+		for (int i = 0; i < ossize; i++)
+			f4_storelo(&out[i], dccutx2_step(&dccut, f4_loadpair(&up[i])));
+		dccutx2_save(&dccut, &rv->dccutL, &rv->dccutR);
+	}
 
-		// oversample the single input into multiple outputs
-		oversample_stepup(&rv->oversampleL, erL, osL);
-		oversample_stepup(&rv->oversampleR, erR, osR);
+	// noise and LFOs only depend on their own state, so the whole block can be generated up front
+	for (int i = 0; i < ossize; i++){
+		float mn = noise_step(&rv->noise);
+		float lfo = (lfo_step(&rv->lfo1) + modnoise1 * mn) * rv->wander;
+		lfo1[i] = iir1_step(&rv->lfo1_lpf, lfo);
+		mnoise[i] = mn * modnoise2;
+		lfo2[i] = iir1_step(&rv->lfo2_lpf, lfo_step(&rv->lfo2) * rv->wander);
+	}
 
-		// for each oversampled sample...
-		for (int i2 = 0; i2 < rv->oversampleL.factor; i2++){
-			// dc cut
-			float outL = dccut_step(&rv->dccutL, osL[i2]);
-			float outR = dccut_step(&rv->dccutR, osR[i2]);
-
-			// noise
-			float mnoise = noise_step(&rv->noise);
-			float lfo = (lfo_step(&rv->lfo1) + modnoise1 * mnoise) * rv->wander;
-			lfo = iir1_step(&rv->lfo1_lpf, lfo);
-			mnoise *= modnoise2;
-
-			// diffusion
-			for (int i = 0, s = -1; i < 10; i++, s = -s){
-				outL = allpassm_step(&rv->diffL[i], outL, lfo * s, mnoise);
-				outR = allpassm_step(&rv->diffR[i], outR, lfo, mnoise * s);
+	// diffusion
+	//
+	// the stages are run two at a time, with the second stage one sample behind the first, as the
+	// four lanes: the second stage's L/R, then the first stage's L/R, so the first stage's output
+	// moves down two lanes to feed the second
+	// (the first stage of a pair flips the left LFO and right noise, the second one doesn't)
+	int last = ossize - 1;
+	for (int d = 0; d < 10; d += 2){
+		sf_rv_allpassm_st *d1L = &rv->diffL[d]    , *d1R = &rv->diffR[d]    ;
+		sf_rv_allpassm_st *d2L = &rv->diffL[d + 1], *d2R = &rv->diffR[d + 1];
+		out[0].L = allpassm_step(d1L, out[0].L, -lfo1[0], mnoise[0]);
+		out[0].R = allpassm_step(d1R, out[0].R, lfo1[0], -mnoise[0]);
+		if (last > 0){
+			sf_rv_allpassmx4_st x4;
+			allpassmx4_load(&x4, d2L, d2R, d1L, d1R);
+			sf_rv_f4 v = f4_set(out[0].L, out[0].R, out[1].L, out[1].R);
+			const sf_rv_f4 modsign = f4_set(1, 1, -1, 1), fbsign = f4_set(1, 1, 1, -1);
+			for (int i = 1; ; i++){
+				sf_rv_f4 mod = f4_mul(f4_spread(&lfo1[i - 1]), modsign);
+				sf_rv_f4 fbmod = f4_mul(f4_spread(&mnoise[i - 1]), fbsign);
+				v = allpassmx4_step(&x4, 4, v, mod, fbmod);
+				f4_storelo(&out[i - 1], v);
+				if (i == last)
+					break;
+				v = f4_shiftin(v, &out[i + 1]);
 			}
+			float lanes[4];
+			f4_store(lanes, v);
+			out[last] = (sf_sample_st){ lanes[2], lanes[3] };
+			allpassmx4_save(&x4, d2L, d2R, d1L, d1R);
+		}
+		out[last].L = allpassm_step(d2L, out[last].L, lfo1[last], mnoise[last]);
+		out[last].R = allpassm_step(d2R, out[last].R, lfo1[last], mnoise[last]);
+	}
+
+	// cross fade
+	memcpy(cross, out, sizeof(sf_sample_st) * ossize);
+	for (int c = 0; c < 4; c++){
+		sf_rv_allpass_st crossL = rv->crossL[c], crossR = rv->crossR[c];
+		sf_rv_f4 feedback = f4_pair(crossL.feedback, crossR.feedback);
+		sf_rv_f4 decay = f4_pair(crossL.decay, crossR.decay);
+		for (int i = 0; i < ossize; i++)
+			f4_storelo(&cross[i],
+				allpassx2_step(&crossL, &crossR, feedback, decay, f4_loadpair(&cross[i])));
+		rv->crossL[c] = crossL; rv->crossR[c] = crossR;
+	}
+	{
+		sf_rv_iir1x2_st clpf;
+		iir1x2_load(&clpf, &rv->clpfL, &rv->clpfR);
+		sf_rv_f4 feed = f4_dup(crossfeed);
+		for (int i = 0; i < ossize; i++){
+			sf_rv_f4 x = f4_swap(f4_loadpair(&cross[i]));
+			sf_rv_f4 v = f4_add(f4_loadpair(&out[i]), f4_mul(feed, x));
+			f4_storelo(&out[i], iir1x2_step(&clpf, v));
+		}
+		iir1x2_save(&clpf, &rv->clpfL, &rv->clpfR);
+	}
 
-			// cross fade
-			float crossL = outL, crossR = outR;
-			for (int i = 0; i < 4; i++){
-				crossL = allpass_step(&rv->crossL[i], crossL);
-				crossR = allpass_step(&rv->crossR[i], crossR);
+	// feedback tank
+	//
+	// each L/R pair of components runs in two lanes; the outputs are tapped in pairs too, the right
+	// channel's taps mirroring the left's
+	sf_rv_delay_st      cdelayL  = rv->cdelayL , cdelayR  = rv->cdelayR ;
+	sf_rv_delay_st      dampdL   = rv->dampdL  , dampdR   = rv->dampdR  ;
+	sf_rv_delay_st      cbassd1L = rv->cbassd1L, cbassd1R = rv->cbassd1R;
+	sf_rv_delay_st      cbassd2L = rv->cbassd2L, cbassd2R = rv->cbassd2R;
+	sf_rv_biquadx2_st   bassap, basslp;
+	sf_rv_iir1x2_st     damplp;
+	sf_rv_allpassmx4_st dampap1, dampap2;
+	sf_rv_allpass2x2_st cbassap1;
+	sf_rv_allpass3x2_st cbassap2;
+	biquadx2_load  (&bassap  , &rv->bassapL  , &rv->bassapR  );
+	biquadx2_load  (&basslp  , &rv->basslpL  , &rv->basslpR  );
+	iir1x2_load    (&damplp  , &rv->damplpL  , &rv->damplpR  );
+	allpassmx4_load(&dampap1 , &rv->dampap1L , &rv->dampap1R , NULL, NULL);
+	allpassmx4_load(&dampap2 , &rv->dampap2L , &rv->dampap2R , NULL, NULL);
+	allpass2x2_load(&cbassap1, &rv->cbassap1L, &rv->cbassap1R);
+	allpass3x2_load(&cbassap2, &rv->cbassap2L, &rv->cbassap2R);
+	sf_rv_allpass2_st *cbassap1L = &cbassap1.L, *cbassap1R = &cbassap1.R;
+	sf_rv_allpass3_st *cbassap2L = &cbassap2.L, *cbassap2R = &cbassap2.R;
+	sf_rv_f4 loopdecay = f4_dup(rv->loopdecay), bassb = f4_dup(rv->bassb);
+	// the lines don't change size, so the output tap offsets are clamped into them up front, as
+	// delay_get and the allpass get functions would on every read
+	const int tapsize[32] = {
+		cbassd1L.size, cbassd2L.size, cbassd2R.size, cbassd2L.size, cdelayR.size, cbassd1R.size,
+		cbassd2R.size, cdelayL.size, cbassap1L->size1, cbassap1L->size2, cbassap1R->size2,
+		cbassap2L->size1, cbassap2L->size2, cbassap2L->size3, cbassap2R->size2, cdelayL.size,
+		cbassd1R.size, cbassd2R.size, cbassd2L.size, cbassd2R.size, cdelayL.size, cbassd1L.size,
+		cbassd2L.size, cdelayR.size, cbassap1R->size1, cbassap1R->size2, cbassap1L->size2,
+		cbassap2R->size1, cbassap2R->size2, cbassap2R->size3, cbassap2L->size2, cdelayR.size
+	};
+	int o[32];
+	for (int k = 0; k < 32; k++)
+		o[k] = clampi(rv->outco[k], 1, tapsize[k]);
+	for (int i = 0; i < ossize; i++){
+		sf_rv_f4 lfo = f4_pair(lfo1[i], -lfo1[i]);
+		sf_rv_f4 mn = f4_pair(mnoise[i], -mnoise[i]);
+		sf_rv_f4 v = f4_loadpair(&out[i]);
+
+		// bass boost
+		sf_rv_f4 crossv = f4_pair(delay_getlast(&cdelayR), delay_getlast(&cdelayL));
+		v = f4_add(v, f4_mul(loopdecay, f4_add(crossv,
+			f4_mul(bassb, biquadx2_step(&basslp, biquadx2_step(&bassap, crossv))))));
+
+		// dampening
+		v = allpassmx4_step(&dampap2, 2,
+			delayx2_step(&dampdL, &dampdR,
+			allpassmx4_step(&dampap1, 2,
+			iir1x2_step(&damplp, v), lfo, mn)),
+			f4_neg(lfo), f4_neg(mn));
+
+		// update cross fade bass boost delay
+		delayx2_step(&cdelayL, &cdelayR,
+			allpass3x2_step(&cbassap2,
+			delayx2_step(&cbassd2L, &cbassd2R,
+			allpass2x2_step(&cbassap1,
+			delayx2_step(&cbassd1L, &cbassd1R, v))),
+				lfo));
+
+		// the left output in lane 0, the right in lane 1
+		sf_rv_tapline_st ap1L1 = { cbassap1L->pos1 , cbassap1L->size1, cbassap1L->buf1 };
+		sf_rv_tapline_st ap1L2 = { cbassap1L->pos2 , cbassap1L->size2, cbassap1L->buf2 };
+		sf_rv_tapline_st ap1R1 = { cbassap1R->pos1 , cbassap1R->size1, cbassap1R->buf1 };
+		sf_rv_tapline_st ap1R2 = { cbassap1R->pos2 , cbassap1R->size2, cbassap1R->buf2 };
+		sf_rv_tapline_st ap2L1 = { cbassap2L->rpos1, cbassap2L->size1, cbassap2L->buf1 };
+		sf_rv_tapline_st ap2L2 = { cbassap2L->pos2 , cbassap2L->size2, cbassap2L->buf2 };
+		sf_rv_tapline_st ap2L3 = { cbassap2L->pos3 , cbassap2L->size3, cbassap2L->buf3 };
+		sf_rv_tapline_st ap2R1 = { cbassap2R->rpos1, cbassap2R->size1, cbassap2R->buf1 };
+		sf_rv_tapline_st ap2R2 = { cbassap2R->pos2 , cbassap2R->size2, cbassap2R->buf2 };
+		sf_rv_tapline_st ap2R3 = { cbassap2R->pos3 , cbassap2R->size3, cbassap2R->buf3 };
+		sf_rv_tapline_st d1L = delay_tapline(&cbassd1L), d1R = delay_tapline(&cbassd1R);
+		sf_rv_tapline_st d2L = delay_tapline(&cbassd2L), d2R = delay_tapline(&cbassd2R);
+		sf_rv_tapline_st cdL = delay_tapline(&cdelayL ), cdR = delay_tapline(&cdelayR );
+		#define TAP(line, k) line_tap(line, o[k])
+		#define PAIR(l, kl, r, kr) f4_pair(TAP(l, kl), TAP(r, kr))
+		sf_rv_f4 D1 = PAIR(d1L, 0, d1R, 16);
+		sf_rv_f4 D2 = PAIR(d2L, 1, d2R, 17);
+		D2 = f4_sub(D2, PAIR(d2R,  2, d2L, 18));
+		D2 = f4_add(D2, PAIR(d2L,  3, d2R, 19));
+		D2 = f4_sub(D2, PAIR(cdR,  4, cdL, 20));
+		D2 = f4_sub(D2, PAIR(d1R,  5, d1L, 21));
+		D2 = f4_sub(D2, PAIR(d2R,  6, d2L, 22));
+		sf_rv_f4 D3 = PAIR(cdL, 7, cdR, 23);
+		D3 = f4_add(D3, PAIR(ap1L1   ,  8, ap1R1   , 24));
+		D3 = f4_add(D3, PAIR(ap1L2   ,  9, ap1R2   , 25));
+		D3 = f4_sub(D3, PAIR(ap1R2   , 10, ap1L2   , 26));
+		D3 = f4_add(D3, PAIR(ap2L1   , 11, ap2R1   , 27));
+		D3 = f4_add(D3, PAIR(ap2L2   , 12, ap2R2   , 28));
+		D3 = f4_add(D3, PAIR(ap2L3   , 13, ap2R3   , 29));
+		D3 = f4_sub(D3, PAIR(ap2R2   , 14, ap2L2   , 30));
+		sf_rv_f4 D4 = PAIR(cdL, 15, cdR, 31);
+		#undef PAIR
+		#undef TAP
+
+		sf_rv_f4 D = f4_add(f4_add(f4_add(
+			f4_mul(D1, f4_dup(0.469f)), f4_mul(D2, f4_dup(0.219f))), f4_mul(D3, f4_dup(0.064f))),
+			f4_mul(D4, f4_dup(0.045f)));
+		f4_storelo(&out[i], D);
+	}
+	rv->cdelayL  = cdelayL ; rv->cdelayR  = cdelayR ;
+	rv->dampdL   = dampdL  ; rv->dampdR   = dampdR  ;
+	rv->cbassd1L = cbassd1L; rv->cbassd1R = cbassd1R;
+	rv->cbassd2L = cbassd2L; rv->cbassd2R = cbassd2R;
+	rv->cbassap1L = *cbassap1L; rv->cbassap1R = *cbassap1R;
+	rv->cbassap2L = *cbassap2L; rv->cbassap2R = *cbassap2R;
+	biquadx2_save  (&bassap , &rv->bassapL , &rv->bassapR );
+	biquadx2_save  (&basslp , &rv->basslpL , &rv->basslpR );
+	iir1x2_save    (&damplp , &rv->damplpL , &rv->damplpR );
+	allpassmx4_save(&dampap1, &rv->dampap1L, &rv->dampap1R, NULL, NULL);
+	allpassmx4_save(&dampap2, &rv->dampap2L, &rv->dampap2R, NULL, NULL);
+
+	// output comb, lowpass and delay, mixed with the (delayed) dry oversampled input
+	{
+		sf_rv_biquadx2_st lastlpf;
+		biquadx2_load(&lastlpf, &rv->lastlpfL, &rv->lastlpfR);
+		sf_rv_f4 wet1 = f4_dup(rv->wet1), wet2 = f4_dup(rv->wet2), dry = f4_dup(rv->dry);
+		for (int i = 0; i < ossize; i++){
+			sf_rv_f4 v = combx2_step(&rv->combL, &rv->combR, f4_loadpair(&out[i]),
+				f4_pair(lfo2[i], -lfo2[i]));
+			v = delayx2_step(&rv->lastdelayL, &rv->lastdelayR, biquadx2_step(&lastlpf, v));
+			sf_rv_f4 mix = f4_add(f4_add(f4_mul(v, wet1), f4_mul(f4_swap(v), wet2)),
+				f4_mul(delayx2_step(&rv->inpdelayL, &rv->inpdelayR, f4_loadpair(&up[i])), dry));
+			f4_storelo(&up[i], mix);
+		}
+		biquadx2_save(&lastlpf, &rv->lastlpfL, &rv->lastlpfR);
+	}
+
+	// downsample back to the input rate and mix in the early reflection and dry signal
+	{
+		sf_rv_biquadx2_st lpfD;
+		biquadx2_load(&lpfD, &rv->oversampleL.lpfD, &rv->oversampleR.lpfD);
+		sf_rv_f4 erefwet = f4_dup(rv->erefwet), dry = f4_dup(rv->dry);
+		for (int i = 0; i < size; i++){
+			sf_rv_f4 v;
+			if (factor == 1)
+				v = f4_loadpair(&up[i]);
+			else{
+				v = biquadx2_step(&lpfD, f4_loadpair(&up[i * factor]));
+				for (int i2 = 1; i2 < factor; i2++)
+					biquadx2_step(&lpfD, f4_loadpair(&up[i * factor + i2]));
 			}
-			outL = iir1_step(&rv->clpfL, outL + crossfeed * crossR);
-			outR = iir1_step(&rv->clpfR, outR + crossfeed * crossL);
-
-			// bass boost
-			crossL = delay_getlast(&rv->cdelayL);
-			crossR = delay_getlast(&rv->cdelayR);
-			outL += rv->loopdecay *
-				(crossR + rv->bassb * biquad_step(&rv->basslpL, biquad_step(&rv->bassapL, crossR)));
-			outR += rv->loopdecay *
-				(crossL + rv->bassb * biquad_step(&rv->basslpR, biquad_step(&rv->bassapR, crossL)));
-
-			// dampening
-			outL = allpassm_step(&rv->dampap2L,
-				delay_step(&rv->dampdL,
-				allpassm_step(&rv->dampap1L,
-				iir1_step(&rv->damplpL, outL), lfo, mnoise)),
-				-lfo, -mnoise);
-			outR = allpassm_step(&rv->dampap2R,
-				delay_step(&rv->dampdR,
-				allpassm_step(&rv->dampap1R,
-				iir1_step(&rv->damplpR, outR), -lfo, -mnoise)),
-				lfo, mnoise);
-
-			// update cross fade bass boost delay
-			delay_step(&rv->cdelayL,
-				allpass3_step(&rv->cbassap2L,
-				delay_step(&rv->cbassd2L,
-				allpass2_step(&rv->cbassap1L,
-				delay_step(&rv->cbassd1L, outL))),
-					lfo));
-			delay_step(&rv->cdelayR,
-				allpass3_step(&rv->cbassap2R,
-				delay_step(&rv->cbassd2R,
-				allpass2_step(&rv->cbassap1R,
-				delay_step(&rv->cbassd1R, outR))),
-					-lfo));
-
-			//
-			float D1 =
-				delay_get    (&rv->cbassd1L , rv->outco[ 0]);
-			float D2 =
-				delay_get    (&rv->cbassd2L , rv->outco[ 1]) -
-				delay_get    (&rv->cbassd2R , rv->outco[ 2]) +
-				delay_get    (&rv->cbassd2L , rv->outco[ 3]) -
-				delay_get    (&rv->cdelayR  , rv->outco[ 4]) -
-				delay_get    (&rv->cbassd1R , rv->outco[ 5]) -
-				delay_get    (&rv->cbassd2R , rv->outco[ 6]);
-			float D3 =
-				delay_get    (&rv->cdelayL  , rv->outco[ 7]) +
-				allpass2_get1(&rv->cbassap1L, rv->outco[ 8]) +
-				allpass2_get2(&rv->cbassap1L, rv->outco[ 9]) -
-				allpass2_get2(&rv->cbassap1R, rv->outco[10]) +
-				allpass3_get1(&rv->cbassap2L, rv->outco[11]) +
-				allpass3_get2(&rv->cbassap2L, rv->outco[12]) +
-				allpass3_get3(&rv->cbassap2L, rv->outco[13]) -
-				allpass3_get2(&rv->cbassap2R, rv->outco[14]);
-			float D4 =
-				delay_get    (&rv->cdelayL  , rv->outco[15]);
-
-			float B1 =
-				delay_get    (&rv->cbassd1R , rv->outco[16]);
-			float B2 =
-				delay_get    (&rv->cbassd2R , rv->outco[17]) -
-				delay_get    (&rv->cbassd2L , rv->outco[18]) +
-				delay_get    (&rv->cbassd2R , rv->outco[19]) -
-				delay_get    (&rv->cdelayL  , rv->outco[20]) -
-				delay_get    (&rv->cbassd1L , rv->outco[21]) -
-				delay_get    (&rv->cbassd2L , rv->outco[22]);
-			float B3 =
-				delay_get    (&rv->cdelayR  , rv->outco[23]) +
-				allpass2_get1(&rv->cbassap1R, rv->outco[24]) +
-				allpass2_get2(&rv->cbassap1R, rv->outco[25]) -
-				allpass2_get2(&rv->cbassap1L, rv->outco[26]) +
-				allpass3_get1(&rv->cbassap2R, rv->outco[27]) +
-				allpass3_get2(&rv->cbassap2R, rv->outco[28]) +
-				allpass3_get3(&rv->cbassap2R, rv->outco[29]) -
-				allpass3_get2(&rv->cbassap2L, rv->outco[30]);
-			float B4 =
-				delay_get    (&rv->cdelayR  , rv->outco[31]);
-
-			float D = D1 * 0.469f + D2 * 0.219f + D3 * 0.064f + D4 * 0.045f;
-			float B = B1 * 0.469f + B2 * 0.219f + B3 * 0.064f + B4 * 0.045f;
-
-			lfo = iir1_step(&rv->lfo2_lpf, lfo_step(&rv->lfo2) * rv->wander);
-			outL = comb_step(&rv->combL, D, lfo);
-			outR = comb_step(&rv->combR, B, -lfo);
-
-			outL = delay_step(&rv->lastdelayL, biquad_step(&rv->lastlpfL, outL));
-			outR = delay_step(&rv->lastdelayR, biquad_step(&rv->lastlpfR, outR));
-
-			osL[i2] = outL * rv->wet1 + outR * rv->wet2 +
-				delay_step(&rv->inpdelayL, osL[i2]) * rv->dry;
-			osR[i2] = outR * rv->wet1 + outL * rv->wet2 +
-				delay_step(&rv->inpdelayR, osR[i2]) * rv->dry;
+			v = f4_add(v, f4_add(f4_mul(f4_loadpair(&er[i]), erefwet),
+				f4_mul(f4_loadpair(&input[i]), dry)));
+			f4_storelo(&output[i], v);
 		}
+		biquadx2_save(&lpfD, &rv->oversampleL.lpfD, &rv->oversampleR.lpfD);
+	}
+}
+#else
+static void reverb_block(sf_reverb_state_st *rv, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	// extra hardcoded constants
+	const float modnoise1 = 0.09f;
+	const float modnoise2 = 0.06f;
+	const float crossfeed = 0.4f;
+
+	int factor = rv->oversampleL.factor;
+	int ossize = size * factor;
+
+	// the L/R channels are kept side by side in sf_sample_st pairs, so both channels of a stage are
+	// processed in the same iteration
+	sf_sample_st er   [SF_REVERB_BS];                // early reflection
+	sf_sample_st up   [SF_REVERB_BS * SF_REVERB_OF]; // oversampled input, later the oversampled mix
+	sf_sample_st out  [SF_REVERB_BS * SF_REVERB_OF]; // oversampled signal running through the stages
+	sf_sample_st cross[SF_REVERB_BS * SF_REVERB_OF]; // cross fade all-pass chain
+	float lfo1  [SF_REVERB_BS * SF_REVERB_OF];
+	float mnoise[SF_REVERB_BS * SF_REVERB_OF];
+	float lfo2  [SF_REVERB_BS * SF_REVERB_OF];
 
+	// early reflection, then oversample the single input into multiple outputs
+	for (int i = 0; i < size; i++){
+		er[i] = earlyref_step(&rv->earlyref, input[i]);
+		float erL = er[i].L * rv->ertolate + input[i].L;
+		float erR = er[i].R * rv->ertolate + input[i].R;
+		float osL[SF_REVERB_OF], osR[SF_REVERB_OF];
+		oversample_stepup(&rv->oversampleL, erL, osL);
+		oversample_stepup(&rv->oversampleR, erR, osR);
+		for (int i2 = 0; i2 < factor; i2++)
+			up[i * factor + i2] = (sf_sample_st){ osL[i2], osR[i2] };
+	}
+
+	// dc cut
+	for (int i = 0; i < ossize; i++){
+		out[i].L = dccut_step(&rv->dccutL, up[i].L);
+		out[i].R = dccut_step(&rv->dccutR, up[i].R);
+	}
+
+	// noise and LFOs only depend on their own state, so the whole block can be generated up front
+	for (int i = 0; i < ossize; i++){
+		float mn = noise_step(&rv->noise);
+		float lfo = (lfo_step(&rv->lfo1) + modnoise1 * mn) * rv->wander;
+		lfo1[i] = iir1_step(&rv->lfo1_lpf, lfo);
+		mnoise[i] = mn * modnoise2;
+		lfo2[i] = iir1_step(&rv->lfo2_lpf, lfo_step(&rv->lfo2) * rv->wander);
+	}
+
+	// diffusion
+	//
+	// the stages are run two at a time on local copies of their state, with the second stage one
+	// sample behind the first, so four independent filters are in flight per iteration
+	// (the first stage of a pair flips the left LFO and right noise, the second one doesn't)
+	for (int d = 0; d < 10; d += 2){
+		sf_rv_allpassm_st d1L = rv->diffL[d]    , d1R = rv->diffR[d]    ;
+		sf_rv_allpassm_st d2L = rv->diffL[d + 1], d2R = rv->diffR[d + 1];
+		out[0].L = allpassm_step(&d1L, out[0].L, -lfo1[0], mnoise[0]);
+		out[0].R = allpassm_step(&d1R, out[0].R, lfo1[0], -mnoise[0]);
+		for (int i = 1; i < ossize; i++){
+			out[i].L = allpassm_step(&d1L, out[i].L, -lfo1[i], mnoise[i]);
+			out[i].R = allpassm_step(&d1R, out[i].R, lfo1[i], -mnoise[i]);
+			out[i - 1].L = allpassm_step(&d2L, out[i - 1].L, lfo1[i - 1], mnoise[i - 1]);
+			out[i - 1].R = allpassm_step(&d2R, out[i - 1].R, lfo1[i - 1], mnoise[i - 1]);
+		}
+		int last = ossize - 1;
+		out[last].L = allpassm_step(&d2L, out[last].L, lfo1[last], mnoise[last]);
+		out[last].R = allpassm_step(&d2R, out[last].R, lfo1[last], mnoise[last]);
+		rv->diffL[d]     = d1L; rv->diffR[d]     = d1R;
+		rv->diffL[d + 1] = d2L; rv->diffR[d + 1] = d2R;
+	}
+
+	// cross fade
+	memcpy(cross, out, sizeof(sf_sample_st) * ossize);
+	for (int c = 0; c < 4; c++){
+		sf_rv_allpass_st crossL = rv->crossL[c], crossR = rv->crossR[c];
+		for (int i = 0; i < ossize; i++){
+			cross[i].L = allpass_step(&crossL, cross[i].L);
+			cross[i].R = allpass_step(&crossR, cross[i].R);
+		}
+		rv->crossL[c] = crossL; rv->crossR[c] = crossR;
+	}
+	for (int i = 0; i < ossize; i++){
+		float outL = iir1_step(&rv->clpfL, out[i].L + crossfeed * cross[i].R);
+		float outR = iir1_step(&rv->clpfR, out[i].R + crossfeed * cross[i].L);
+		out[i] = (sf_sample_st){ outL, outR };
+	}
+
+	// feedback tank
+	//
+	// the state is copied into locals for the block, so the compiler knows the delay line writes
+	// can't change it and doesn't have to reload it after every write
+	sf_rv_delay_st    cdelayL   = rv->cdelayL  , cdelayR   = rv->cdelayR  ;
+	sf_rv_biquad_st   bassapL   = rv->bassapL  , bassapR   = rv->bassapR  ;
+	sf_rv_biquad_st   basslpL   = rv->basslpL  , basslpR   = rv->basslpR  ;
+	sf_rv_iir1_st     damplpL   = rv->damplpL  , damplpR   = rv->damplpR  ;
+	sf_rv_allpassm_st dampap1L  = rv->dampap1L , dampap1R  = rv->dampap1R ;
+	sf_rv_delay_st    dampdL    = rv->dampdL   , dampdR    = rv->dampdR   ;
+	sf_rv_allpassm_st dampap2L  = rv->dampap2L , dampap2R  = rv->dampap2R ;
+	sf_rv_delay_st    cbassd1L  = rv->cbassd1L , cbassd1R  = rv->cbassd1R ;
+	sf_rv_allpass2_st cbassap1L = rv->cbassap1L, cbassap1R = rv->cbassap1R;
+	sf_rv_delay_st    cbassd2L  = rv->cbassd2L , cbassd2R  = rv->cbassd2R ;
+	sf_rv_allpass3_st cbassap2L = rv->cbassap2L, cbassap2R = rv->cbassap2R;
+	float loopdecay = rv->loopdecay, bassb = rv->bassb;
+	for (int i = 0; i < ossize; i++){
+		float lfo = lfo1[i];
+		float mn = mnoise[i];
+		float outL = out[i].L;
+		float outR = out[i].R;
+
+		// bass boost
+		float crossL = delay_getlast(&cdelayL);
+		float crossR = delay_getlast(&cdelayR);
+		outL += loopdecay *
+			(crossR + bassb * biquad_step(&basslpL, biquad_step(&bassapL, crossR)));
+		outR += loopdecay *
+			(crossL + bassb * biquad_step(&basslpR, biquad_step(&bassapR, crossL)));
+
+		// dampening
+		outL = allpassm_step(&dampap2L,
+			delay_step(&dampdL,
+			allpassm_step(&dampap1L,
+			iir1_step(&damplpL, outL), lfo, mn)),
+			-lfo, -mn);
+		outR = allpassm_step(&dampap2R,
+			delay_step(&dampdR,
+			allpassm_step(&dampap1R,
+			iir1_step(&damplpR, outR), -lfo, -mn)),
+			lfo, mn);
+
+		// update cross fade bass boost delay
+		delay_step(&cdelayL,
+			allpass3_step(&cbassap2L,
+			delay_step(&cbassd2L,
+			allpass2_step(&cbassap1L,
+			delay_step(&cbassd1L, outL))),
+				lfo));
+		delay_step(&cdelayR,
+			allpass3_step(&cbassap2R,
+			delay_step(&cbassd2R,
+			allpass2_step(&cbassap1R,
+			delay_step(&cbassd1R, outR))),
+				-lfo));
+
+		//
+		float D1 =
+			delay_get    (&cbassd1L , rv->outco[ 0]);
+		float D2 =
+			delay_get    (&cbassd2L , rv->outco[ 1]) -
+			delay_get    (&cbassd2R , rv->outco[ 2]) +
+			delay_get    (&cbassd2L , rv->outco[ 3]) -
+			delay_get    (&cdelayR  , rv->outco[ 4]) -
+			delay_get    (&cbassd1R , rv->outco[ 5]) -
+			delay_get    (&cbassd2R , rv->outco[ 6]);
+		float D3 =
+			delay_get    (&cdelayL  , rv->outco[ 7]) +
+			allpass2_get1(&cbassap1L, rv->outco[ 8]) +
+			allpass2_get2(&cbassap1L, rv->outco[ 9]) -
+			allpass2_get2(&cbassap1R, rv->outco[10]) +
+			allpass3_get1(&cbassap2L, rv->outco[11]) +
+			allpass3_get2(&cbassap2L, rv->outco[12]) +
+			allpass3_get3(&cbassap2L, rv->outco[13]) -
+			allpass3_get2(&cbassap2R, rv->outco[14]);
+		float D4 =
+			delay_get    (&cdelayL  , rv->outco[15]);
+
+		float B1 =
+			delay_get    (&cbassd1R , rv->outco[16]);
+		float B2 =
+			delay_get    (&cbassd2R , rv->outco[17]) -
+			delay_get    (&cbassd2L , rv->outco[18]) +
+			delay_get    (&cbassd2R , rv->outco[19]) -
+			delay_get    (&cdelayL  , rv->outco[20]) -
+			delay_get    (&cbassd1L , rv->outco[21]) -
+			delay_get    (&cbassd2L , rv->outco[22]);
+		float B3 =
+			delay_get    (&cdelayR  , rv->outco[23]) +
+			allpass2_get1(&cbassap1R, rv->outco[24]) +
+			allpass2_get2(&cbassap1R, rv->outco[25]) -
+			allpass2_get2(&cbassap1L, rv->outco[26]) +
+			allpass3_get1(&cbassap2R, rv->outco[27]) +
+			allpass3_get2(&cbassap2R, rv->outco[28]) +
+			allpass3_get3(&cbassap2R, rv->outco[29]) -
+			allpass3_get2(&cbassap2L, rv->outco[30]);
+		float B4 =
+			delay_get    (&cdelayR  , rv->outco[31]);
+
+		float D = D1 * 0.469f + D2 * 0.219f + D3 * 0.064f + D4 * 0.045f;
+		float B = B1 * 0.469f + B2 * 0.219f + B3 * 0.064f + B4 * 0.045f;
+		out[i] = (sf_sample_st){ D, B };
+	}
+	rv->cdelayL   = cdelayL  ; rv->cdelayR   = cdelayR  ;
+	rv->bassapL   = bassapL  ; rv->bassapR   = bassapR  ;
+	rv->basslpL   = basslpL  ; rv->basslpR   = basslpR  ;
+	rv->damplpL   = damplpL  ; rv->damplpR   = damplpR  ;
+	rv->dampap1L  = dampap1L ; rv->dampap1R  = dampap1R ;
+	rv->dampdL    = dampdL   ; rv->dampdR    = dampdR   ;
+	rv->dampap2L  = dampap2L ; rv->dampap2R  = dampap2R ;
+	rv->cbassd1L  = cbassd1L ; rv->cbassd1R  = cbassd1R ;
+	rv->cbassap1L = cbassap1L; rv->cbassap1R = cbassap1R;
+	rv->cbassd2L  = cbassd2L ; rv->cbassd2R  = cbassd2R ;
+	rv->cbassap2L = cbassap2L; rv->cbassap2R = cbassap2R;
+
+	// output comb, lowpass and delay, mixed with the (delayed) dry oversampled input
+	for (int i = 0; i < ossize; i++){
+		float outL = comb_step(&rv->combL, out[i].L, lfo2[i]);
+		float outR = comb_step(&rv->combR, out[i].R, -lfo2[i]);
+
+		outL = delay_step(&rv->lastdelayL, biquad_step(&rv->lastlpfL, outL));
+		outR = delay_step(&rv->lastdelayR, biquad_step(&rv->lastlpfR, outR));
+
+		float mixL = outL * rv->wet1 + outR * rv->wet2 +
+			delay_step(&rv->inpdelayL, up[i].L) * rv->dry;
+		float mixR = outR * rv->wet1 + outL * rv->wet2 +
+			delay_step(&rv->inpdelayR, up[i].R) * rv->dry;
+		up[i] = (sf_sample_st){ mixL, mixR };
+	}
+
+	// downsample back to the input rate and mix in the early reflection and dry signal
+	for (int i = 0; i < size; i++){
+		float osL[SF_REVERB_OF], osR[SF_REVERB_OF];
+		for (int i2 = 0; i2 < factor; i2++){
+			osL[i2] = up[i * factor + i2].L;
+			osR[i2] = up[i * factor + i2].R;
+		}
 		float outL = oversample_stepdown(&rv->oversampleL, osL);
 		float outR = oversample_stepdown(&rv->oversampleR, osR);
-		outL += er.L * rv->erefwet + input[i].L * rv->dry;
-		outR += er.R * rv->erefwet + input[i].R * rv->dry;
+		outL += er[i].L * rv->erefwet + input[i].L * rv->dry;
+		outR += er[i].R * rv->erefwet + input[i].R * rv->dry;
 		output[i] = (sf_sample_st){ outL, outR };
 	}
 }
+#endif
+
+void sf_reverb_process(sf_reverb_state_st *rv, int size, sf_sample_st *input, sf_sample_st *output){
+	for (int i = 0; i < size; i += SF_REVERB_BS){
+		int len = size - i < SF_REVERB_BS ? size - i : SF_REVERB_BS;
+		reverb_block(rv, len, &input[i], &output[i]);
+	}
+}
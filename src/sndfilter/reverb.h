@@ -9,18 +9,21 @@
 #define SNDFILTER_REVERB__H
 
 #include "snd.h"
+#include <stddef.h>
 
 // this API works by first initializing an sf_reverb_state_st structure, then using it to process a
 // sample in chunks
 //
 // for example, say you're processing a stream in 128 samples per chunk:
 //
-//   sf_reverb_state_st rv;
+//   sf_reverb_state_st rv = {0};
 //   sf_presetreverb(&rv, 44100, SF_REVERB_PRESET_DEFAULT);
 //
 //   for each 128 length sample:
 //     sf_reverb_process(&rv, 128, input, output);
 //
+//   sf_reverb_free(&rv);
+//
 // notice that sf_reverb_process will change a lot of the member variables inside of the state
 // structure, since these values must be carried over across chunk boundaries
 //
@@ -54,14 +57,17 @@
 //
 // each component is designed to work one step at a time, so any size sample can be streamed through
 // in one pass
+//
+// the delay lines of every component don't live inside the structures -- they point into a single
+// arena owned by the state, sized to exactly what the active preset needs (see sf_reverb_free)
 
 // delay
 // delay buffer size; maximum size allowed for a delay
 #define SF_REVERB_DS        9814
 typedef struct {
-	int pos;                 // current write position
-	int size;                // delay size
-	float buf[SF_REVERB_DS]; // delay buffer
+	int pos;    // current write position
+	int size;   // delay size
+	float *buf; // delay buffer (points into the reverb arena)
 } sf_rv_delay_st;
 
 // 1st order IIR filter
@@ -115,12 +121,14 @@ typedef struct {
 	float y2;
 } sf_rv_dccut_st;
 
-// fractal noise cache
-// noise buffer size; must be a power of 2 because it's generated via fractal generator
+// fractal noise
+// noise table size; must be a power of 2 because it's generated via fractal generator
+// the table is generated once and shared by every state; each state only keeps its read position,
+// which moves SF_REVERB_NSTEP samples on each time the state is populated
 #define SF_REVERB_NS        (1<<15)
+#define SF_REVERB_NSTEP     12289
 typedef struct {
-	int pos;                 // current read position in the buffer
-	float buf[SF_REVERB_NS]; // buffer filled with noise
+	int pos; // current read position in the shared table
 } sf_rv_noise_st;
 
 // low-frequency oscilator (LFO)
@@ -140,7 +148,7 @@ typedef struct {
 	int size;
 	float feedback;
 	float decay;
-	float buf[SF_REVERB_APS];
+	float *buf;
 } sf_rv_allpass_st;
 
 // 2nd order all-pass filter
@@ -148,12 +156,12 @@ typedef struct {
 #define SF_REVERB_AP2S1     11437
 #define SF_REVERB_AP2S2     3449
 typedef struct {
-	//    line 1                 line 2
-	int   pos1                 , pos2                 ;
-	int   size1                , size2                ;
-	float feedback1            , feedback2            ;
-	float decay1               , decay2               ;
-	float buf1[SF_REVERB_AP2S1], buf2[SF_REVERB_AP2S2];
+	//     line 1    line 2
+	int    pos1     , pos2     ;
+	int    size1    , size2    ;
+	float  feedback1, feedback2;
+	float  decay1   , decay2   ;
+	float *buf1     ,*buf2     ;
 } sf_rv_allpass2_st;
 
 // 3rd order all-pass filter with modulation
@@ -163,12 +171,12 @@ typedef struct {
 #define SF_REVERB_AP3S2     4597
 #define SF_REVERB_AP3S3     7541
 typedef struct {
-	//    line 1 (with modulation)                 line 2                 line 3
-	int   rpos1, wpos1                           , pos2                 , pos3                 ;
-	int   size1, msize1                          , size2                , size3                ;
-	float feedback1                              , feedback2            , feedback3            ;
-	float decay1                                 , decay2               , decay3               ;
-	float buf1[SF_REVERB_AP3S1 + SF_REVERB_AP3M1], buf2[SF_REVERB_AP3S2], buf3[SF_REVERB_AP3S3];
+	//     line 1 (with modulation)  line 2     line 3
+	int    rpos1, wpos1            , pos2     , pos3     ;
+	int    size1, msize1           , size2    , size3    ;
+	float  feedback1               , feedback2, feedback3;
+	float  decay1                  , decay2   , decay3   ;
+	float *buf1                    ,*buf2     ,*buf3     ; // buf1 holds size1 (incl. mod) floats
 } sf_rv_allpass3_st;
 
 // modulated all-pass filter
@@ -181,7 +189,7 @@ typedef struct {
 	float feedback;
 	float decay;
 	float z1;
-	float buf[SF_REVERB_APMS + SF_REVERB_APMM];
+	float *buf; // holds size (incl. mod) floats
 } sf_rv_allpassm_st;
 
 // comb filter
@@ -190,13 +198,15 @@ typedef struct {
 typedef struct {
 	int pos;
 	int size;
-	float buf[SF_REVERB_CS];
+	float *buf;
 } sf_rv_comb_st;
 
 //
 // the final reverb state structure
 //
-// note: this is about 2megs, so you might not want to throw these around willy-nilly
+// note: the structure itself is small; the delay lines live in the
+// arena, which is allocated via sf_malloc when a preset is applied and only grows if a later preset
+// needs more room than the current arena holds
 typedef struct {
 	sf_rv_earlyref_st   earlyref;
 	sf_rv_oversample_st oversampleL, oversampleR;
@@ -232,6 +242,9 @@ typedef struct {
 	float ertolate; // early reflection mix parameters
 	float erefwet;
 	float dry;
+	float *arena;   // cache line aligned storage for every delay line above
+	void *arenamem; // raw allocation backing the arena
+	int arenasize;  // capacity of the arena, in floats
 } sf_reverb_state_st;
 
 typedef enum {
@@ -256,11 +269,31 @@ typedef enum {
 	SF_REVERB_PRESET_LONGREVERB2
 } sf_reverb_preset;
 
+// the state must be zeroed before it is populated for the first time; after that, it can be
+// re-populated any number of times, and the arena is reused whenever it is big enough
+//
+// the first call to either function also generates the shared noise table, so that first call must
+// not race with another one on a different thread
+//
+// both functions return false if the arena couldn't be allocated, in which case the state must not
+// be processed
+
 // populate a reverb state with a preset
-void sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
+bool sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
+
+// the parameters behind a preset, with the same meaning and ranges as the arguments of
+// sf_advancereverb below (useful for driving other reverb algorithms from the same presets)
+typedef struct {
+	int oversamplefactor;
+	float ertolate, erefwet, dry, ereffactor, erefwidth, width, wet, wander, bassb, spin;
+	float inputlpf, basslpf, damplpf, outputlpf, rt60, delay;
+} sf_reverb_params_st;
+
+// look up the parameters of a preset; returns false for an unknown preset
+bool sf_reverb_presetparams(sf_reverb_preset preset, sf_reverb_params_st *params);
 
 // populate a reverb state with advanced parameters
-void sf_advancereverb(sf_reverb_state_st *rv,
+bool sf_advancereverb(sf_reverb_state_st *rv,
 	int rate,             // input sample rate (samples per second)
 	int oversamplefactor, // how much to oversample [1 to 4]
 	float ertolate,       // early reflection amount [0 to 1]
@@ -286,4 +319,14 @@ void sf_advancereverb(sf_reverb_state_st *rv,
 void sf_reverb_process(sf_reverb_state_st *state, int size, sf_sample_st *input,
 	sf_sample_st *output);
 
+// make sure the arena holds at least floats samples of delay line without shrinking it; reserving
+// the largest arena any preset needs up front means later presets never allocate
+bool sf_reverb_reserve(sf_reverb_state_st *state, int floats);
+
+// the bytes sf_reverb_reserve asks sf_malloc for (the arena is aligned to a cache line by hand)
+size_t sf_reverb_reservebytes(int floats);
+
+// release the arena owned by a reverb state; it must be populated again before further processing
+void sf_reverb_free(sf_reverb_state_st *state);
+
 #endif // SNDFILTER_REVERB__H
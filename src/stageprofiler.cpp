@@ -0,0 +1,78 @@
+#include "stageprofiler.h"
+#include <algorithm>
+#include <cassert>
+
+StageProfiler::StageProfiler()
+{
+    mNumSlots = 0;
+    for (int i = 0; i < MAX_SLOTS; i++) {
+        mPending[i] = 0;
+        for (uint32_t j = 0; j < RING_SIZE; j++) {
+            mRing[i][j].store(0, std::memory_order_relaxed);
+        }
+    }
+    mWrite.store(0);
+    mCalibrateTicks = now();
+    mCalibrateTime = Clock::now();
+}
+
+int StageProfiler::add(const std::string &name)
+{
+    assert(mNumSlots < MAX_SLOTS);
+    mNames[mNumSlots] = name;
+    return mNumSlots++;
+}
+
+void StageProfiler::commit()
+{
+    uint32_t w = mWrite.load(std::memory_order_relaxed);
+    uint32_t pos = w & (RING_SIZE - 1);
+    for (int i = 0; i < mNumSlots; i++) {
+        uint64_t ticks = std::min<uint64_t>(mPending[i], UINT32_MAX);
+        mRing[i][pos].store((uint32_t)ticks, std::memory_order_relaxed);
+        mPending[i] = 0;
+    }
+    mWrite.store(w + 1, std::memory_order_release);
+}
+
+// The tick rate is measured against steady_clock over the whole run, so it
+// gets more precise the longer the program runs.  It is 0, unknown, for the
+// first CALIBRATE_SECONDS rather than wait on the UI thread.
+double StageProfiler::ticksPerSecond()
+{
+#if defined(ROGOSYNTH_RDTSC)
+    double seconds = std::chrono::duration<double>(Clock::now() - mCalibrateTime).count();
+    if (seconds < CALIBRATE_SECONDS) {
+        return 0.0;
+    }
+    return (double)(now() - mCalibrateTicks) / seconds;
+#else
+    return 1.0e9;
+#endif
+}
+
+StageProfiler::Summary StageProfiler::summary(int slot)
+{
+    Summary s = {0.0f, 0.0f, 0.0f};
+    uint32_t w = mWrite.load(std::memory_order_acquire);
+    uint32_t n = std::min(w, HISTORY);
+    double rate = ticksPerSecond();
+    if (n == 0 || rate == 0.0) {
+        return s;
+    }
+    uint32_t v[HISTORY];
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        v[i] = mRing[slot][(w - n + i) & (RING_SIZE - 1)].load(std::memory_order_relaxed);
+        sum += v[i];
+    }
+    uint32_t k = (uint32_t)(0.99 * (n - 1));
+    std::nth_element(v, v + k, v + n);
+    uint32_t p99 = v[k];
+    uint32_t max = *std::max_element(v + k, v + n);
+    double us = 1.0e6 / rate;
+    s.avg = (float)(us * sum / n);
+    s.p99 = (float)(us * p99);
+    s.max = (float)(us * max);
+    return s;
+}
@@ -0,0 +1,81 @@
+#ifndef ROGOSYNTH_STAGEPROFILER_H
+#define ROGOSYNTH_STAGEPROFILER_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ROGOSYNTH_RDTSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define ROGOSYNTH_RDTSC 1
+#endif
+
+// Always-on profiler for the stages of one audio callback.  The audio thread
+// times each stage with lap() and publishes the whole callback with
+// commit(); every slot keeps a ring of per-callback times that the UI
+// thread summarizes without ever blocking the audio thread.  A reading that
+// races with a commit may mix two callbacks, which is harmless for rolling
+// statistics.
+class StageProfiler {
+  public:
+    static const int MAX_SLOTS = 32;
+    // callbacks summarized (~12s at 2048 frames and 44.1kHz)
+    static const uint32_t HISTORY = 256;
+    struct Summary {
+        float avg, p99, max; // microseconds
+    };
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // twice HISTORY, so the window being read is never the one being written
+    static const uint32_t RING_SIZE = 2 * HISTORY;
+    // steady_clock time before the tick rate is trusted
+    static constexpr double CALIBRATE_SECONDS = 0.05;
+
+    int mNumSlots;
+    std::string mNames[MAX_SLOTS];
+    uint64_t mPending[MAX_SLOTS]; // audio thread only
+    std::atomic<uint32_t> mRing[MAX_SLOTS][RING_SIZE];
+    std::atomic<uint32_t> mWrite;
+    // relate ticks to seconds (UI thread only)
+    uint64_t mCalibrateTicks;
+    Clock::time_point mCalibrateTime;
+
+  public:
+    StageProfiler();
+    // setup: name a new slot and return its index
+    int add(const std::string &name);
+
+    // CPU cycles where there is a cheap counter, nanoseconds otherwise
+    static inline uint64_t now()
+    {
+#if defined(ROGOSYNTH_RDTSC)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+    // audio thread: charge the time since start to slot and return now, so
+    // consecutive stages can chain their laps
+    inline uint64_t lap(int slot, uint64_t start)
+    {
+        uint64_t t = now();
+        mPending[slot] += t - start;
+        return t;
+    }
+    // audio thread: publish this callback's times and start the next
+    void commit();
+
+    // UI thread
+    int numSlots() { return mNumSlots; }
+    const std::string &name(int slot) { return mNames[slot]; }
+    // all zero until the tick rate is known
+    Summary summary(int slot);
+    double ticksPerSecond();
+};
+#endif
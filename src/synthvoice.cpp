@@ -1,19 +1,10 @@
 #include "synthvoice.h"
+#include "simd.h"
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <cstring>
 
-static float getFrequency(float note)
-{
-    // FIXME redo note indexes to match midi 69 = A4, not 57
-    // Calculate pitch from note value.
-    // offset note by 57 halfnotes to get correct pitch from the range we have
-    // chosen for the notes.
-    float p = pow(CHROMATIC_BASE, note - 57);
-    p *= 440;
-    return p;
-}
-
 #ifndef NDEBUG
 void reportTableMinMax(float *waveTable, std::string name)
 {
@@ -106,22 +97,54 @@ float *SynthVoice::cSawtoothWaveTable = generateSawtoothWaveTable();
 float *SynthVoice::cSquareWaveTable = generateSquareWaveTable();
 float *SynthVoice::cTriangleWaveTable = generateTriangleWaveTable();
 
-SynthVoice::SynthVoice(float amp) : mAmplitude(amp)
+SynthVoice::SynthVoice(float amp, const Tuning *tuning, const ModMatrix *mod,
+                       const FmPatch *fm, const Wavetable *wavetable, int index)
+    : mAmplitude(amp), mTuning(tuning), mMod(mod), mIndex(index), mFm(fm),
+      mWavetable(wavetable)
 {
     mType = WaveType::sawtooth;
     mCurPhase = 0;
     mCurTime = 0.0;
     mPitch = MIN_NOTE;
+    mPan = 0.0f;
+    mUnison = 1;
+    mDetune = 20.0f;
+    mSpread = 0.5f;
+    std::fill(mUnisonPhase, mUnisonPhase + MAX_UNISON, 0.0f);
+    mUnisonCount = 0; // nothing cached yet
     mEnvelope.attack(0.2f);
     mEnvelope.decay(0.2f);
     mEnvelope.sustain(0.8f);
     mEnvelope.release(0.2f);
+    mModEnvelope.attack(1.0f);
+    mModEnvelope.decay(1.0f);
+    mModEnvelope.sustain(0.5f);
+    mModEnvelope.release(1.0f);
+    mPitchRatio = mAmpMod = mPanL = mPanR = 1.0f;
+    mPitchTarget = mPanLTarget = mPanRTarget = 1.0f;
+    mPitchStep = mAmpStep = mPanLStep = mPanRStep = 0.0f;
+    mLastSemitones = 0.0f;
+    mLastPan = 0.0f;
+    mModSnap = true;
 }
 
-void SynthVoice::noteOn(int pitch)
+void SynthVoice::noteOn(int pitch, const Sample *sample)
 {
     mPitch = std::clamp(pitch, MIN_NOTE, MAX_NOTE);
     mEnvelope.noteOn(mCurTime);
+    mModEnvelope.noteOn(mCurTime);
+    mFm.noteOn(mCurTime);
+    mSampler.noteOn(sample);
+    mWavetable.noteOn();
+    // a new note starts at its modulated values instead of gliding there
+    mModSnap = true;
+    // Start the unison oscillators spread over the cycle (golden ratio
+    // steps) so they don't sum to a spike on every note-on.  This is
+    // deterministic, so a rendered note always sounds the same.
+    for (int i = 0; i < MAX_UNISON; i++) {
+        float frac = i * 0.618034f;
+        mUnisonPhase[i] = (frac - (int)frac) * TABLE_LENGTH;
+    }
 #ifndef NDEBUG
     std::cout << "noteOn  " << mPitch << "\n";
 #endif
@@ -130,44 +153,289 @@ void SynthVoice::noteOn(int pitch)
 void SynthVoice::noteOff()
 {
     mEnvelope.noteOff(mCurTime);
+    mModEnvelope.noteOff(mCurTime);
+    mFm.noteOff(mCurTime);
 #ifndef NDEBUG
     std::cout << "noteOff " << mPitch << "\n";
 #endif
 }
 
-// add samples to the samples buffer
-void SynthVoice::addSamples(float *samples, long length)
+void SynthVoice::unison(int v) { mUnison = std::clamp(v, 1, MAX_UNISON); }
+
+void SynthVoice::unisonSpread(float v) { mSpread = std::clamp(v, 0.0f, 1.0f); }
+
+const float *SynthVoice::waveTable()
+{
+    switch (mType) {
+    case WaveType::sine:
+        return SynthVoice::cSineWaveTable;
+    case WaveType::square:
+        return SynthVoice::cSquareWaveTable;
+    case WaveType::triangle:
+        return SynthVoice::cTriangleWaveTable;
+    default:
+        return SynthVoice::cSawtoothWaveTable;
+    }
+}
+
+// From Supercollider doc: Two channel equal power panner. Pan2 takes the square
+// root of the linear scaling factor going from 1 (left or right) to 0.5.sqrt
+// (~=0.707) in the center, which is about 3dB reduction.  Avoids problem
+// inherent to linear panning is that the perceived volume of the signal drops
+// in the middle.
+static void panGains(float pan, float &left, float &right)
 {
-    // get correct phase increment for note depending on sample rate and
-    // table length.
-    float phase_inc =
-        (getFrequency((float)mPitch) / SAMPLE_RATE) * TABLE_LENGTH;
-
-    // loop through the buffer and write samples.
-    float waveSample = 0.0f;
-    for (int i = 0; i < length; i += 2) {
-        switch (mType) {
-        case WaveType::sine:
-            waveSample = SynthVoice::cSineWaveTable[(int)mCurPhase];
-            break;
-        case WaveType::sawtooth:
-            waveSample = SynthVoice::cSawtoothWaveTable[(int)mCurPhase];
-            break;
-        case WaveType::square:
-            waveSample = SynthVoice::cSquareWaveTable[(int)mCurPhase];
-            break;
-        case WaveType::triangle:
-            waveSample = SynthVoice::cTriangleWaveTable[(int)mCurPhase];
-            break;
+    left = sqrtf((1.0f - pan) / 2.0f);
+    right = sqrtf((1.0f + pan) / 2.0f);
+}
+
+// Evaluate the modulation for control tick t and aim the per sample ramps
+// at it.  The transcendental functions only run when their input changed.
+void SynthVoice::controlTick(int t)
+{
+    float modEnv = mModEnvelope.amplitude(mCurTime);
+    float semitones = mMod->global(ModSource::pitchBend, t) * mTuning->bendRange() +
+                      mMod->evaluate(ModDest::pitch, t, mIndex, modEnv);
+    if (semitones != mLastSemitones || mModSnap) {
+        mPitchTarget = exp2f(semitones / 12.0f);
+        mLastSemitones = semitones;
+    }
+    float amp = std::max(0.0f, 1.0f + mMod->evaluate(ModDest::amplitude, t, mIndex, modEnv));
+    float pan = std::clamp(mPan + mMod->evaluate(ModDest::pan, t, mIndex, modEnv), -1.0f, 1.0f);
+    if (pan != mLastPan || mModSnap) {
+        panGains(pan, mPanLTarget, mPanRTarget);
+        mLastPan = pan;
+    }
+    if (mType == WaveType::fm) {
+        mFm.controlTick(mCurTime, mModSnap);
+    }
+    if (mType == WaveType::wavetable) {
+        mWavetable.controlTick(mMod->evaluate(ModDest::position, t, mIndex, modEnv), mModSnap);
+    }
+    if (mModSnap) {
+        mPitchRatio = mPitchTarget;
+        mAmpMod = amp;
+        mPanL = mPanLTarget;
+        mPanR = mPanRTarget;
+        mModSnap = false;
+    }
+    const float step = 1.0f / CONTROL_RATE;
+    mPitchStep = (mPitchTarget - mPitchRatio) * step;
+    mAmpStep = (amp - mAmpMod) * step;
+    mPanLStep = (mPanLTarget - mPanL) * step;
+    mPanRStep = (mPanRTarget - mPanR) * step;
+}
+
+// Detune ratios and stereo gains of the unison oscillators.  Oscillator i
+// is detuned linearly from -detune to +detune cents and panned the same
+// way, scaled by spread, around the voice's own pan (so 1 in the center).
+// The sum is normalized by 1/sqrt(count) since the detuned copies are
+// uncorrelated.  Only recomputed when the settings change.
+void SynthVoice::updateUnison(int count)
+{
+    if (count == mUnisonCount && mDetune == mUnisonDetune && mSpread == mUnisonSpread) {
+        return;
+    }
+    mUnisonCount = count;
+    mUnisonDetune = mDetune;
+    mUnisonSpread = mSpread;
+    const float norm = 1.0f / sqrtf((float)count);
+    for (int i = 0; i < MAX_UNISON; i++) {
+        if (i >= count) {
+            mUnisonRatio[i] = 0.0f;
+            mUnisonGainL[i] = mUnisonGainR[i] = 0.0f;
+            continue;
         }
-        float envAmp = mEnvelope.amplitude(mCurTime);
-        float sample = mAmplitude * envAmp * (float)waveSample; // scale volume.
-        samples[i] += sample;                                   // left channel
-        samples[i + 1] += sample;                               // right channel
-        mCurTime += SAMPLE_PERIOD;
-        mCurPhase += phase_inc;
+        float pos = (count == 1) ? 0.0f : 2.0f * i / (count - 1) - 1.0f;
+        mUnisonRatio[i] = exp2f(pos * mUnisonDetune / 1200.0f);
+        panGains(pos * mUnisonSpread, mUnisonGainL[i], mUnisonGainR[i]);
+        mUnisonGainL[i] *= (float)M_SQRT2 * norm;
+        mUnisonGainR[i] *= (float)M_SQRT2 * norm;
+    }
+}
+
+void SynthVoice::renderSingle(float *samples, int frames, const float *table, const Ramps &r)
+{
+    for (int f = 0; f < frames; f++) {
+        float sample = table[(int)mCurPhase] * r.gain[f];
+        samples[2 * f] += sample * r.left[f];      // left channel
+        samples[2 * f + 1] += sample * r.right[f]; // right channel
+        mCurPhase += r.increment[f];
         if (mCurPhase >= TABLE_LENGTH) {
             mCurPhase = mCurPhase - TABLE_LENGTH;
         }
     }
 }
+
+// Unison rendering.  The sub-oscillators run in groups of 4 SIMD lanes:
+// phase advance, wrap and the stereo gains are vector operations, only the
+// table lookup is 4 scalar loads.  Each frame's lanes are summed and scaled
+// by the voice's gain and pan once, so going from 4 to 16 oscillators adds
+// little more than the lookups.
+void SynthVoice::renderUnison(float *samples, int frames, const float *table, const Ramps &r,
+                              int count)
+{
+    const int groups = (count + 3) / 4;
+#if defined(ROGOSYNTH_SSE)
+    __m128 phase[MAX_UNISON / 4], ratio[MAX_UNISON / 4];
+    __m128 gainL[MAX_UNISON / 4], gainR[MAX_UNISON / 4];
+    for (int g = 0; g < groups; g++) {
+        phase[g] = _mm_load_ps(mUnisonPhase + 4 * g);
+        ratio[g] = _mm_load_ps(mUnisonRatio + 4 * g);
+        gainL[g] = _mm_load_ps(mUnisonGainL + 4 * g);
+        gainR[g] = _mm_load_ps(mUnisonGainR + 4 * g);
+    }
+    const __m128 tableLength = _mm_set1_ps((float)TABLE_LENGTH);
+    alignas(16) int32_t index[4];
+    for (int f = 0; f < frames; f++) {
+        __m128 left = _mm_setzero_ps(), right = _mm_setzero_ps();
+        __m128 inc = _mm_set1_ps(r.increment[f]);
+        for (int g = 0; g < groups; g++) {
+            _mm_store_si128((__m128i *)index, _mm_cvttps_epi32(phase[g]));
+            __m128 wave = _mm_set_ps(table[index[3]], table[index[2]],
+                                     table[index[1]], table[index[0]]);
+            left = _mm_add_ps(left, _mm_mul_ps(wave, gainL[g]));
+            right = _mm_add_ps(right, _mm_mul_ps(wave, gainR[g]));
+            __m128 p = _mm_add_ps(phase[g], _mm_mul_ps(ratio[g], inc));
+            phase[g] = _mm_sub_ps(p, _mm_and_ps(_mm_cmpge_ps(p, tableLength), tableLength));
+        }
+        // horizontal sums: (l0+l2, r0+r2, l1+l3, r1+r3) then fold the halves
+        __m128 lr = _mm_add_ps(_mm_unpacklo_ps(left, right), _mm_unpackhi_ps(left, right));
+        lr = _mm_add_ps(lr, _mm_movehl_ps(lr, lr));
+        alignas(16) float sum[4];
+        _mm_store_ps(sum, lr);
+        samples[2 * f] += sum[0] * r.gain[f] * r.left[f];
+        samples[2 * f + 1] += sum[1] * r.gain[f] * r.right[f];
+    }
+    for (int g = 0; g < groups; g++) {
+        _mm_store_ps(mUnisonPhase + 4 * g, phase[g]);
+    }
+#elif defined(ROGOSYNTH_NEON)
+    float32x4_t phase[MAX_UNISON / 4], ratio[MAX_UNISON / 4];
+    float32x4_t gainL[MAX_UNISON / 4], gainR[MAX_UNISON / 4];
+    for (int g = 0; g < groups; g++) {
+        phase[g] = vld1q_f32(mUnisonPhase + 4 * g);
+        ratio[g] = vld1q_f32(mUnisonRatio + 4 * g);
+        gainL[g] = vld1q_f32(mUnisonGainL + 4 * g);
+        gainR[g] = vld1q_f32(mUnisonGainR + 4 * g);
+    }
+    const float32x4_t tableLength = vdupq_n_f32((float)TABLE_LENGTH);
+    int32_t index[4];
+    for (int f = 0; f < frames; f++) {
+        float32x4_t left = vdupq_n_f32(0.0f), right = vdupq_n_f32(0.0f);
+        for (int g = 0; g < groups; g++) {
+            vst1q_s32(index, vcvtq_s32_f32(phase[g]));
+            float32x4_t wave = vdupq_n_f32(table[index[0]]);
+            wave = vsetq_lane_f32(table[index[1]], wave, 1);
+            wave = vsetq_lane_f32(table[index[2]], wave, 2);
+            wave = vsetq_lane_f32(table[index[3]], wave, 3);
+            left = vmlaq_f32(left, wave, gainL[g]);
+            right = vmlaq_f32(right, wave, gainR[g]);
+            float32x4_t p = vmlaq_n_f32(phase[g], ratio[g], r.increment[f]);
+            uint32x4_t wrap = vandq_u32(vcgeq_f32(p, tableLength),
+                                        vreinterpretq_u32_f32(tableLength));
+            phase[g] = vsubq_f32(p, vreinterpretq_f32_u32(wrap));
+        }
+        float32x2_t l = vadd_f32(vget_low_f32(left), vget_high_f32(left));
+        float32x2_t rr = vadd_f32(vget_low_f32(right), vget_high_f32(right));
+        float32x2_t lr = vpadd_f32(l, rr);
+        samples[2 * f] += vget_lane_f32(lr, 0) * r.gain[f] * r.left[f];
+        samples[2 * f + 1] += vget_lane_f32(lr, 1) * r.gain[f] * r.right[f];
+    }
+    for (int g = 0; g < groups; g++) {
+        vst1q_f32(mUnisonPhase + 4 * g, phase[g]);
+    }
+#else
+    for (int f = 0; f < frames; f++) {
+        float left = 0.0f, right = 0.0f;
+        for (int i = 0; i < count; i++) {
+            float wave = table[(int)mUnisonPhase[i]];
+            left += wave * mUnisonGainL[i];
+            right += wave * mUnisonGainR[i];
+            mUnisonPhase[i] += mUnisonRatio[i] * r.increment[f];
+            if (mUnisonPhase[i] >= TABLE_LENGTH) {
+                mUnisonPhase[i] -= TABLE_LENGTH;
+            }
+        }
+        samples[2 * f] += left * r.gain[f] * r.left[f];
+        samples[2 * f + 1] += right * r.gain[f] * r.right[f];
+    }
+#endif
+}
+
+// add samples to the samples buffer; frame is where samples starts in the
+// engine's current buffer, which is how control ticks line up across voices
+// and across the pieces a buffer is rendered in.
+void SynthVoice::addSamples(float *samples, long length, int frame)
+{
+    const int frames = (int)(length / 2);
+    // the tuning table has the phase increment for the note at our sample
+    // rate, in cycles per sample
+    const float baseInc = mTuning->increment(mPitch) * TABLE_LENGTH;
+    // keep below Nyquist however far modulation pushes it (this also keeps
+    // the phase wrap to a single subtraction, even with unison detune)
+    const float maxInc = 0.5f * TABLE_LENGTH;
+    const float *table = waveTable();
+    // a sample plays at its own pitch at its root note's increment
+    float incrementToStep = 0.0f;
+    if (const Sample *sample = mSampler.sample()) {
+        incrementToStep = (float)sample->info().sampleRate / SAMPLE_RATE /
+                          (mTuning->increment(sample->rootNote()) * TABLE_LENGTH);
+    }
+    const int count = mUnison;
+    if (count > 1) {
+        updateUnison(count);
+    }
+
+    int done = 0;
+    while (done < frames) {
+        int f = frame + done;
+        if (mModSnap || f % CONTROL_RATE == 0) {
+            controlTick(f / CONTROL_RATE);
+        }
+        // up to the next tick, stepping the ramps per sample
+        int n = std::min(frames - done, CONTROL_RATE - f % CONTROL_RATE);
+        // a finished FM, sample or wavetable voice is silent until the next
+        // note on, which restarts it, so it needn't run
+        const bool fmRender = (mType == WaveType::fm) && active();
+        const bool sampleRender = (mType == WaveType::sample) && active();
+        const bool wavetableRender = (mType == WaveType::wavetable) && active();
+        Ramps r;
+        for (int i = 0; i < n; i++) {
+            r.gain[i] = mAmplitude * mEnvelope.amplitude(mCurTime) * mAmpMod;
+            r.increment[i] = std::min(baseInc * mPitchRatio, maxInc);
+            r.left[i] = mPanL;
+            r.right[i] = mPanR;
+            mCurTime += SAMPLE_PERIOD;
+            mAmpMod += mAmpStep;
+            mPitchRatio += mPitchStep;
+            mPanL += mPanLStep;
+            mPanR += mPanRStep;
+        }
+        if (mType == WaveType::fm) {
+            if (fmRender) {
+                mFm.addSamples(samples + 2 * done, n, TABLE_LENGTH, r.increment, r.gain, r.left,
+                               r.right);
+            }
+        }
+        else if (mType == WaveType::wavetable) {
+            if (wavetableRender) {
+                mWavetable.addSamples(samples + 2 * done, n, TABLE_LENGTH, r.increment, r.gain,
+                                      r.left, r.right);
+            }
+        }
+        else if (mType == WaveType::sample) {
+            if (sampleRender) {
+                mSampler.addSamples(samples + 2 * done, n, r.increment, incrementToStep, r.gain,
+                                    r.left, r.right);
+            }
+        }
+        else if (count > 1) {
+            renderUnison(samples + 2 * done, n, table, r, count);
+        }
+        else {
+            renderSingle(samples + 2 * done, n, table, r);
+        }
+        done += n;
+    }
+}
@@ -2,16 +2,24 @@
 #define ROGOSYNTH_SYNTHVOICE_H
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include "constants.h"
 #include "envelope.h"
+#include "fm.h"
+#include "modmatrix.h"
+#include "sampleplayer.h"
+#include "tuning.h"
+#include "wavetable.h"
 
-const int MIN_NOTE = 12;
-const int MAX_NOTE = 131;
+// MIDI note numbers
+const int MIN_NOTE = 0;
+const int MAX_NOTE = Tuning::NUM_NOTES - 1;
 const int TABLE_LENGTH = 1024;
+const int MAX_UNISON = 16;
 
-enum class WaveType { sine, sawtooth, square, triangle };
+enum class WaveType { sine, sawtooth, square, triangle, fm, sample, wavetable };
 
 class SynthVoice {
     static float *cSineWaveTable;
@@ -23,21 +31,86 @@ class SynthVoice {
     float mCurPhase;
     float mCurTime;
     int mPitch;
+    const Tuning *mTuning; // shared by the engine's voices
+    const ModMatrix *mMod; // likewise
+    int mIndex;            // the voice's lane in the modulation
     Envelope mEnvelope;
+    Envelope mModEnvelope;
+
+    float mPan; // -1..1, the voice's place before modulation
+
+    // modulation, ramped per sample towards the values of the latest
+    // control tick
+    float mPitchRatio, mPitchStep;
+    float mAmpMod, mAmpStep;
+    float mPanL, mPanLStep, mPanR, mPanRStep;
+    // targets are only recomputed when their inputs change
+    float mPitchTarget, mPanLTarget, mPanRTarget;
+    float mLastSemitones, mLastPan;
+    bool mModSnap; // jump straight to the next tick's values (note on)
+
+    // unison: detuned copies of the oscillator spread across the stereo
+    // field, rendered 4 at a time in SIMD lanes
+    int mUnison;
+    float mDetune; // cents between the outermost oscillators and the note
+    float mSpread; // 0 = all centered, 1 = outermost hard left/right
+    // what the ratios and gains were computed for
+    int mUnisonCount;
+    float mUnisonDetune, mUnisonSpread;
+    alignas(16) float mUnisonPhase[MAX_UNISON];
+    alignas(16) float mUnisonRatio[MAX_UNISON];
+    alignas(16) float mUnisonGainL[MAX_UNISON];
+    alignas(16) float mUnisonGainR[MAX_UNISON];
+
+    // the FM operators, used instead of the wavetables (and unison) when the
+    // type is fm; they follow every note so switching type mid-note works
+    // from the next note on
+    FmVoice mFm;
+    // likewise the sample the engine picked for the note, when the type is
+    // sample
+    SamplePlayer mSampler;
+    // and the imported wavetable's oscillator
+    WavetableVoice mWavetable;
+
+    // per sample values up to the next control tick
+    struct Ramps {
+        float gain[CONTROL_RATE];      // amplitude * envelope * modulation
+        float increment[CONTROL_RATE]; // phase increment
+        float left[CONTROL_RATE], right[CONTROL_RATE];
+    };
+
+    const float *waveTable();
+    void controlTick(int t);
+    void updateUnison(int count);
+    void renderSingle(float *samples, int frames, const float *table, const Ramps &r);
+    void renderUnison(float *samples, int frames, const float *table, const Ramps &r,
+                      int count);
 
   public:
-    SynthVoice(float amp);
+    SynthVoice(float amp, const Tuning *tuning, const ModMatrix *mod, const FmPatch *fm,
+               const Wavetable *wavetable, int index);
     // main controls
-    void noteOn(int pitch);
+    // sample is what the sample type plays for the note; null for silence
+    void noteOn(int pitch, const Sample *sample = nullptr);
     void noteOff();
+    // before audio starts, once a sample needs streaming
+    void enableStreaming() { mSampler.enableStreaming(); }
     // workhorse routine
-    void addSamples(float *samples, long length);
+    void addSamples(float *samples, long length, int frame);
     // getters, setters
     float amplitude() { return mAmplitude; }
     void amplitude(float v) { mAmplitude = v; }
     int pitch() { return mPitch; }
     WaveType type() { return mType; }
     void type(WaveType v) { mType = v; }
+    int unison() { return mUnison; }
+    void unison(int v);
+    float unisonDetune() { return mDetune; }
+    void unisonDetune(float v) { mDetune = std::clamp(v, 0.0f, 100.0f); }
+    float unisonSpread() { return mSpread; }
+    void unisonSpread(float v);
+    float pan() { return mPan; }
+    void pan(float v) { mPan = std::clamp(v, -1.0f, 1.0f); }
     void attack(float v) { mEnvelope.attack(v); }
     float attack() { return mEnvelope.attack(); }
     void decay(float v) { mEnvelope.decay(v); }
@@ -46,6 +119,7 @@ class SynthVoice {
     float sustain() { return mEnvelope.sustain(); }
     void release(float v) { mEnvelope.release(v); }
     float release() { return mEnvelope.release(); }
+    Envelope &modEnvelope() { return mModEnvelope; }
     bool active() { return mEnvelope.active(mCurTime); }
     bool releasing() { return mEnvelope.releasing(mCurTime); }
 };
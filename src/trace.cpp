@@ -0,0 +1,122 @@
+#include "trace.h"
+#include "minitrace/minitrace.h"
+#include <cstdint>
+#include <iostream>
+
+// minitrace needs a thread id for the events we hand it on the audio
+// thread's behalf; any value that won't collide with a real one will do.
+static const int AUDIO_THREAD_ID = 0x0a0d10;
+
+Trace::Event Trace::cRing[Trace::RING_SIZE];
+std::atomic<uint32_t> Trace::cWrite{0};
+std::atomic<uint32_t> Trace::cRead{0};
+std::atomic<uint64_t> Trace::cDropped{0};
+std::atomic<bool> Trace::cActive{false};
+thread_local bool Trace::tAudioThread = false;
+std::string Trace::cPath;
+int Trace::cCaptures = 0;
+double Trace::cLastFlush = 0.0;
+
+bool Trace::start(const std::string &path)
+{
+    if (active()) {
+        return true;
+    }
+    cPath = path;
+    if (++cCaptures > 1) {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            dot = path.size();
+        }
+        cPath = path.substr(0, dot) + "-" + std::to_string(cCaptures) + path.substr(dot);
+    }
+    FILE *f = fopen(cPath.c_str(), "wb");
+    if (f == NULL) {
+        std::cerr << "ERROR: Couldn't open trace file " << cPath << "\n";
+        return false;
+    }
+    mtr_init_from_stream(f);
+    internal_mtr_raw_event_at("", "thread_name", 'M', mtr_time_s(), AUDIO_THREAD_ID,
+                              MTR_ARG_TYPE_STRING_CONST, "name", (void *)"audio");
+    // skip whatever the audio thread left behind since the last capture
+    cRead.store(cWrite.load(std::memory_order_acquire), std::memory_order_release);
+    cDropped.store(0);
+    cLastFlush = mtr_time_s();
+    cActive.store(true);
+    std::cout << "tracing to " << cPath << "\n";
+    return true;
+}
+
+void Trace::stop()
+{
+    if (!active()) {
+        return;
+    }
+    cActive.store(false);
+    drainRing();
+    mtr_shutdown();
+    std::cout << "trace written to " << cPath;
+    if (cDropped.load() > 0) {
+        std::cout << " (" << cDropped.load() << " audio events dropped)";
+    }
+    std::cout << "\n";
+}
+
+void Trace::event(const char *category, const char *name, char ph, int value)
+{
+    if (!tAudioThread) {
+        if (ph == 'C') {
+            internal_mtr_raw_event_arg(category, name, ph, 0, MTR_ARG_TYPE_INT, name,
+                                       (void *)(intptr_t)value);
+        }
+        else {
+            internal_mtr_raw_event(category, name, ph, 0);
+        }
+        return;
+    }
+    uint32_t w = cWrite.load(std::memory_order_relaxed);
+    if (w - cRead.load(std::memory_order_acquire) >= RING_SIZE) {
+        cDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Event &e = cRing[w & (RING_SIZE - 1)];
+    e.category = category;
+    e.name = name;
+    e.ts = mtr_time_s();
+    e.value = value;
+    e.ph = ph;
+    cWrite.store(w + 1, std::memory_order_release);
+}
+
+void Trace::drainRing()
+{
+    uint32_t r = cRead.load(std::memory_order_relaxed);
+    uint32_t w = cWrite.load(std::memory_order_acquire);
+    for (; r != w; r++) {
+        const Event &e = cRing[r & (RING_SIZE - 1)];
+        if (e.ph == 'C') {
+            internal_mtr_raw_event_at(e.category, e.name, e.ph, e.ts, AUDIO_THREAD_ID,
+                                      MTR_ARG_TYPE_INT, e.name, (void *)(intptr_t)e.value);
+        }
+        else {
+            internal_mtr_raw_event_at(e.category, e.name, e.ph, e.ts, AUDIO_THREAD_ID,
+                                      MTR_ARG_TYPE_NONE, NULL, NULL);
+        }
+    }
+    cRead.store(r, std::memory_order_release);
+}
+
+void Trace::drain()
+{
+    if (!active()) {
+        return;
+    }
+    drainRing();
+    // keep minitrace's in-memory buffer small on long captures
+    double now = mtr_time_s();
+    if (now - cLastFlush > 1.0) {
+        cLastFlush = now;
+        mtr_flush();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef ROGOSYNTH_TRACE_H
+#define ROGOSYNTH_TRACE_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Runtime switchable tracing on top of minitrace.  It is always compiled
+// in; while tracing is off, every TRACE_* macro costs one relaxed atomic
+// load and a branch.
+//
+// minitrace takes a mutex for every event, which the audio thread must
+// never do.  So events from the thread marked with markAudioThread() go into
+// a lock-free single producer/single consumer ring instead, and the UI
+// thread moves them into minitrace (with their original timestamps) from
+// drain() once per frame.
+class Trace {
+    struct Event {
+        const char *category;
+        const char *name;
+        double ts;
+        int value;
+        char ph;
+    };
+    static const uint32_t RING_SIZE = 16384; // power of two
+    static Event cRing[RING_SIZE];
+    static std::atomic<uint32_t> cWrite, cRead;
+    static std::atomic<uint64_t> cDropped;
+    static std::atomic<bool> cActive;
+    static thread_local bool tAudioThread;
+    static std::string cPath;
+    static int cCaptures;
+    static double cLastFlush;
+
+    static void drainRing();
+
+  public:
+    // begin writing a trace to path; a second capture to the same path in
+    // one run gets a numbered name (trace-2.json, ...) instead of
+    // overwriting the first.
+    static bool start(const std::string &path);
+    static void stop();
+    static bool active() { return cActive.load(std::memory_order_relaxed); }
+    // the path of the current (or last) capture
+    static const std::string &path() { return cPath; }
+    // call from the audio thread; cheap enough to do every callback
+    static void markAudioThread() { tAudioThread = true; }
+    static void event(const char *category, const char *name, char ph, int value = 0);
+    // UI thread: move audio thread events into minitrace and flush
+    static void drain();
+};
+
+#define TRACE_BEGIN(c, n)                                                      \
+    do {                                                                       \
+        if (Trace::active()) Trace::event(c, n, 'B');                          \
+    } while (0)
+#define TRACE_END(c, n)                                                        \
+    do {                                                                       \
+        if (Trace::active()) Trace::event(c, n, 'E');                          \
+    } while (0)
+#define TRACE_COUNTER(c, n, v)                                                 \
+    do {                                                                       \
+        if (Trace::active()) Trace::event(c, n, 'C', (int)(v));                \
+    } while (0)
+#endif
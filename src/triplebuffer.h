@@ -0,0 +1,40 @@
+#ifndef ROGOSYNTH_TRIPLEBUFFER_H
+#define ROGOSYNTH_TRIPLEBUFFER_H
+#include <atomic>
+
+// Wait-free handoff of the latest value from one producer thread to one
+// consumer thread.  The producer fills back() and publish()es it; the
+// consumer calls update() and, if it returns true, reads a newer front().
+// Each side owns one of the three buffers and they trade through the
+// third, so neither ever waits for the other or sees a half-written value.
+// Values the consumer doesn't pick up in time are simply overwritten.
+template <typename T> class TripleBuffer {
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4; // the middle buffer hasn't been read yet
+
+    T mBuffers[3];
+    int mBack;  // producer only
+    int mFront; // consumer only
+    std::atomic<int> mMiddle;
+
+  public:
+    TripleBuffer() : mBack(0), mFront(1), mMiddle(2) {}
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // producer
+    T &back() { return mBuffers[mBack]; }
+    void publish() { mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX_MASK; }
+
+    // consumer: true if front() changed
+    bool update()
+    {
+        if (!(mMiddle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T &front() { return mBuffers[mFront]; }
+};
+#endif
@@ -0,0 +1,123 @@
+#include "tuning.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+Tuning::Tuning(int sampleRate)
+    : mSampleRate(sampleRate), mFineTune(0.0f), mBendRange(2.0f)
+{
+    equalTemperament();
+}
+
+// Recompute every note.  Called from the UI thread; the audio thread may
+// see a mix of old and new notes for one buffer, as with any parameter.
+void Tuning::build()
+{
+    double root = 440.0 * pow(2.0, (REFERENCE_NOTE - 69 + mFineTune / 100.0) / 12.0);
+    int degrees = (int)mCents.size();
+    double period = mCents.back();
+    for (int note = 0; note < NUM_NOTES; note++) {
+        int steps = note - REFERENCE_NOTE;
+        int octave = (steps >= 0) ? steps / degrees : -((degrees - 1 - steps) / degrees);
+        int degree = steps - octave * degrees;
+        double cents = octave * period + (degree > 0 ? mCents[degree - 1] : 0.0);
+        // a scale with wide steps can put the top notes past Nyquist; hold
+        // them there so an oscillator's phase never steps a whole cycle
+        mIncrement[note] = (float)std::min(root * pow(2.0, cents / 1200.0) / mSampleRate, 0.5);
+    }
+}
+
+void Tuning::equalTemperament()
+{
+    mCents.clear();
+    for (int i = 1; i <= 12; i++) {
+        mCents.push_back(100.0 * i);
+    }
+    mName = "12-TET";
+    build();
+}
+
+// A pitch line is cents if it has a '.', otherwise a ratio like 3/2 or 2.
+// Anything after the value is a comment.
+static bool parseScalaPitch(const std::string &line, double &cents)
+{
+    std::istringstream in(line);
+    std::string value;
+    if (!(in >> value)) {
+        return false;
+    }
+    if (value.find('.') != std::string::npos) {
+        char *end;
+        cents = strtod(value.c_str(), &end);
+        return end != value.c_str();
+    }
+    long num = 0, den = 1;
+    char slash;
+    std::istringstream ratio(value);
+    if (!(ratio >> num) || (ratio >> slash && (slash != '/' || !(ratio >> den)))) {
+        return false;
+    }
+    if (num <= 0 || den <= 0) {
+        return false;
+    }
+    cents = 1200.0 * log2((double)num / den);
+    return true;
+}
+
+bool Tuning::loadScala(const char *path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERROR: Couldn't open " << path << "\n";
+        return false;
+    }
+    std::string line, description;
+    int count = -1, lineNumber = 0;
+    std::vector<double> cents;
+    bool haveDescription = false;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] == '!') {
+            continue;
+        }
+        if (!haveDescription) {
+            description = line;
+            haveDescription = true;
+        }
+        else if (count < 0) {
+            std::istringstream in(line);
+            if (!(in >> count) || count <= 0) {
+                std::cerr << "ERROR: " << path << ":" << lineNumber << ": bad note count\n";
+                return false;
+            }
+        }
+        else if ((int)cents.size() < count) {
+            double c;
+            if (!parseScalaPitch(line, c)) {
+                std::cerr << "ERROR: " << path << ":" << lineNumber << ": bad pitch\n";
+                return false;
+            }
+            cents.push_back(c);
+        }
+    }
+    if (count < 0 || (int)cents.size() < count || cents.back() <= 0.0) {
+        std::cerr << "ERROR: " << path << " is not a complete Scala scale\n";
+        return false;
+    }
+    mCents = cents;
+    mName = description.empty() ? path : description;
+    build();
+    return true;
+}
+
+void Tuning::fineTune(float cents)
+{
+    if (mFineTune != cents) {
+        mFineTune = cents;
+        build();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef ROGOSYNTH_TUNING_H
+#define ROGOSYNTH_TUNING_H
+#include "constants.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Pitch for MIDI note numbers (69 = A4), precomputed as oscillator phase
+// increments for one sample rate.  The table folds in the scale, the
+// reference pitch and fine tune, so a voice finds its pitch with one lookup.
+// Pitch bend is smoothed and applied by the voices' modulation, over the
+// range kept here.
+//
+// The scale is 12 tone equal temperament unless a Scala .scl file is
+// loaded.  Like Scala without a keyboard mapping, its first degree sits on
+// middle C (note 60) at the 12-TET frequency for A4 = 440Hz.
+class Tuning {
+  public:
+    static const int NUM_NOTES = 128;
+    static const int REFERENCE_NOTE = 60;
+
+  private:
+    float mIncrement[NUM_NOTES]; // cycles per sample
+    int mSampleRate;
+    std::vector<double> mCents;  // scale degrees 1..n, the last is the period
+    std::string mName;
+    float mFineTune;             // cents
+    float mBendRange;            // semitones either way
+
+    void build();
+
+  public:
+    Tuning(int sampleRate = SAMPLE_RATE);
+    // phase increment, in cycles per sample, at most 0.5
+    float increment(int note) const { return mIncrement[note]; }
+    float frequency(int note) const { return mIncrement[note] * mSampleRate; }
+
+    void equalTemperament();
+    // prints the reason and keeps the current scale if the file is unusable
+    bool loadScala(const char *path);
+    const std::string &name() const { return mName; }
+    float fineTune() const { return mFineTune; }
+    void fineTune(float cents);
+    float bendRange() const { return mBendRange; }
+    void bendRange(float semitones) { mBendRange = std::max(0.0f, semitones); }
+};
+#endif
@@ -0,0 +1,190 @@
+#include "wavetable.h"
+#include "constants.h"
+#include "fft.h"
+#include "mappedfile.h"
+#include "realtime.h"
+#include "wavfile.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+Wavetable::Wavetable()
+    : mData(nullptr), mFrames(0), mCycle(0), mFrameFloats(0), mSource(nullptr),
+      mSourcePlan(), mLevelPlans(), mReady(false), mPosition(0.0f)
+{
+}
+
+Wavetable::~Wavetable()
+{
+    wait();
+    delete[] mSource;
+    delete[] mData;
+}
+
+bool Wavetable::load(const char *path)
+{
+    assert(!loaded());
+    MappedFile file;
+    WavInfo info;
+    if (!file.open(path) || !parseWav(file.data(), file.size(), path, info)) {
+        return false;
+    }
+    int cycle = info.cycleLength;
+    if (cycle == 0) {
+        cycle = (int)std::min<size_t>(info.frames, DEFAULT_CYCLE);
+    }
+    if (cycle < MIN_CYCLE || cycle > MAX_CYCLE || (cycle & (cycle - 1)) != 0) {
+        std::cerr << "ERROR: " << path << " has " << cycle << " sample cycles; a wavetable's "
+                  << "are a power of 2 from " << MIN_CYCLE << " to " << MAX_CYCLE << "\n";
+        return false;
+    }
+    int frames = (int)std::min<size_t>(info.frames / cycle, MAX_FRAMES);
+    if (frames == 0) {
+        std::cerr << "ERROR: " << path << " is shorter than its " << cycle << " sample cycle\n";
+        return false;
+    }
+
+    // the source has at most cycle / 2 harmonics to keep
+    size_t offset = 0;
+    bool ok = fft_init(&mSourcePlan, cycle);
+    for (int l = 0; l < NUM_LEVELS; l++) {
+        int length = std::max(8 * std::min(1024 >> l, cycle / 2), 64);
+        ok &= fft_init(&mLevelPlans[l], length);
+        int bits = 0;
+        while ((1 << bits) < length) {
+            bits++;
+        }
+        mLevelLength[l] = length;
+        mLevelShift[l] = 32 - bits;
+        mLevelOffset[l] = offset;
+        offset += length + 1;
+    }
+    if (!ok) {
+        std::cerr << "ERROR: Couldn't allocate FFT tables for " << path << "\n";
+        freePlans();
+        return false;
+    }
+    mSource = new float[frames * cycle];
+    readWavFrames(info, 0, (size_t)frames * cycle, mSource, nullptr);
+    mFrameFloats = (offset + 3) & ~(size_t)3;
+    mData = new float[frames * mFrameFloats];
+    mFrames = frames;
+    mCycle = cycle;
+    mName = path;
+    mBuilder = std::thread(&Wavetable::build, this);
+    return true;
+}
+
+void Wavetable::wait()
+{
+    if (mBuilder.joinable()) {
+        mBuilder.join();
+    }
+}
+
+void Wavetable::freePlans()
+{
+    fft_free(&mSourcePlan);
+    for (int l = 0; l < NUM_LEVELS; l++) {
+        fft_free(&mLevelPlans[l]);
+    }
+}
+
+// Each frame's spectrum, cut to each level's harmonics (DC and the source's
+// Nyquist bin dropped) and transformed back at the level's length.  The
+// whole table is then scaled to a peak of 1.
+void Wavetable::build()
+{
+    Realtime::configureThread(ThreadRole::background, "wavetable build");
+    std::vector<float> re(mCycle), im(mCycle);
+    std::vector<float> levelRe(mLevelLength[0]), levelIm(mLevelLength[0]);
+    const float scale = 1.0f / mCycle;
+    float peak = 0.0f;
+    for (int f = 0; f < mFrames; f++) {
+        std::copy(mSource + f * mCycle, mSource + (f + 1) * mCycle, re.begin());
+        std::fill(im.begin(), im.end(), 0.0f);
+        fft_forward(&mSourcePlan, re.data(), im.data());
+        for (int l = 0; l < NUM_LEVELS; l++) {
+            const int length = mLevelLength[l];
+            const int harmonics = std::min(1024 >> l, mCycle / 2 - 1);
+            std::fill(levelRe.begin(), levelRe.begin() + length, 0.0f);
+            std::fill(levelIm.begin(), levelIm.begin() + length, 0.0f);
+            for (int k = 1; k <= harmonics; k++) {
+                levelRe[k] = levelRe[length - k] = re[k] * scale;
+                levelIm[k] = im[k] * scale;
+                levelIm[length - k] = -im[k] * scale;
+            }
+            fft_inverse(&mLevelPlans[l], levelRe.data(), levelIm.data());
+            float *table = mData + f * mFrameFloats + mLevelOffset[l];
+            std::copy(levelRe.begin(), levelRe.begin() + length, table);
+            table[length] = table[0];
+            if (l == 0) {
+                for (int i = 0; i < length; i++) {
+                    peak = std::max(peak, fabsf(table[i]));
+                }
+            }
+        }
+    }
+    freePlans();
+    if (peak > 0.0f) {
+        const float gain = 1.0f / peak;
+        for (size_t i = 0; i < mFrames * mFrameFloats; i++) {
+            mData[i] *= gain;
+        }
+    }
+    delete[] mSource;
+    mSource = nullptr;
+    mReady.store(true, std::memory_order_release);
+}
+
+WavetableVoice::WavetableVoice(const Wavetable *table)
+    : mTable(table), mPhase(0), mPosition(0.0f), mPositionStep(0.0f)
+{
+}
+
+void WavetableVoice::controlTick(float modulation, bool snap)
+{
+    float position = std::clamp(mTable->position() + modulation, 0.0f, 1.0f);
+    if (snap) {
+        mPosition = position;
+    }
+    mPositionStep = (position - mPosition) * (1.0f / CONTROL_RATE);
+}
+
+void WavetableVoice::addSamples(float *samples, int frames, int tableLength,
+                                const float *increment, const float *gain, const float *left,
+                                const float *right)
+{
+    if (!mTable->ready()) {
+        return;
+    }
+    // one level for the run, safe for its highest pitch (the increments
+    // are a ramp, so that's at one end)
+    const float toCycles = 1.0f / tableLength;
+    const int level =
+        Wavetable::level(std::max(increment[0], increment[frames - 1]) * toCycles);
+    const int shift = mTable->shift(level);
+    const uint32_t fracMask = (1u << shift) - 1;
+    const float fracScale = 1.0f / (float)(1u << shift);
+    const float toPhase = 4294967296.0f * toCycles;
+    const float lastFrame = (float)(mTable->frames() - 1);
+    for (int f = 0; f < frames; f++) {
+        float position = mPosition * lastFrame;
+        int a = std::min((int)position, mTable->frames() - 1);
+        int b = std::min(a + 1, mTable->frames() - 1);
+        float morph = position - a;
+        const float *tableA = mTable->table(a, level);
+        const float *tableB = mTable->table(b, level);
+        uint32_t i = mPhase >> shift;
+        float frac = (mPhase & fracMask) * fracScale;
+        float va = tableA[i] + frac * (tableA[i + 1] - tableA[i]);
+        float vb = tableB[i] + frac * (tableB[i + 1] - tableB[i]);
+        float sample = (va + morph * (vb - va)) * gain[f];
+        samples[2 * f] += sample * left[f];
+        samples[2 * f + 1] += sample * right[f];
+        mPhase += (uint32_t)(increment[f] * toPhase);
+        mPosition += mPositionStep;
+    }
+    mPosition = std::clamp(mPosition, 0.0f, 1.0f);
+}
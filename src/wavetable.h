@@ -0,0 +1,95 @@
+#ifndef ROGOSYNTH_WAVETABLE_H
+#define ROGOSYNTH_WAVETABLE_H
+#include "fft.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Single cycle frames imported from a .wav, each band limited into a
+// mip-map: level l keeps the first 1024 >> l harmonics, in a table 8 times
+// that long (at least 64) so linear interpolation stays clean.  The
+// mip-maps are built on a background thread after load() returns; voices
+// are silent until ready(), or wait() for them.
+class Wavetable {
+  public:
+    static const int MAX_FRAMES = 256;
+    static const int MIN_CYCLE = 32;
+    static const int MAX_CYCLE = 4096;
+    static const int DEFAULT_CYCLE = 2048; // without a clm chunk
+    static const int NUM_LEVELS = 11;
+
+  private:
+    float *mData; // every frame's levels, each table followed by its first sample
+    int mFrames;
+    int mCycle; // samples per frame in the file
+    int mLevelLength[NUM_LEVELS];
+    int mLevelShift[NUM_LEVELS]; // 32 - log2(length), for a 32 bit phase
+    size_t mLevelOffset[NUM_LEVELS];
+    size_t mFrameFloats;
+    float *mSource; // the cycles as loaded, until they're built
+    fft_plan mSourcePlan, mLevelPlans[NUM_LEVELS]; // until they're built
+    std::atomic<bool> mReady;
+    std::thread mBuilder;
+    std::string mName;
+    float mPosition; // 0..1 across the frames, before modulation
+
+    void build();
+    void freePlans();
+
+  public:
+    Wavetable();
+    ~Wavetable();
+    // Call before the audio starts.  Every mono or stereo (left channel)
+    // format parseWav() reads; cycles are as long as the file's clm chunk
+    // says, or DEFAULT_CYCLE, or the whole file if it is shorter.
+    bool load(const char *path);
+    bool loaded() const { return mData != nullptr; }
+    bool ready() const { return mReady.load(std::memory_order_acquire); }
+    // blocks until the mip-maps are built, for renders that mustn't depend
+    // on thread timing
+    void wait();
+    int frames() const { return mFrames; }
+    const std::string &name() const { return mName; }
+    float position() const { return mPosition; }
+    void position(float v) { mPosition = std::clamp(v, 0.0f, 1.0f); }
+
+    // the lowest level without harmonics above Nyquist at a fundamental of
+    // cycles per sample
+    static int level(float cycles)
+    {
+        int l = 0;
+        while (l < NUM_LEVELS - 1 && (1024 >> l) * cycles > 0.5f) {
+            l++;
+        }
+        return l;
+    }
+    const float *table(int frame, int level) const
+    {
+        return mData + frame * mFrameFloats + mLevelOffset[level];
+    }
+    int shift(int level) const { return mLevelShift[level]; }
+};
+
+// A voice's oscillator for a Wavetable: a 32 bit phase, and a position
+// ramped per sample towards the latest control tick.  Each sample is a
+// linearly interpolated lookup in the two frames around the position,
+// crossfaded between them.
+class WavetableVoice {
+    const Wavetable *mTable;
+    uint32_t mPhase;
+    float mPosition, mPositionStep; // 0..1
+
+  public:
+    WavetableVoice(const Wavetable *table);
+    void noteOn() { mPhase = 0; }
+    // aim the position at the table's plus modulation one tick from now
+    void controlTick(float modulation, bool snap);
+    // increment is the note's per sample phase increment in table units of
+    // length tableLength; the output is scaled by gain and panned by
+    // left/right
+    void addSamples(float *samples, int frames, int tableLength, const float *increment,
+                    const float *gain, const float *left, const float *right);
+};
+#endif
@@ -0,0 +1,141 @@
+#include "wavfile.h"
+#include <algorithm>
+#include <iostream>
+
+static uint16_t readU16LE(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t readU32LE(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+const uint16_t WAVE_FORMAT_PCM = 1;
+const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+bool parseWav(const uint8_t *bytes, size_t size, const char *name, WavInfo &info)
+{
+    info = WavInfo();
+    if (size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        std::cerr << "ERROR: " << name << " is not a WAV file\n";
+        return false;
+    }
+    bool haveFormat = false;
+    uint16_t format = 0, bits = 0;
+    size_t dataBytes = 0;
+    const uint8_t *smpl = nullptr;
+    size_t smplBytes = 0;
+    // chunks are word aligned; a truncated last chunk is cut to the file
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t *id = bytes + pos;
+        size_t length = std::min<size_t>(readU32LE(bytes + pos + 4), size - pos - 8);
+        const uint8_t *body = bytes + pos + 8;
+        if (memcmp(id, "fmt ", 4) == 0 && length >= 16) {
+            format = readU16LE(body);
+            info.channels = readU16LE(body + 2);
+            info.sampleRate = (int)readU32LE(body + 4);
+            info.frameBytes = readU16LE(body + 12);
+            bits = readU16LE(body + 14);
+            if (format == WAVE_FORMAT_EXTENSIBLE && length >= 26) {
+                format = readU16LE(body + 24); // the subformat GUID starts with it
+            }
+            haveFormat = true;
+        }
+        else if (memcmp(id, "data", 4) == 0) {
+            info.data = body;
+            dataBytes = length;
+        }
+        else if (memcmp(id, "smpl", 4) == 0 && length >= 36) {
+            smpl = body;
+            smplBytes = length;
+        }
+        else if (memcmp(id, "clm ", 4) == 0 && length > 3 && memcmp(body, "<!>", 3) == 0) {
+            // "<!>2048 ..."
+            for (size_t i = 3; i < length && body[i] >= '0' && body[i] <= '9'; i++) {
+                info.cycleLength = std::min(info.cycleLength * 10 + (body[i] - '0'), 1 << 20);
+            }
+        }
+        pos += 8 + length + (length & 1);
+    }
+    if (!haveFormat || info.data == nullptr) {
+        std::cerr << "ERROR: " << name << " has no " << (haveFormat ? "data" : "format")
+                  << " chunk\n";
+        return false;
+    }
+    if (format == WAVE_FORMAT_PCM && bits == 16) {
+        info.format = WavFormat::pcm16;
+    }
+    else if (format == WAVE_FORMAT_PCM && bits == 24) {
+        info.format = WavFormat::pcm24;
+    }
+    else if (format == WAVE_FORMAT_PCM && bits == 32) {
+        info.format = WavFormat::pcm32;
+    }
+    else if (format == WAVE_FORMAT_IEEE_FLOAT && bits == 32) {
+        info.format = WavFormat::float32;
+    }
+    else {
+        std::cerr << "ERROR: " << name << " is " << bits << " bit format " << format
+                  << "; only 16/24/32 bit PCM and 32 bit float are supported\n";
+        return false;
+    }
+    info.bytesPerSample = bits / 8;
+    if (info.channels < 1 || info.sampleRate <= 0 ||
+        info.frameBytes != info.bytesPerSample * info.channels) {
+        std::cerr << "ERROR: " << name << " has a bad format chunk\n";
+        return false;
+    }
+    info.frames = dataBytes / info.frameBytes;
+    if (info.frames == 0) {
+        std::cerr << "ERROR: " << name << " has no samples\n";
+        return false;
+    }
+    if (smpl) {
+        uint32_t unity = readU32LE(smpl + 12);
+        info.rootNote = unity < 128 ? (int)unity : -1;
+        // the first loop, if it's inside the data
+        uint32_t loops = readU32LE(smpl + 28);
+        if (loops > 0 && smplBytes >= 36 + 24) {
+            size_t start = readU32LE(smpl + 36 + 8);
+            size_t end = readU32LE(smpl + 36 + 12);
+            if (start <= end && end < info.frames) {
+                info.looped = true;
+                info.loopStart = start;
+                info.loopEnd = end;
+            }
+        }
+    }
+    return true;
+}
+
+template <WavFormat F>
+static void readFrames(const WavInfo &info, size_t first, size_t count, float *left,
+                       float *right)
+{
+    const uint8_t *p = info.data + first * info.frameBytes;
+    const int second = (info.channels > 1) ? info.bytesPerSample : 0;
+    for (size_t i = 0; i < count; i++, p += info.frameBytes) {
+        left[i] = wavSample<F>(p);
+        if (right) {
+            right[i] = wavSample<F>(p + second);
+        }
+    }
+}
+
+void readWavFrames(const WavInfo &info, size_t first, size_t count, float *left, float *right)
+{
+    switch (info.format) {
+    case WavFormat::pcm16:
+        readFrames<WavFormat::pcm16>(info, first, count, left, right);
+        break;
+    case WavFormat::pcm24:
+        readFrames<WavFormat::pcm24>(info, first, count, left, right);
+        break;
+    case WavFormat::pcm32:
+        readFrames<WavFormat::pcm32>(info, first, count, left, right);
+        break;
+    case WavFormat::float32:
+        readFrames<WavFormat::float32>(info, first, count, left, right);
+        break;
+    }
+}
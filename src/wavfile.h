@@ -0,0 +1,64 @@
+#ifndef ROGOSYNTH_WAVFILE_H
+#define ROGOSYNTH_WAVFILE_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+enum class WavFormat { pcm16, pcm24, pcm32, float32 };
+
+// What a WAV file holds, found by walking its RIFF chunks in memory.  The
+// sample data isn't read or copied: data points into the caller's bytes.
+struct WavInfo {
+    WavFormat format = WavFormat::pcm16;
+    int channels = 0;
+    int sampleRate = 0;
+    int bytesPerSample = 0;
+    int frameBytes = 0; // bytesPerSample * channels
+    size_t frames = 0;
+    const uint8_t *data = nullptr; // interleaved frames, little endian
+    // from the smpl chunk, if there is one
+    int rootNote = -1;             // MIDI unity note
+    bool looped = false;
+    size_t loopStart = 0, loopEnd = 0; // frames, end inclusive
+    // from a clm chunk, as wavetable editors write
+    int cycleLength = 0; // samples in each wavetable frame
+};
+
+// Prints the reason and returns false for anything that isn't 16, 24 or
+// 32 bit PCM or 32 bit float.  name is only for the messages.
+bool parseWav(const uint8_t *bytes, size_t size, const char *name, WavInfo &info);
+
+// Convert count frames from first on to -1..1, a channel per array; a mono
+// file fills both.  right may be null to take only the first channel.
+void readWavFrames(const WavInfo &info, size_t first, size_t count, float *left, float *right);
+
+// one sample as -1..1
+template <WavFormat F> inline float wavSample(const uint8_t *p);
+
+template <> inline float wavSample<WavFormat::pcm16>(const uint8_t *p)
+{
+    int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v * (1.0f / 32768.0f);
+}
+
+template <> inline float wavSample<WavFormat::pcm24>(const uint8_t *p)
+{
+    int32_t v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+    return v * (1.0f / 2147483648.0f);
+}
+
+template <> inline float wavSample<WavFormat::pcm32>(const uint8_t *p)
+{
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v * (1.0f / 2147483648.0f);
+}
+
+template <> inline float wavSample<WavFormat::float32>(const uint8_t *p)
+{
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+#endif
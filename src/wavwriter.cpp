@@ -0,0 +1,246 @@
+#include "wavwriter.h"
+#include "realtime.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+// the RIFF sizes are 32 bit
+static const uint64_t MAX_DATA_BYTES = 0xFFFFFFFFu - 64;
+
+static void putU16LE(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+static void putU32LE(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+WavWriter::WavWriter()
+    : mFile(nullptr), mFormat(WavFormat::pcm16), mChannels(0), mSampleRate(0),
+      mBytesPerSample(0), mFrames(0), mCurrent(0), mFill(0), mPendingBlock(-1),
+      mPendingFrames(0), mQuit(false), mFailed(false)
+{
+    mBlock[0] = mBlock[1] = nullptr;
+}
+
+WavWriter::~WavWriter()
+{
+    if (mFile) {
+        close();
+    }
+}
+
+bool WavWriter::open(const char *path, WavFormat format, int channels, int sampleRate)
+{
+    assert(mFile == nullptr);
+    assert(channels == 1 || channels == 2);
+    mFile = fopen(path, "wb");
+    if (mFile == nullptr) {
+        std::cerr << "ERROR: Couldn't create " << path << "\n";
+        return false;
+    }
+    mPath = path;
+    mFormat = format;
+    mChannels = channels;
+    mSampleRate = sampleRate;
+    mBytesPerSample = (format == WavFormat::pcm16) ? 2 : (format == WavFormat::pcm24) ? 3 : 4;
+    mFrames = 0;
+    mCurrent = mFill = 0;
+    mPendingBlock = -1;
+    mQuit = false;
+    mFailed = false;
+    // the sizes are filled in by close()
+    if (!writeHeader()) {
+        std::cerr << "ERROR: Couldn't write " << path << "\n";
+        fclose(mFile);
+        mFile = nullptr;
+        return false;
+    }
+    mBlock[0] = new float[BLOCK_FRAMES * channels];
+    mBlock[1] = new float[BLOCK_FRAMES * channels];
+    mBytes.resize((size_t)BLOCK_FRAMES * channels * mBytesPerSample);
+    mWorker = std::thread(&WavWriter::workerLoop, this);
+    return true;
+}
+
+bool WavWriter::write(const float *samples, int frames)
+{
+    assert(mFile != nullptr);
+    if (!mFailed && (mFrames + frames) * mChannels * mBytesPerSample > MAX_DATA_BYTES) {
+        std::cerr << "ERROR: " << mPath << " is too long for a .wav\n";
+        mFailed = true;
+    }
+    if (mFailed) {
+        return false;
+    }
+    while (frames > 0) {
+        int n = std::min(frames, BLOCK_FRAMES - mFill);
+        memcpy(mBlock[mCurrent] + mFill * mChannels, samples, sizeof(float) * n * mChannels);
+        mFill += n;
+        mFrames += n;
+        samples += n * mChannels;
+        frames -= n;
+        if (mFill == BLOCK_FRAMES) {
+            submit();
+        }
+    }
+    return true;
+}
+
+bool WavWriter::close()
+{
+    if (mFile == nullptr) {
+        return false;
+    }
+    if (mFill > 0) {
+        submit();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+    mWorker.join();
+
+    bool ok = !mFailed;
+    // the data chunk is padded to an even length
+    if ((mFrames * mChannels * mBytesPerSample) & 1) {
+        ok &= fputc(0, mFile) != EOF;
+    }
+    ok &= fseek(mFile, 0, SEEK_SET) == 0 && writeHeader();
+    ok &= fclose(mFile) == 0;
+    if (!ok) {
+        std::cerr << "ERROR: Couldn't write " << mPath << "\n";
+    }
+    mFile = nullptr;
+    delete[] mBlock[0];
+    delete[] mBlock[1];
+    mBlock[0] = mBlock[1] = nullptr;
+    std::vector<uint8_t>().swap(mBytes);
+    return ok;
+}
+
+// hand the current block to the I/O thread and fill the other one, once
+// the I/O thread is done with it
+void WavWriter::submit()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPendingBlock = mCurrent;
+        mPendingFrames = mFill;
+    }
+    mWake.notify_all();
+    mCurrent ^= 1;
+    mFill = 0;
+}
+
+void WavWriter::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWake.wait(lock, [this] { return mPendingBlock < 0; });
+}
+
+// RIFF, fmt (and fact for float), then the data chunk's header, with the
+// sizes for the frames written so far
+bool WavWriter::writeHeader()
+{
+    const bool isFloat = mFormat == WavFormat::float32;
+    const uint32_t frameBytes = mChannels * mBytesPerSample;
+    const uint32_t dataBytes = (uint32_t)(mFrames * frameBytes);
+    uint8_t header[56];
+    uint8_t *p = header;
+    memcpy(p, "RIFF", 4);
+    p += 8; // size, below
+    memcpy(p, "WAVEfmt ", 8);
+    putU32LE(p + 8, 16);
+    putU16LE(p + 12, isFloat ? 3 : 1); // WAVE_FORMAT_IEEE_FLOAT or _PCM
+    putU16LE(p + 14, (uint16_t)mChannels);
+    putU32LE(p + 16, (uint32_t)mSampleRate);
+    putU32LE(p + 20, (uint32_t)mSampleRate * frameBytes);
+    putU16LE(p + 24, (uint16_t)frameBytes);
+    putU16LE(p + 26, (uint16_t)(8 * mBytesPerSample));
+    p += 28;
+    if (isFloat) {
+        // required for anything but PCM
+        memcpy(p, "fact", 4);
+        putU32LE(p + 4, 4);
+        putU32LE(p + 8, (uint32_t)mFrames);
+        p += 12;
+    }
+    memcpy(p, "data", 4);
+    putU32LE(p + 4, dataBytes);
+    p += 8;
+    const size_t length = p - header;
+    putU32LE(header + 4, (uint32_t)(length - 8 + dataBytes + (dataBytes & 1)));
+    return fwrite(header, 1, length, mFile) == length;
+}
+
+// int16 samples run from -32768 to 32767, so negative samples scale by one
+// more, as sf_wavsave() did; likewise for 24 and 32 bits
+void WavWriter::writeBlock(const float *samples, int frames)
+{
+    const int count = frames * mChannels;
+    uint8_t *p = mBytes.data();
+    switch (mFormat) {
+    case WavFormat::pcm16:
+        for (int i = 0; i < count; i++, p += 2) {
+            float v = std::clamp(samples[i], -1.0f, 1.0f);
+            int16_t s = (v < 0.0f) ? (int16_t)(v * 32768.0f) : (int16_t)(v * 32767.0f);
+            putU16LE(p, (uint16_t)s);
+        }
+        break;
+    case WavFormat::pcm24:
+        for (int i = 0; i < count; i++, p += 3) {
+            float v = std::clamp(samples[i], -1.0f, 1.0f);
+            int32_t s = (v < 0.0f) ? (int32_t)(v * 8388608.0f) : (int32_t)(v * 8388607.0f);
+            p[0] = (uint8_t)s;
+            p[1] = (uint8_t)(s >> 8);
+            p[2] = (uint8_t)(s >> 16);
+        }
+        break;
+    case WavFormat::pcm32:
+        for (int i = 0; i < count; i++, p += 4) {
+            double v = std::clamp((double)samples[i], -1.0, 1.0);
+            int32_t s = (v < 0.0) ? (int32_t)(v * 2147483648.0) : (int32_t)(v * 2147483647.0);
+            putU32LE(p, (uint32_t)s);
+        }
+        break;
+    case WavFormat::float32:
+        for (int i = 0; i < count; i++, p += 4) {
+            uint32_t bits;
+            memcpy(&bits, samples + i, sizeof(bits));
+            putU32LE(p, bits);
+        }
+        break;
+    }
+    size_t length = p - mBytes.data();
+    if (fwrite(mBytes.data(), 1, length, mFile) != length) {
+        mFailed = true;
+    }
+}
+
+void WavWriter::workerLoop()
+{
+    Realtime::configureThread(ThreadRole::background, "wav writer");
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWake.wait(lock, [this] { return mQuit || mPendingBlock >= 0; });
+        if (mPendingBlock < 0) {
+            return; // quit, with everything written
+        }
+        int block = mPendingBlock;
+        int frames = mPendingFrames;
+        lock.unlock();
+        writeBlock(mBlock[block], frames);
+        lock.lock();
+        mPendingBlock = -1;
+        mWake.notify_all();
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ROGOSYNTH_WAVWRITER_H
+#define ROGOSYNTH_WAVWRITER_H
+#include "wavfile.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes a WAV file as it is produced.  write() copies frames into one of
+// two blocks; a full block goes to an I/O thread, which converts and
+// writes it while the other block fills.  However long the file, only the
+// two blocks are held in memory, and the producer only waits when the disk
+// is slower than it is.
+class WavWriter {
+    FILE *mFile;
+    std::string mPath;
+    WavFormat mFormat;
+    int mChannels;
+    int mSampleRate;
+    int mBytesPerSample;
+    uint64_t mFrames; // written so far
+
+    // producer side
+    float *mBlock[2]; // BLOCK_FRAMES interleaved frames each
+    int mCurrent;     // the block being filled
+    int mFill;        // frames in it
+
+    // I/O thread side
+    std::vector<uint8_t> mBytes; // a block converted to the file's format
+    int mPendingBlock;           // block waiting to be written, or -1
+    int mPendingFrames;
+    bool mQuit;
+    std::atomic<bool> mFailed;
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+
+    void submit();
+    void waitIdle();
+    void writeBlock(const float *samples, int frames);
+    bool writeHeader();
+    void workerLoop();
+
+  public:
+    static const int BLOCK_FRAMES = 65536;
+
+    WavWriter();
+    ~WavWriter();
+    // 1 or 2 channels; prints the reason and returns false on failure
+    bool open(const char *path, WavFormat format, int channels, int sampleRate);
+    // interleaved -1..1 frames, clipped for the integer formats; false once
+    // anything has failed to write
+    bool write(const float *samples, int frames);
+    // write what is left, fill in the chunk sizes and close the file; false
+    // if any of it failed
+    bool close();
+    uint64_t frames() const { return mFrames; }
+};
+#endif